@@ -493,7 +493,7 @@ struct IntervalTreeNode {
 // XOR Linked List
 // Skip List
 // Self-Organizing List
-// Unrolled Linked List
+// Unrolled Linked List (implemented as UnrolledLinkedList in basic_data_structures.cpp)
 // 
 // Each is quite large. Minimal placeholders follow:
 
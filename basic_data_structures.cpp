@@ -3,6 +3,38 @@
 #include <initializer_list>
 #include <cstddef>   // for size_t
 #include <utility>   // for std::pair
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <iterator>  // for std::back_inserter
+#include <functional> // for std::hash
+#include <new>       // for placement new
+#include <type_traits>
+#include <cstdint>   // for std::uintptr_t
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>   // for std::memcpy
+#include <string>
+#include <memory>
+#include <cmath>
+#include <limits>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define BDS_HAVE_MMAP 1
+#else
+#define BDS_HAVE_MMAP 0
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 //===================================================
 // Global operator<< for std::pair<A,B> 
@@ -13,6 +45,74 @@ std::ostream &operator<<(std::ostream &os, const std::pair<A, B> &p) {
     return os;
 }
 
+//===================================================
+// Bit helpers (count trailing zeros on a non-zero word)
+//===================================================
+inline unsigned countTrailingZeros(unsigned long long x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(x));
+#else
+    unsigned n = 0;
+    while (!(x & 1ULL)) { x >>= 1; n++; }
+    return n;
+#endif
+}
+
+// Number of bits needed to represent x (0 for x == 0)
+inline unsigned bitLength(unsigned long long x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return x ? 64u - static_cast<unsigned>(__builtin_clzll(x)) : 0u;
+#else
+    unsigned n = 0;
+    while (x) { x >>= 1; n++; }
+    return n;
+#endif
+}
+
+inline unsigned long long reverseBits(unsigned long long x) {
+    x = ((x >> 1)  & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    x = ((x >> 2)  & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4)  & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = ((x >> 8)  & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+    x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+    return (x >> 32) | (x << 32);
+}
+
+inline unsigned popCount(unsigned long long x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_popcountll(x));   // one popcnt with -mpopcnt
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<unsigned>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Hint that *p will be read soon; a no-op where unsupported
+inline void prefetchRead(const void* p) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p, 0, 3);
+#else
+    (void)p;
+#endif
+}
+
+// std::hash is the identity for integers, so hashed containers mix first
+inline unsigned long long mixBits(unsigned long long h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Default worker count. std::thread::hardware_concurrency() can read /sys
+// on every call, which costs more than a small matrix product.
+inline unsigned hardwareThreads() {
+    static const unsigned n = std::thread::hardware_concurrency();
+    return n;
+}
+
 //===================================================
 // Forward declaration
 //===================================================
@@ -35,6 +135,110 @@ public:
     void setNext(Node<T>* n){ next = n; }
 };
 
+//===================================================
+// NodeArena<T> - slab allocator for Node<T>
+//===================================================
+// Nodes are carved out of cache-line-aligned chunks of about 4 KB and
+// freed nodes are recycled through an intrusive free list. Each container
+// owns its arena, so there is no shared state to contend on, and release()
+// drops every node at once by freeing the chunks.
+template<typename T>
+class NodeArena {
+private:
+    static const std::size_t CACHE_LINE = 64;
+
+    union Slot {
+        Slot* nextFree;
+        alignas(Node<T>) unsigned char storage[sizeof(Node<T>)];
+    };
+
+    static const std::size_t SLOTS_PER_CHUNK =
+        (sizeof(Slot) >= 4096) ? 1 : 4096 / sizeof(Slot);
+
+    struct alignas(CACHE_LINE) Chunk {
+        Slot slots[SLOTS_PER_CHUNK];
+        Chunk* next;
+    };
+
+    Chunk* chunks;      // newest chunk first; new nodes are bumped out of it
+    Chunk* lastChunk;
+    std::size_t bumped; // slots handed out from 'chunks'
+    Slot* freeList;
+
+public:
+    NodeArena() : chunks(nullptr), lastChunk(nullptr), bumped(0), freeList(nullptr) {}
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+    ~NodeArena() { release(); }
+
+    Node<T>* create(const T& val) {
+        Slot* slot;
+        if (freeList) {
+            slot = freeList;
+            freeList = freeList->nextFree;
+        } else {
+            if (!chunks || bumped == SLOTS_PER_CHUNK) {
+                Chunk* c = new Chunk;
+                c->next = chunks;
+                chunks = c;
+                if (!lastChunk) lastChunk = c;
+                bumped = 0;
+            }
+            slot = &chunks->slots[bumped++];
+        }
+        return new (slot->storage) Node<T>(val);
+    }
+
+    void destroy(Node<T>* n) {
+        n->~Node<T>();
+        Slot* slot = reinterpret_cast<Slot*>(n);
+        slot->nextFree = freeList;
+        freeList = slot;
+    }
+
+    // Frees every chunk without running node destructors
+    void release() {
+        while (chunks) {
+            Chunk* next = chunks->next;
+            delete chunks;
+            chunks = next;
+        }
+        lastChunk = nullptr;
+        bumped = 0;
+        freeList = nullptr;
+    }
+
+    // Takes over all of 'other's chunks, and its free slots with them
+    void absorb(NodeArena& other) {
+        if (!other.chunks) return;
+        if (!chunks) {
+            chunks = other.chunks;
+            lastChunk = other.lastChunk;
+            bumped = other.bumped;
+        } else {
+            // Only our newest chunk is bumped from, so 'other's unused tail
+            // slots go on the free list instead
+            for (std::size_t i = SLOTS_PER_CHUNK; i-- > other.bumped;) {
+                other.chunks->slots[i].nextFree = freeList;
+                freeList = &other.chunks->slots[i];
+            }
+            lastChunk->next = other.chunks;
+            lastChunk = other.lastChunk;
+        }
+        // Recently freed slots go first, while they are likely still cached
+        if (other.freeList) {
+            Slot* last = other.freeList;
+            while (last->nextFree) last = last->nextFree;
+            last->nextFree = freeList;
+            freeList = other.freeList;
+        }
+        other.chunks = nullptr;
+        other.lastChunk = nullptr;
+        other.bumped = 0;
+        other.freeList = nullptr;
+    }
+};
+
 //===================================================
 // Templated LinkedList
 //===================================================
@@ -45,6 +249,10 @@ class LinkedList {
 protected:
     Node<T>* head;
     Node<T>* tail;
+    NodeArena<T> arena;
+
+    Node<T>* makeNode(const T& val) { return arena.create(val); }
+    void freeNode(Node<T>* n)       { arena.destroy(n); }
 
     // Return pointer to node at index n
     Node<T>* nodeAtIndex(std::size_t n) {
@@ -56,35 +264,64 @@ protected:
         return temp;
     }
 
-    // Merge two sorted singly linked lists (for mergesort)
-    Node<T>* mergeLists(Node<T>* left, Node<T>* right) {
-        if (!left)  return right;
-        if (!right) return left;
-        if (left->getVal() <= right->getVal()) {
-            left->setNext(mergeLists(left->getNext(), right));
-            return left;
-        } else {
-            right->setNext(mergeLists(left, right->getNext()));
-            return right;
+    // A sorted, nullptr-terminated run of nodes
+    struct Run {
+        Node<T>* head;
+        Node<T>* tail;
+    };
+
+    // Smallest list worth splitting across threads in parallelSort
+    static const std::size_t PARALLEL_SORT_MIN = 1 << 14;
+
+    // Merge two sorted runs; on ties 'left' goes first, which keeps the
+    // sort stable. Iterative, so long runs cannot overflow the stack.
+    static Run mergeRuns(Run left, Run right) {
+        if (!left.head)  return right;
+        if (!right.head) return left;
+        Node<T>* a = left.head;
+        Node<T>* b = right.head;
+        Run out{nullptr, nullptr};
+        while (a && b) {
+            Node<T>* pick;
+            if (a->getVal() <= b->getVal()) {
+                pick = a;
+                a = a->getNext();
+            } else {
+                pick = b;
+                b = b->getNext();
+            }
+            if (out.tail) out.tail->setNext(pick);
+            else out.head = pick;
+            out.tail = pick;
         }
+        out.tail->setNext(a ? a : b);
+        out.tail = a ? left.tail : right.tail;
+        return out;
     }
 
-    // Recursively splits the list for mergesort
-    Node<T>* mergeSort(Node<T>* start) {
-        if (!start || !start->getNext()) return start;
-        // Split the list in the middle
-        Node<T>* slow = start;
-        Node<T>* fast = start->getNext();
-        while (fast && fast->getNext()) {
-            slow = slow->getNext();
-            fast = fast->getNext()->getNext();
+    // Bottom-up mergesort of a nullptr-terminated list. bucket[i] holds
+    // either nothing or a sorted run of 2^i nodes; nodes are carried through
+    // the buckets like a binary counter, so there is no recursion at all.
+    static Run sortRun(Node<T>* start) {
+        Run bucket[64] = {};
+        while (start) {
+            Run carry{start, start};
+            start = start->getNext();
+            carry.tail->setNext(nullptr);
+            std::size_t i = 0;
+            while (bucket[i].head) {
+                // bucket[i] holds older nodes, so it goes on the left
+                carry = mergeRuns(bucket[i], carry);
+                bucket[i] = Run{nullptr, nullptr};
+                i++;
+            }
+            bucket[i] = carry;
         }
-        Node<T>* secondHalf = slow->getNext();
-        slow->setNext(nullptr);
-
-        Node<T>* left  = mergeSort(start);
-        Node<T>* right = mergeSort(secondHalf);
-        return mergeLists(left, right);
+        Run result{nullptr, nullptr};
+        for (std::size_t i = 0; i < 64; i++) {
+            if (bucket[i].head) result = mergeRuns(bucket[i], result);
+        }
+        return result;
     }
 
     // Add content of LinkedList 'l' to 'this' at end
@@ -96,6 +333,8 @@ protected:
             this->tail->setNext(l->head);
             if (l->tail) this->tail = l->tail;
         }
+        // The nodes now belong to this list, and so do their chunks
+        arena.absorb(l->arena);
         // Clear the other list
         l->head = nullptr;
         l->tail = nullptr;
@@ -117,12 +356,17 @@ public:
     }
 
     void clear() {
-        Node<T>* current = head;
-        while (current) {
-            Node<T>* tmp = current;
-            current = current->getNext();
-            delete tmp;
+        // Only non-trivial T needs a walk; the arena then drops all nodes
+        // at once. Stopping at tail also covers circular lists.
+        if (!std::is_trivially_destructible<T>::value) {
+            Node<T>* current = head;
+            while (current) {
+                Node<T>* tmp = current;
+                current = (current == tail) ? nullptr : current->getNext();
+                tmp->~Node<T>();
+            }
         }
+        arena.release();
         head = nullptr;
         tail = nullptr;
     }
@@ -143,14 +387,21 @@ public:
 
     virtual void push(const T& val) {
         if (!head) {
-            head = new Node<T>(val);
+            head = makeNode(val);
             tail = head;
             return;
         }
-        tail->setNext(new Node<T>(val));
+        tail->setNext(makeNode(val));
         tail = tail->getNext();
     }
 
+    void push_front(const T& val) {
+        Node<T>* n = makeNode(val);
+        n->setNext(head);
+        head = n;
+        if (!tail) tail = n;
+    }
+
     virtual T pop() {
         // pop from the back
         if (!head) {
@@ -158,7 +409,7 @@ public:
         }
         if (head == tail) {
             T returnVal = head->getVal();
-            delete head;
+            freeNode(head);
             head = nullptr;
             tail = nullptr;
             return returnVal;
@@ -169,7 +420,7 @@ public:
             temp = temp->getNext();
         }
         T returnVal = tail->getVal();
-        delete tail;
+        freeNode(tail);
         tail = temp;
         tail->setNext(nullptr);
         return returnVal;
@@ -187,7 +438,7 @@ public:
         } else {
             head = head->getNext();
         }
-        delete temp;
+        freeNode(temp);
         return returnVal;
     }
 
@@ -202,16 +453,54 @@ public:
     }
 
     void sort() {
-        // mergesort
-        head = mergeSort(head);
-        // reassign tail
-        if (!head) {
-            tail = nullptr;
-        } else {
-            Node<T>* temp = head;
-            while (temp->getNext()) temp = temp->getNext();
-            tail = temp;
+        // stable, non-recursive mergesort
+        Run sorted = sortRun(head);
+        head = sorted.head;
+        tail = sorted.tail;
+    }
+
+    // Stable mergesort that sorts equal slices of the list on separate
+    // threads, then merges neighbouring slices pairwise, also in parallel.
+    // Only relinks nodes, so no allocation happens on the worker threads.
+    void parallelSort(unsigned threads = hardwareThreads()) {
+        std::size_t n = size();
+        // Every slice gets at least PARALLEL_SORT_MIN nodes, so none is empty
+        if (threads > n / PARALLEL_SORT_MIN) threads = static_cast<unsigned>(n / PARALLEL_SORT_MIN);
+        if (threads < 2) {
+            sort();
+            return;
+        }
+        std::vector<Run> runs(threads);
+        Node<T>* cur = head;
+        for (unsigned t = 0; t < threads; t++) {
+            std::size_t len = n / threads + (t < n % threads ? 1 : 0);
+            runs[t].head = cur;
+            for (std::size_t i = 1; i < len; i++) cur = cur->getNext();
+            runs[t].tail = cur;
+            cur = cur->getNext();
+            runs[t].tail->setNext(nullptr);
+        }
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&runs, t]() { runs[t] = sortRun(runs[t].head); });
+        }
+        for (std::thread& w : workers) w.join();
+
+        while (runs.size() > 1) {
+            std::vector<Run> merged((runs.size() + 1) / 2);
+            workers.clear();
+            for (std::size_t i = 0; i + 1 < runs.size(); i += 2) {
+                workers.emplace_back([&runs, &merged, i]() {
+                    merged[i / 2] = mergeRuns(runs[i], runs[i + 1]);
+                });
+            }
+            if (runs.size() % 2) merged.back() = runs.back();
+            for (std::thread& w : workers) w.join();
+            runs.swap(merged);
         }
+        head = runs[0].head;
+        tail = runs[0].tail;
     }
 
     virtual void print() {
@@ -250,7 +539,7 @@ public:
         if (!toDelete) throw std::out_of_range("Index out of range in popAtIndex");
         if (toDelete == tail) tail = prev;
         prev->setNext(toDelete->getNext());
-        delete toDelete;
+        freeNode(toDelete);
     }
 
     // Overload operator[]
@@ -288,36 +577,6 @@ public:
 template<typename T>
 int LinkedList<T>::totalLinkedLists = 0;
 
-//===================================================
-// Templated Set Class
-//===================================================
-template<typename T>
-class Set : public LinkedList<T> {
-public:
-    Set() : LinkedList<T>() {}
-    Set(std::initializer_list<T> init_list) : LinkedList<T>() {
-        for (const T& val : init_list) {
-            add(val);
-        }
-    }
-    void add(const T& val) {
-        if (this->find(val) == -1) {
-            this->push(val);
-        }
-    }
-    void remove(const T& val) {
-        int idx = this->find(val);
-        if (idx != -1) this->popAtIndex(idx);
-    }
-    bool contains(const T& val) {
-        return (this->find(val) != -1);
-    }
-    void print() override {
-        std::cout << "Set: ";
-        LinkedList<T>::print();
-    }
-};
-
 //===================================================
 // Templated Stack Class
 //===================================================
@@ -326,15 +585,14 @@ class Stack : public LinkedList<T> {
 public:
     Stack() : LinkedList<T>() {}
     void push(const T& val) override {
-        // push at the back
-        LinkedList<T>::push(val);
+        // the head is the top, so push and pop are O(1)
+        LinkedList<T>::push_front(val);
     }
     T pop() override {
-        // pop from back
-        return LinkedList<T>::pop();
+        return LinkedList<T>::pop_front();
     }
     T& top() {
-        return this->back();
+        return this->front();
     }
     bool empty() const {
         return LinkedList<T>::empty();
@@ -374,50 +632,177 @@ public:
 };
 
 //===================================================
-// Templated PriorityQueue Class
+// Templated PriorityQueue Class (addressable d-ary heap)
 //===================================================
-template<typename T>
-class PriorityQueue : public LinkedList<T> {
+// Array-backed heap with D children per node; a wider node makes the tree
+// shallower and keeps the children it compares in one or two cache lines.
+// Like std::priority_queue, Compare = std::less<T> gives a max-heap and
+// std::greater<T> a min-heap. push() returns a handle that stays valid
+// until that element is popped or erased, for decrease_key() and erase().
+// A handle packs a slot number (low 32 bits) with a generation (high 32
+// bits) that is bumped each time the slot is reused, so a stale handle is
+// rejected with std::invalid_argument instead of reaching a newer element.
+template<typename T, typename Compare = std::less<T>, std::size_t D = 4>
+class PriorityQueue {
+    static_assert(D >= 2, "PriorityQueue needs at least two children per node");
+
 public:
-    PriorityQueue() : LinkedList<T>() {}
+    typedef std::uint64_t Handle;
 
-    void push(const T& val) override {
-        if (this->empty()) {
-            LinkedList<T>::push(val);
-            return;
+private:
+    static const Handle SLOT_MASK = 0xFFFFFFFFu;
+    static const Handle GENERATION = Handle(1) << 32;
+
+    struct Entry {
+        T val;
+        Handle id;
+    };
+
+    std::vector<Entry> heap;
+    std::vector<std::size_t> where;   // slot -> index in 'heap'
+    std::vector<Handle> freeIds;      // next handle for each free slot
+    Compare comp;
+
+    // True if a belongs above b
+    bool above(const Entry& a, const Entry& b) const { return comp(b.val, a.val); }
+
+    void place(std::size_t i, Entry&& e) {
+        where[e.id & SLOT_MASK] = i;
+        heap[i] = std::move(e);
+    }
+
+    void siftUp(std::size_t i) {
+        Entry e = std::move(heap[i]);
+        while (i > 0) {
+            std::size_t parent = (i - 1) / D;
+            if (!above(e, heap[parent])) break;
+            place(i, std::move(heap[parent]));
+            i = parent;
         }
-        Node<T>* temp = this->head;
-        Node<T>* prev = nullptr;
-        while (temp && temp->getVal() < val) {
-            prev = temp;
-            temp = temp->getNext();
+        place(i, std::move(e));
+    }
+
+    void siftDown(std::size_t i) {
+        std::size_t n = heap.size();
+        Entry e = std::move(heap[i]);
+        while (true) {
+            std::size_t first = D * i + 1;
+            if (first >= n) break;
+            std::size_t last = (first + D < n) ? first + D : n;
+            std::size_t best = first;
+            for (std::size_t c = first + 1; c < last; c++) {
+                if (above(heap[c], heap[best])) best = c;
+            }
+            if (!above(heap[best], e)) break;
+            place(i, std::move(heap[best]));
+            i = best;
         }
-        Node<T>* newNode = new Node<T>(val);
-        if (!prev) {
-            // Insert at head
-            newNode->setNext(this->head);
-            this->head = newNode;
-            if (!this->tail) this->tail = newNode;
+        place(i, std::move(e));
+    }
+
+    Handle newId(std::size_t idx) {
+        if (!freeIds.empty()) {
+            Handle id = freeIds.back();
+            freeIds.pop_back();
+            where[id & SLOT_MASK] = idx;
+            return id;
+        }
+        if (where.size() > SLOT_MASK) throw std::length_error("PriorityQueue has run out of handles");
+        where.push_back(idx);
+        return where.size() - 1;
+    }
+
+    // Removes heap[i], refilling the gap from the last slot
+    T removeAt(std::size_t i) {
+        T out = std::move(heap[i].val);
+        freeIds.push_back(heap[i].id + GENERATION);
+        std::size_t lastIdx = heap.size() - 1;
+        if (i != lastIdx) {
+            place(i, std::move(heap[lastIdx]));
+            heap.pop_back();
+            if (i > 0 && above(heap[i], heap[(i - 1) / D])) siftUp(i);
+            else siftDown(i);
         } else {
-            newNode->setNext(temp);
-            prev->setNext(newNode);
-            if (!temp) this->tail = newNode;
+            heap.pop_back();
         }
+        return out;
     }
 
-    T pop() override {
-        // pop the largest element (which is at the back)
-        return LinkedList<T>::pop();
+    // The slot's current entry must carry the same generation as 'h'
+    std::size_t indexOf(Handle h) const {
+        std::size_t slot = static_cast<std::size_t>(h & SLOT_MASK);
+        if (slot >= where.size() || where[slot] >= heap.size() || heap[where[slot]].id != h) {
+            throw std::invalid_argument("Stale PriorityQueue handle");
+        }
+        return where[slot];
     }
 
-    T& top() {
-        // The largest is at the back
-        return this->back();
+public:
+    PriorityQueue(const Compare& c = Compare()) : comp(c) {}
+
+    // O(n) heapify; the i-th element of the range gets handle i
+    template<typename It>
+    PriorityQueue(It first, It last, const Compare& c = Compare()) : comp(c) {
+        for (; first != last; ++first) {
+            heap.push_back(Entry{*first, heap.size()});
+            where.push_back(where.size());
+        }
+        for (std::size_t i = heap.size() / D + 1; i-- > 0;) {
+            if (i < heap.size()) siftDown(i);
+        }
     }
 
-    void print() override {
-        std::cout << "PriorityQueue (smallest->largest): ";
-        LinkedList<T>::print();
+    bool empty() const { return heap.empty(); }
+    std::size_t size() const { return heap.size(); }
+
+    void reserve(std::size_t n) {
+        heap.reserve(n);
+        where.reserve(n);
+    }
+
+    Handle push(const T& val) {
+        heap.push_back(Entry{val, 0});
+        heap.back().id = newId(heap.size() - 1);
+        Handle id = heap.back().id;
+        siftUp(heap.size() - 1);
+        return id;
+    }
+
+    T pop() {
+        if (heap.empty()) throw std::underflow_error("PriorityQueue is empty, cannot pop.");
+        return removeAt(0);
+    }
+
+    const T& top() const {
+        if (heap.empty()) throw std::underflow_error("PriorityQueue is empty, cannot view top.");
+        return heap[0].val;
+    }
+
+    const T& get(Handle h) const { return heap[indexOf(h)].val; }
+
+    // Gives the element a new key and restores heap order. Named for the
+    // usual case (a min-heap whose key shrinks), but works in either direction.
+    void decrease_key(Handle h, const T& val) {
+        std::size_t i = indexOf(h);
+        heap[i].val = val;
+        if (i > 0 && above(heap[i], heap[(i - 1) / D])) siftUp(i);
+        else siftDown(i);
+    }
+
+    T erase(Handle h) {
+        return removeAt(indexOf(h));
+    }
+
+    void print() {
+        std::vector<T> ordered;
+        for (std::size_t i = 0; i < heap.size(); i++) ordered.push_back(heap[i].val);
+        std::sort(ordered.begin(), ordered.end(), [this](const T& a, const T& b) { return comp(b, a); });
+        std::cout << "PriorityQueue (top->bottom): ";
+        for (std::size_t i = 0; i < ordered.size(); i++) {
+            std::cout << ordered[i];
+            if (i + 1 < ordered.size()) std::cout << ", ";
+        }
+        std::cout << std::endl;
     }
 };
 
@@ -428,27 +813,15 @@ template<typename T>
 class CircularLinkedList : public LinkedList<T> {
 public:
     CircularLinkedList() : LinkedList<T>() {}
-    ~CircularLinkedList() {
-        if (!this->head) return;
-        Node<T>* temp = this->head;
-        do {
-            Node<T>* toDelete = temp;
-            temp = temp->getNext();
-            delete toDelete;
-        } while (temp != this->head);
-
-        this->head = nullptr;
-        this->tail = nullptr;
-    }
 
     void push(const T& val) override {
         if (!this->head) {
-            this->head = new Node<T>(val);
+            this->head = this->makeNode(val);
             this->head->setNext(this->head);
             this->tail = this->head;
             return;
         }
-        Node<T>* newNode = new Node<T>(val);
+        Node<T>* newNode = this->makeNode(val);
         this->tail->setNext(newNode);
         newNode->setNext(this->head);
         this->tail = newNode;
@@ -460,7 +833,7 @@ public:
         }
         if (this->head == this->tail) {
             T returnVal = this->head->getVal();
-            delete this->head;
+            this->freeNode(this->head);
             this->head = nullptr;
             this->tail = nullptr;
             return returnVal;
@@ -470,7 +843,7 @@ public:
             temp = temp->getNext();
         }
         T returnVal = this->tail->getVal();
-        delete this->tail;
+        this->freeNode(this->tail);
         this->tail = temp;
         this->tail->setNext(this->head);
         return returnVal;
@@ -493,385 +866,5813 @@ public:
 };
 
 //===================================================
-// Templated Map (linked-list based, storing key-value pairs)
+// Templated UnrolledLinkedList
 //===================================================
-template<typename K, typename V>
-class Map : public LinkedList<std::pair<K, V>> {
-public:
-    Map() : LinkedList<std::pair<K, V>>() {}
+// Same interface as LinkedList, but every node holds a cache line worth of
+// elements, so a traversal takes one pointer hop (and one likely cache miss)
+// per block instead of per element. Blocks split when an insert hits a full
+// block and merge with their successor once an erase leaves them under half
+// full. The element count is cached, so size() is O(1).
+template<typename T>
+class UnrolledLinkedList {
+private:
+    static const std::size_t CACHE_LINE = 64;
+    static const std::size_t BLOCK_CAP = (sizeof(T) * 4 >= CACHE_LINE) ? 4 : CACHE_LINE / sizeof(T);
+
+    struct alignas(CACHE_LINE) Block {
+        alignas(T) unsigned char storage[BLOCK_CAP * sizeof(T)];
+        std::size_t count;
+        Block* next;
+        Block() : count(0), next(nullptr) {}
+        T* items() { return reinterpret_cast<T*>(storage); }
+    };
+
+    Block* head;
+    Block* tail;
+    std::size_t length;
 
-    void insert(const K& key, const V& val) {
-        int idx = findKey(key);
-        if (idx != -1) {
-            // key exists, update
-            Node<std::pair<K, V>>* temp = this->operator[](idx);
-            temp->getVal().second = val;
-        } else {
-            this->push(std::make_pair(key, val));
+    template<typename U>
+    void append(U&& val) {
+        if (!tail || tail->count == BLOCK_CAP) {
+            Block* b = new Block();
+            if (tail) tail->next = b;
+            else head = b;
+            tail = b;
         }
+        new (&tail->items()[tail->count]) T(std::forward<U>(val));
+        tail->count++;
+        length++;
     }
 
-    V get(const K& key) {
-        Node<std::pair<K, V>>* temp = this->head;
-        while (temp) {
-            if (temp->getVal().first == key) {
-                return temp->getVal().second;
-            }
-            temp = temp->getNext();
+    // Block holding element n, its offset inside the block, and the block before it
+    Block* locate(std::size_t n, std::size_t& offset, Block*& prev) const {
+        if (n >= length) throw std::out_of_range("Index out of range");
+        prev = nullptr;
+        Block* b = head;
+        while (n >= b->count) {
+            n -= b->count;
+            prev = b;
+            b = b->next;
         }
-        throw std::out_of_range("Key not found in Map");
+        offset = n;
+        return b;
     }
 
-    void remove(const K& key) {
-        int idx = findKey(key);
-        if (idx != -1) {
-            this->popAtIndex(idx);
-        }
+    void unlink(Block* b, Block* prev) {
+        if (prev) prev->next = b->next;
+        else head = b->next;
+        if (tail == b) tail = prev;
+        delete b;
     }
 
-    bool contains(const K& key) {
-        return (findKey(key) != -1);
+    // Removes items()[i] from block b, then frees or merges b as needed
+    void eraseAt(Block* b, Block* prev, std::size_t i) {
+        T* items = b->items();
+        for (std::size_t j = i; j + 1 < b->count; j++) items[j] = std::move(items[j + 1]);
+        items[b->count - 1].~T();
+        b->count--;
+        length--;
+        if (b->count == 0) {
+            unlink(b, prev);
+            return;
+        }
+        Block* next = b->next;
+        if (next && b->count < BLOCK_CAP / 2 && b->count + next->count <= BLOCK_CAP) {
+            T* src = next->items();
+            for (std::size_t j = 0; j < next->count; j++) {
+                new (&items[b->count + j]) T(std::move(src[j]));
+                src[j].~T();
+            }
+            b->count += next->count;
+            next->count = 0;
+            unlink(next, b);
+        }
     }
 
-    int findKey(const K& key) {
-        Node<std::pair<K, V>>* temp = this->head;
-        int idx = 0;
-        while (temp) {
-            if (temp->getVal().first == key) return idx;
-            temp = temp->getNext();
-            idx++;
+public:
+    UnrolledLinkedList() : head(nullptr), tail(nullptr), length(0) {}
+
+    UnrolledLinkedList(std::initializer_list<T> init_list) : head(nullptr), tail(nullptr), length(0) {
+        for (const T& val : init_list) {
+            push(val);
         }
-        return -1;
     }
 
-    void print() override {
-        std::cout << "Map (key->value): ";
-        Node<std::pair<K, V>>* temp = this->head;
-        while (temp) {
-            std::cout << temp->getVal(); 
-            // uses operator<<(std::pair<K,V>) we defined globally
-            temp = temp->getNext();
-            if (temp) std::cout << ", ";
+    UnrolledLinkedList(const UnrolledLinkedList&) = delete;
+    UnrolledLinkedList& operator=(const UnrolledLinkedList&) = delete;
+
+    ~UnrolledLinkedList() { clear(); }
+
+    void clear() {
+        Block* b = head;
+        while (b) {
+            for (std::size_t i = 0; i < b->count; i++) b->items()[i].~T();
+            Block* next = b->next;
+            delete b;
+            b = next;
         }
-        std::cout << std::endl;
+        head = nullptr;
+        tail = nullptr;
+        length = 0;
     }
-};
 
-//===================================================
-// UnorderedMap (Naive singly linked list chaining)
-//===================================================
-template<typename K, typename V>
-class KeyValuePair {
-public:
-    K key;
-    V value;
-    KeyValuePair<K,V>* next;
-    KeyValuePair(const K& k, const V& v) : key(k), value(v), next(nullptr) {}
-};
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
 
-template<typename K, typename V>
-class UnorderedMap {
-private:
-    KeyValuePair<K,V>* head;
-public:
-    UnorderedMap() : head(nullptr) {}
-    ~UnorderedMap() {
-        KeyValuePair<K,V>* temp = head;
-        while (temp) {
-            KeyValuePair<K,V>* toDel = temp;
-            temp = temp->next;
-            delete toDel;
+    void push(const T& val) { append(val); }
+
+    T pop() {
+        if (!tail) throw std::underflow_error("UnrolledLinkedList is empty, cannot pop.");
+        T returnVal = std::move(tail->items()[tail->count - 1]);
+        Block* prev = nullptr;
+        if (tail->count == 1) {
+            for (Block* b = head; b != tail; b = b->next) prev = b;
         }
+        eraseAt(tail, prev, tail->count - 1);
+        return returnVal;
     }
 
-    void insert(const K& key, const V& val) {
-        KeyValuePair<K,V>* temp = head;
-        while (temp) {
-            if (temp->key == key) {
-                temp->value = val;
-                return;
-            }
-            temp = temp->next;
-        }
-        KeyValuePair<K,V>* newNode = new KeyValuePair<K,V>(key, val);
-        newNode->next = head;
-        head = newNode;
+    T pop_front() {
+        if (!head) throw std::underflow_error("UnrolledLinkedList is empty, cannot pop_front.");
+        T returnVal = std::move(head->items()[0]);
+        eraseAt(head, nullptr, 0);
+        return returnVal;
     }
 
-    V get(const K& key) {
-        KeyValuePair<K,V>* temp = head;
-        while (temp) {
-            if (temp->key == key) {
-                return temp->value;
+    T& front() const {
+        if (!head) throw std::underflow_error("UnrolledLinkedList is empty, cannot view front.");
+        return head->items()[0];
+    }
+
+    T& back() const {
+        if (!tail) throw std::underflow_error("UnrolledLinkedList is empty, cannot view back.");
+        return tail->items()[tail->count - 1];
+    }
+
+    T valAtIndex(std::size_t n) const {
+        std::size_t offset;
+        Block* prev;
+        return locate(n, offset, prev)->items()[offset];
+    }
+
+    int find(const T& x) const {
+        int idx = 0;
+        for (Block* b = head; b; b = b->next) {
+            T* items = b->items();
+            for (std::size_t i = 0; i < b->count; i++, idx++) {
+                if (items[i] == x) return idx;
             }
-            temp = temp->next;
         }
-        throw std::out_of_range("Key not found in UnorderedMap");
+        return -1;
     }
 
-    void remove(const K& key) {
-        KeyValuePair<K,V>* temp = head;
-        KeyValuePair<K,V>* prev = nullptr;
-        while (temp) {
-            if (temp->key == key) {
-                if (!prev) head = temp->next;
-                else prev->next = temp->next;
-                delete temp;
-                return;
+    void insertAtIndex(std::size_t n, const T& val) {
+        if (n == length) {
+            push(val);
+            return;
+        }
+        std::size_t offset;
+        Block* prev;
+        Block* b = locate(n, offset, prev);
+        if (b->count == BLOCK_CAP) {
+            // Split: the upper half moves into a new block after b
+            Block* upper = new Block();
+            std::size_t half = BLOCK_CAP / 2;
+            for (std::size_t j = half; j < BLOCK_CAP; j++) {
+                new (&upper->items()[j - half]) T(std::move(b->items()[j]));
+                b->items()[j].~T();
+            }
+            upper->count = BLOCK_CAP - half;
+            b->count = half;
+            upper->next = b->next;
+            b->next = upper;
+            if (tail == b) tail = upper;
+            if (offset >= half) {
+                b = upper;
+                offset -= half;
             }
-            prev = temp;
-            temp = temp->next;
         }
+        T* items = b->items();
+        if (offset == b->count) {
+            new (&items[offset]) T(val);
+        } else {
+            new (&items[b->count]) T(std::move(items[b->count - 1]));
+            for (std::size_t j = b->count - 1; j > offset; j--) items[j] = std::move(items[j - 1]);
+            items[offset] = val;
+        }
+        b->count++;
+        length++;
     }
 
-    bool contains(const K& key) {
-        KeyValuePair<K,V>* temp = head;
-        while (temp) {
-            if (temp->key == key) return true;
-            temp = temp->next;
+    void popAtIndex(std::size_t n) {
+        std::size_t offset;
+        Block* prev;
+        Block* b = locate(n, offset, prev);
+        eraseAt(b, prev, offset);
+    }
+
+    // Stable sort; elements are repacked into full blocks afterwards
+    void sort() {
+        std::vector<T> buf;
+        buf.reserve(length);
+        for (Block* b = head; b; b = b->next) {
+            for (std::size_t i = 0; i < b->count; i++) buf.push_back(std::move(b->items()[i]));
         }
-        return false;
+        clear();
+        std::stable_sort(buf.begin(), buf.end());
+        for (std::size_t i = 0; i < buf.size(); i++) append(std::move(buf[i]));
     }
 
     void print() {
-        std::cout << "UnorderedMap: ";
-        KeyValuePair<K,V>* temp = head;
-        while (temp) {
-            std::cout << "(" << temp->key << ", " << temp->value << ")";
-            temp = temp->next;
-            if (temp) std::cout << ", ";
+        std::cout << "UnrolledLinkedList: ";
+        for (Block* b = head; b; b = b->next) {
+            for (std::size_t i = 0; i < b->count; i++) {
+                std::cout << b->items()[i];
+                if (i + 1 < b->count || b->next) std::cout << ", ";
+            }
         }
         std::cout << std::endl;
     }
 };
 
 //===================================================
-// Matrix (templated 2D array)
+// Templated Map (B+tree, ordered by key)
 //===================================================
-template<typename T>
-class Matrix {
-public:
-    Matrix(std::size_t rows, std::size_t cols)
-    : m_(rows), n_(cols) {
-        data_ = new T[m_ * n_];
-        for (std::size_t i = 0; i < m_ * n_; i++) {
-            data_[i] = T();
+// Inner nodes hold only separator keys and child pointers. Each node's
+// key array spans about four cache lines, so a lookup touches few lines
+// per level and the tree stays shallow (three levels cover ~250k int keys).
+// All key/value pairs sit in the leaves, which form a doubly linked list,
+// so range scans and in-order walks run leaf to leaf without climbing
+// back up the tree. Every node except the root is kept at least half full.
+// Keys and values must be default-constructible and assignable.
+template<typename K, typename V, typename Compare = std::less<K>>
+class Map {
+private:
+    static const std::size_t NODE_BYTES = 256;
+    static const std::size_t LEAF_CAP = (NODE_BYTES / sizeof(K) < 8) ? 8 : (NODE_BYTES / sizeof(K)) & ~std::size_t(1);
+    static const std::size_t INNER_CAP = LEAF_CAP;   // separators per inner node (even)
+    static const std::size_t LEAF_MIN = LEAF_CAP / 2;
+    static const std::size_t INNER_MIN = INNER_CAP / 2;
+    static const std::size_t MAX_DEPTH = 64;
+
+    struct NodeBase {
+        bool leaf;
+        std::size_t count;   // keys in use
+        explicit NodeBase(bool isLeaf) : leaf(isLeaf), count(0) {}
+    };
+
+    struct alignas(64) Leaf : NodeBase {
+        K keys[LEAF_CAP];
+        V vals[LEAF_CAP];
+        Leaf* prev;
+        Leaf* next;
+        Leaf() : NodeBase(true), prev(nullptr), next(nullptr) {}
+    };
+
+    // child[i] holds keys < keys[i]; child[i+1] holds keys >= keys[i]
+    struct alignas(64) Inner : NodeBase {
+        K keys[INNER_CAP];
+        NodeBase* child[INNER_CAP + 1];
+        Inner() : NodeBase(false) {}
+    };
+
+    NodeBase* root;
+    Leaf* head;          // leftmost leaf
+    std::size_t count;
+    Compare less;
+
+    static Leaf* asLeaf(NodeBase* n) { return static_cast<Leaf*>(n); }
+    static Inner* asInner(NodeBase* n) { return static_cast<Inner*>(n); }
+
+    std::size_t childIndex(const Inner* in, const K& key) const {
+        return std::upper_bound(in->keys, in->keys + in->count, key, less) - in->keys;
+    }
+
+    // Leaf whose range covers key, recording the inner nodes on the way
+    Leaf* descend(const K& key, Inner** path, std::size_t* slot, std::size_t& depth) const {
+        NodeBase* node = root;
+        depth = 0;
+        while (!node->leaf) {
+            Inner* in = asInner(node);
+            std::size_t c = childIndex(in, key);
+            path[depth] = in;
+            slot[depth++] = c;
+            node = in->child[c];
+        }
+        return asLeaf(node);
+    }
+
+    Leaf* findLeaf(const K& key) const {
+        NodeBase* node = root;
+        while (!node->leaf) node = asInner(node)->child[childIndex(asInner(node), key)];
+        return asLeaf(node);
+    }
+
+    static void leafInsertAt(Leaf* l, std::size_t pos, const K& key, const V& val) {
+        for (std::size_t i = l->count; i > pos; i--) {
+            l->keys[i] = std::move(l->keys[i - 1]);
+            l->vals[i] = std::move(l->vals[i - 1]);
+        }
+        l->keys[pos] = key;
+        l->vals[pos] = val;
+        l->count++;
+    }
+
+    static void leafEraseAt(Leaf* l, std::size_t pos) {
+        for (std::size_t i = pos + 1; i < l->count; i++) {
+            l->keys[i - 1] = std::move(l->keys[i]);
+            l->vals[i - 1] = std::move(l->vals[i]);
+        }
+        l->count--;
+    }
+
+    // Removes separator k and the child to its right
+    static void innerEraseAt(Inner* in, std::size_t k) {
+        for (std::size_t i = k + 1; i < in->count; i++) in->keys[i - 1] = std::move(in->keys[i]);
+        for (std::size_t i = k + 2; i <= in->count; i++) in->child[i - 1] = in->child[i];
+        in->count--;
+    }
+
+    void unlinkLeaf(Leaf* l) {
+        if (l->prev) l->prev->next = l->next;
+        else head = l->next;
+        if (l->next) l->next->prev = l->prev;
+    }
+
+    // Puts (sep, right) into the parents on 'path' after a split below
+    void insertUp(Inner** path, std::size_t* slot, std::size_t depth, K sep, NodeBase* right) {
+        while (depth > 0) {
+            Inner* in = path[--depth];
+            std::size_t c = slot[depth];
+            if (in->count < INNER_CAP) {
+                for (std::size_t i = in->count; i > c; i--) in->keys[i] = std::move(in->keys[i - 1]);
+                for (std::size_t i = in->count + 1; i > c + 1; i--) in->child[i] = in->child[i - 1];
+                in->keys[c] = std::move(sep);
+                in->child[c + 1] = right;
+                in->count++;
+                return;
+            }
+            // Full: lay out all INNER_CAP + 1 keys, then send the middle one up
+            K keys[INNER_CAP + 1];
+            NodeBase* kids[INNER_CAP + 2];
+            for (std::size_t i = 0, k = 0; i <= INNER_CAP; i++) keys[i] = (i == c) ? sep : std::move(in->keys[k++]);
+            for (std::size_t i = 0, k = 0; i <= INNER_CAP + 1; i++) kids[i] = (i == c + 1) ? right : in->child[k++];
+            std::size_t mid = (INNER_CAP + 1) / 2;
+            Inner* sib = new Inner;
+            in->count = mid;
+            for (std::size_t i = 0; i < mid; i++) in->keys[i] = std::move(keys[i]);
+            for (std::size_t i = 0; i <= mid; i++) in->child[i] = kids[i];
+            sib->count = INNER_CAP - mid;
+            for (std::size_t i = 0; i < sib->count; i++) sib->keys[i] = std::move(keys[mid + 1 + i]);
+            for (std::size_t i = 0; i <= sib->count; i++) sib->child[i] = kids[mid + 1 + i];
+            sep = std::move(keys[mid]);
+            right = sib;
+        }
+        Inner* top = new Inner;
+        top->keys[0] = std::move(sep);
+        top->child[0] = root;
+        top->child[1] = right;
+        top->count = 1;
+        root = top;
+    }
+
+    // Restores the half-full rule from 'node' upwards after an erase
+    void rebalance(NodeBase* node, Inner** path, std::size_t* slot, std::size_t depth) {
+        while (depth > 0 && node->count < (node->leaf ? LEAF_MIN : INNER_MIN)) {
+            Inner* parent = path[depth - 1];
+            std::size_t c = slot[depth - 1];
+            NodeBase* leftN = (c > 0) ? parent->child[c - 1] : nullptr;
+            NodeBase* rightN = (c < parent->count) ? parent->child[c + 1] : nullptr;
+            if (node->leaf) {
+                Leaf* l = asLeaf(node);
+                Leaf* left = asLeaf(leftN);
+                Leaf* right = asLeaf(rightN);
+                if (left && left->count > LEAF_MIN) {
+                    leafInsertAt(l, 0, left->keys[left->count - 1], left->vals[left->count - 1]);
+                    left->count--;
+                    parent->keys[c - 1] = l->keys[0];
+                    return;
+                }
+                if (right && right->count > LEAF_MIN) {
+                    leafInsertAt(l, l->count, right->keys[0], right->vals[0]);
+                    leafEraseAt(right, 0);
+                    parent->keys[c] = right->keys[0];
+                    return;
+                }
+                Leaf* into = left ? left : l;
+                Leaf* from = left ? l : right;
+                for (std::size_t i = 0; i < from->count; i++) {
+                    into->keys[into->count] = std::move(from->keys[i]);
+                    into->vals[into->count++] = std::move(from->vals[i]);
+                }
+                unlinkLeaf(from);
+                delete from;
+                innerEraseAt(parent, left ? c - 1 : c);
+            } else {
+                Inner* n = asInner(node);
+                Inner* left = asInner(leftN);
+                Inner* right = asInner(rightN);
+                if (left && left->count > INNER_MIN) {
+                    for (std::size_t i = n->count; i > 0; i--) n->keys[i] = std::move(n->keys[i - 1]);
+                    for (std::size_t i = n->count + 1; i > 0; i--) n->child[i] = n->child[i - 1];
+                    n->keys[0] = std::move(parent->keys[c - 1]);
+                    n->child[0] = left->child[left->count];
+                    parent->keys[c - 1] = std::move(left->keys[left->count - 1]);
+                    left->count--;
+                    n->count++;
+                    return;
+                }
+                if (right && right->count > INNER_MIN) {
+                    n->keys[n->count] = std::move(parent->keys[c]);
+                    n->child[n->count + 1] = right->child[0];
+                    n->count++;
+                    parent->keys[c] = std::move(right->keys[0]);
+                    for (std::size_t i = 1; i < right->count; i++) right->keys[i - 1] = std::move(right->keys[i]);
+                    for (std::size_t i = 1; i <= right->count; i++) right->child[i - 1] = right->child[i];
+                    right->count--;
+                    return;
+                }
+                Inner* into = left ? left : n;
+                Inner* from = left ? n : right;
+                std::size_t sepIdx = left ? c - 1 : c;
+                into->keys[into->count] = std::move(parent->keys[sepIdx]);
+                for (std::size_t i = 0; i < from->count; i++) into->keys[into->count + 1 + i] = std::move(from->keys[i]);
+                for (std::size_t i = 0; i <= from->count; i++) into->child[into->count + 1 + i] = from->child[i];
+                into->count += 1 + from->count;
+                delete from;
+                innerEraseAt(parent, sepIdx);
+            }
+            node = parent;
+            depth--;
+        }
+    }
+
+    void freeTree(NodeBase* node) {
+        if (!node) return;
+        if (node->leaf) {
+            delete asLeaf(node);
+            return;
+        }
+        Inner* in = asInner(node);
+        for (std::size_t i = 0; i <= in->count; i++) freeTree(in->child[i]);
+        delete in;
+    }
+
+public:
+    // Position in the leaf chain; stays valid until the map is modified
+    class Cursor {
+    private:
+        const Leaf* leaf;
+        std::size_t idx;
+
+    public:
+        Cursor(const Leaf* l, std::size_t i) : leaf(l), idx(i) {
+            if (leaf && idx == leaf->count) {   // past a leaf's end means the next leaf's start
+                leaf = leaf->next;
+                idx = 0;
+            }
+        }
+        bool valid() const { return leaf != nullptr; }
+        const K& key() const { return leaf->keys[idx]; }
+        const V& value() const { return leaf->vals[idx]; }
+        void next() {
+            if (++idx < leaf->count) return;
+            leaf = leaf->next;
+            idx = 0;
+            if (leaf && leaf->next) prefetchRead(leaf->next);
+        }
+    };
+
+    Map() : root(nullptr), head(nullptr), count(0) {}
+
+    Map(const Map& orig) : Map() {
+        std::vector<std::pair<K, V>> items = orig.range();
+        bulk_load(items.begin(), items.end());
+    }
+
+    Map(Map&& orig) noexcept : root(orig.root), head(orig.head), count(orig.count), less(orig.less) {
+        orig.root = nullptr;
+        orig.head = nullptr;
+        orig.count = 0;
+    }
+
+    Map& operator=(Map orig) {
+        std::swap(root, orig.root);
+        std::swap(head, orig.head);
+        std::swap(count, orig.count);
+        std::swap(less, orig.less);
+        return *this;
+    }
+
+    ~Map() { freeTree(root); }
+
+    void insert(const K& key, const V& val) {
+        if (!root) {
+            head = new Leaf;
+            root = head;
+        }
+        Inner* path[MAX_DEPTH];
+        std::size_t slot[MAX_DEPTH];
+        std::size_t depth;
+        Leaf* leaf = descend(key, path, slot, depth);
+        std::size_t pos = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key, less) - leaf->keys;
+        if (pos < leaf->count && !less(key, leaf->keys[pos])) {
+            leaf->vals[pos] = val;   // key exists, update
+            return;
+        }
+        count++;
+        if (leaf->count < LEAF_CAP) {
+            leafInsertAt(leaf, pos, key, val);
+            return;
+        }
+        Leaf* right = new Leaf;
+        std::size_t half = LEAF_CAP / 2;
+        for (std::size_t i = half; i < LEAF_CAP; i++) {
+            right->keys[i - half] = std::move(leaf->keys[i]);
+            right->vals[i - half] = std::move(leaf->vals[i]);
+        }
+        leaf->count = half;
+        right->count = LEAF_CAP - half;
+        right->next = leaf->next;
+        right->prev = leaf;
+        if (right->next) right->next->prev = right;
+        leaf->next = right;
+        if (pos <= half) leafInsertAt(leaf, pos, key, val);
+        else leafInsertAt(right, pos - half, key, val);
+        insertUp(path, slot, depth, right->keys[0], right);
+    }
+
+    V get(const K& key) const {
+        if (root) {
+            const Leaf* leaf = findLeaf(key);
+            std::size_t pos = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key, less) - leaf->keys;
+            if (pos < leaf->count && !less(key, leaf->keys[pos])) return leaf->vals[pos];
+        }
+        throw std::out_of_range("Key not found in Map");
+    }
+
+    void remove(const K& key) {
+        if (!root) return;
+        Inner* path[MAX_DEPTH];
+        std::size_t slot[MAX_DEPTH];
+        std::size_t depth;
+        Leaf* leaf = descend(key, path, slot, depth);
+        std::size_t pos = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key, less) - leaf->keys;
+        if (pos == leaf->count || less(key, leaf->keys[pos])) return;
+        leafEraseAt(leaf, pos);
+        count--;
+        rebalance(leaf, path, slot, depth);
+        if (!root->leaf && root->count == 0) {
+            Inner* old = asInner(root);
+            root = old->child[0];
+            delete old;
+        }
+        if (root->leaf && root->count == 0) {
+            delete asLeaf(root);
+            root = nullptr;
+            head = nullptr;
+        }
+    }
+
+    bool contains(const K& key) const {
+        if (!root) return false;
+        const Leaf* leaf = findLeaf(key);
+        std::size_t pos = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key, less) - leaf->keys;
+        return pos < leaf->count && !less(key, leaf->keys[pos]);
+    }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void clear() {
+        freeTree(root);
+        root = nullptr;
+        head = nullptr;
+        count = 0;
+    }
+
+    Cursor begin() const { return Cursor(head, 0); }
+
+    // First entry with key >= k
+    Cursor lower_bound(const K& k) const {
+        if (!root) return Cursor(nullptr, 0);
+        const Leaf* leaf = findLeaf(k);
+        return Cursor(leaf, std::lower_bound(leaf->keys, leaf->keys + leaf->count, k, less) - leaf->keys);
+    }
+
+    // First entry with key > k
+    Cursor upper_bound(const K& k) const {
+        if (!root) return Cursor(nullptr, 0);
+        const Leaf* leaf = findLeaf(k);
+        return Cursor(leaf, std::upper_bound(leaf->keys, leaf->keys + leaf->count, k, less) - leaf->keys);
+    }
+
+    // Calls fn(key, value) for every key in [lo, hi), in order
+    template<typename Fn>
+    void range(const K& lo, const K& hi, Fn fn) const {
+        for (Cursor c = lower_bound(lo); c.valid() && less(c.key(), hi); c.next()) fn(c.key(), c.value());
+    }
+
+    std::vector<std::pair<K, V>> range(const K& lo, const K& hi) const {
+        std::vector<std::pair<K, V>> out;
+        range(lo, hi, [&out](const K& k, const V& v) { out.push_back(std::make_pair(k, v)); });
+        return out;
+    }
+
+    // Every entry, in key order
+    std::vector<std::pair<K, V>> range() const {
+        std::vector<std::pair<K, V>> out;
+        out.reserve(count);
+        for (Cursor c = begin(); c.valid(); c.next()) out.push_back(std::make_pair(c.key(), c.value()));
+        return out;
+    }
+
+    // Replaces the contents with (key, value) pairs sorted by strictly
+    // increasing key, building the tree bottom-up in O(n) with every node
+    // at least half full
+    template<typename It>
+    void bulk_load(It first, It last) {
+        std::size_t n = 0;
+        for (It it = first; it != last; ++it, ++n) {
+            It nxt = it;
+            if (++nxt != last && !less(it->first, nxt->first)) throw std::invalid_argument("Map bulk_load: keys not strictly increasing");
+        }
+        clear();
+        if (!n) return;
+        std::vector<NodeBase*> level;
+        std::vector<K> mins;   // smallest key under each node of 'level'
+        std::size_t leaves = (n + LEAF_CAP - 1) / LEAF_CAP;
+        It it = first;
+        Leaf* prev = nullptr;
+        for (std::size_t l = 0; l < leaves; l++) {
+            Leaf* leaf = new Leaf;
+            std::size_t take = n / leaves + (l < n % leaves ? 1 : 0);
+            for (std::size_t i = 0; i < take; i++, ++it) {
+                leaf->keys[i] = it->first;
+                leaf->vals[i] = it->second;
+            }
+            leaf->count = take;
+            leaf->prev = prev;
+            if (prev) prev->next = leaf;
+            else head = leaf;
+            prev = leaf;
+            level.push_back(leaf);
+            mins.push_back(leaf->keys[0]);
+        }
+        while (level.size() > 1) {
+            std::size_t groups = (level.size() + INNER_CAP) / (INNER_CAP + 1);
+            std::vector<NodeBase*> up;
+            std::vector<K> upMins;
+            for (std::size_t g = 0, k = 0; g < groups; g++) {
+                std::size_t kids = level.size() / groups + (g < level.size() % groups ? 1 : 0);
+                Inner* in = new Inner;
+                upMins.push_back(mins[k]);
+                for (std::size_t i = 0; i < kids; i++, k++) {
+                    in->child[i] = level[k];
+                    if (i) in->keys[i - 1] = mins[k];
+                }
+                in->count = kids - 1;
+                up.push_back(in);
+            }
+            level.swap(up);
+            mins.swap(upMins);
+        }
+        root = level[0];
+        count = n;
+    }
+
+    void print() {
+        std::cout << "Map (key->value): ";
+        for (Cursor c = begin(); c.valid(); ) {
+            std::cout << std::make_pair(c.key(), c.value());
+            c.next();
+            if (c.valid()) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+};
+
+//===================================================
+// UnorderedMap (open addressing, Swiss-table style)
+//===================================================
+// Entries live in one flat slot array. A parallel array of control bytes
+// holds either EMPTY or the low 7 bits of the entry's hash (H2), and a probe
+// compares 16 control bytes at once before touching any key. Probing is
+// linear, so erase shifts the rest of the probe run back one slot instead
+// of leaving a tombstone. Each slot's full hash is kept alongside it, so
+// neither that shift nor a rehash calls the user's hash function again.
+// Linear probing clusters as the table fills, so the default load limit
+// is 0.75.
+
+// 16 control bytes compared together (one SSE2 register)
+struct CtrlGroup {
+    static const std::size_t WIDTH = 16;
+
+    // Bit i is set if ctrl[i] == b
+    static unsigned match(const signed char* ctrl, signed char b) {
+#if defined(__SSE2__)
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(b))));
+#else
+        unsigned mask = 0;
+        for (std::size_t i = 0; i < WIDTH; i++) {
+            if (ctrl[i] == b) mask |= (1u << i);
+        }
+        return mask;
+#endif
+    }
+
+    // Bit i is set if ctrl[i] is empty (the only byte with its sign bit set)
+    static unsigned matchEmpty(const signed char* ctrl) {
+#if defined(__SSE2__)
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+        return static_cast<unsigned>(_mm_movemask_epi8(g));
+#else
+        unsigned mask = 0;
+        for (std::size_t i = 0; i < WIDTH; i++) {
+            if (ctrl[i] < 0) mask |= (1u << i);
+        }
+        return mask;
+#endif
+    }
+};
+
+template<typename K, typename V, typename Hash = std::hash<K>>
+class UnorderedMap {
+private:
+    static const signed char EMPTY = -128;
+    static const std::size_t MIN_CAPACITY = 16;
+
+    std::pair<K, V>* slots;
+    std::size_t* hashes;    // hashOf(slots[i].first) for every full slot
+    signed char* ctrl;      // capacity + WIDTH - 1 bytes; the tail mirrors the head
+    std::size_t capacity;   // 0 or a power of two >= MIN_CAPACITY
+    std::size_t count;
+    std::size_t growAt;     // most entries 'capacity' can hold under maxLoad
+    float maxLoad;
+    Hash hasher;
+
+    std::size_t hashOf(const K& key) const {
+        return static_cast<std::size_t>(mixBits(hasher(key)));
+    }
+    static std::size_t h1(std::size_t h) { return h >> 7; }
+    static signed char h2(std::size_t h) { return static_cast<signed char>(h & 0x7F); }
+
+    void setCtrl(std::size_t i, signed char c) {
+        ctrl[i] = c;
+        ctrl[((i - (CtrlGroup::WIDTH - 1)) & (capacity - 1)) + (CtrlGroup::WIDTH - 1)] = c;
+    }
+
+    // Slot holding 'key', or 'capacity' if absent
+    std::size_t findSlot(const K& key) const {
+        if (count == 0) return capacity;
+        std::size_t h = hashOf(key);
+        std::size_t mask = capacity - 1;
+        std::size_t pos = h1(h) & mask;
+        while (true) {
+            const signed char* group = ctrl + pos;
+            unsigned m = CtrlGroup::match(group, h2(h));
+            while (m) {
+                std::size_t i = (pos + countTrailingZeros(m)) & mask;
+                if (slots[i].first == key) return i;
+                m &= m - 1;
+            }
+            // A key always sits before the first empty slot of its probe run
+            if (CtrlGroup::matchEmpty(group)) return capacity;
+            pos = (pos + CtrlGroup::WIDTH) & mask;
+        }
+    }
+
+    // First empty slot on the probe sequence of hash 'h'
+    std::size_t findEmpty(std::size_t h) const {
+        std::size_t mask = capacity - 1;
+        std::size_t pos = h1(h) & mask;
+        while (true) {
+            unsigned m = CtrlGroup::matchEmpty(ctrl + pos);
+            if (m) return (pos + countTrailingZeros(m)) & mask;
+            pos = (pos + CtrlGroup::WIDTH) & mask;
+        }
+    }
+
+    // Most entries 'cap' slots can hold under the load limit
+    std::size_t limitFor(std::size_t cap) const {
+        std::size_t n = static_cast<std::size_t>(cap * maxLoad);
+        return (n < cap) ? n : cap - 1;
+    }
+
+    // Smallest capacity that keeps 'n' entries under the load limit
+    std::size_t capacityFor(std::size_t n) const {
+        std::size_t cap = MIN_CAPACITY;
+        while (n > limitFor(cap)) cap *= 2;
+        return cap;
+    }
+
+    void rehash(std::size_t newCap) {
+        std::pair<K, V>* oldSlots = slots;
+        std::size_t* oldHashes = hashes;
+        signed char* oldCtrl = ctrl;
+        std::size_t oldCap = capacity;
+
+        capacity = newCap;
+        growAt = limitFor(capacity);
+        slots = static_cast<std::pair<K, V>*>(::operator new(sizeof(std::pair<K, V>) * capacity));
+        hashes = new std::size_t[capacity];
+        ctrl = new signed char[capacity + CtrlGroup::WIDTH - 1];
+        for (std::size_t i = 0; i < capacity + CtrlGroup::WIDTH - 1; i++) ctrl[i] = EMPTY;
+
+        for (std::size_t i = 0; i < oldCap; i++) {
+            if (oldCtrl[i] == EMPTY) continue;
+            std::size_t h = oldHashes[i];
+            std::size_t dst = findEmpty(h);
+            new (&slots[dst]) std::pair<K, V>(std::move(oldSlots[i]));
+            hashes[dst] = h;
+            setCtrl(dst, h2(h));
+            oldSlots[i].~pair();
+        }
+        ::operator delete(oldSlots);
+        delete[] oldHashes;
+        delete[] oldCtrl;
+    }
+
+    // Backward-shift deletion: pull later entries of the run into the hole
+    void eraseSlot(std::size_t i) {
+        std::size_t mask = capacity - 1;
+        std::size_t hole = i;
+        std::size_t j = i;
+        while (true) {
+            j = (j + 1) & mask;
+            if (ctrl[j] == EMPTY) break;
+            std::size_t home = h1(hashes[j]) & mask;
+            // Entry j may move only if the hole lies between its home and j
+            if (((j - home) & mask) >= ((j - hole) & mask)) {
+                slots[hole] = std::move(slots[j]);
+                hashes[hole] = hashes[j];
+                setCtrl(hole, ctrl[j]);
+                hole = j;
+            }
+        }
+        slots[hole].~pair();
+        setCtrl(hole, EMPTY);
+        count--;
+    }
+
+public:
+    UnorderedMap()
+    : slots(nullptr), hashes(nullptr), ctrl(nullptr), capacity(0), count(0), growAt(0), maxLoad(0.75f) {}
+    explicit UnorderedMap(const Hash& h)
+    : slots(nullptr), hashes(nullptr), ctrl(nullptr), capacity(0), count(0), growAt(0), maxLoad(0.75f), hasher(h) {}
+    UnorderedMap(const UnorderedMap&) = delete;
+    UnorderedMap& operator=(const UnorderedMap&) = delete;
+
+    UnorderedMap(UnorderedMap&& orig) noexcept
+    : slots(orig.slots), hashes(orig.hashes), ctrl(orig.ctrl), capacity(orig.capacity), count(orig.count),
+      growAt(orig.growAt), maxLoad(orig.maxLoad), hasher(orig.hasher) {
+        orig.slots = nullptr;
+        orig.hashes = nullptr;
+        orig.ctrl = nullptr;
+        orig.capacity = 0;
+        orig.count = 0;
+        orig.growAt = 0;
+    }
+
+    UnorderedMap& operator=(UnorderedMap&& orig) noexcept {
+        std::swap(slots, orig.slots);
+        std::swap(hashes, orig.hashes);
+        std::swap(ctrl, orig.ctrl);
+        std::swap(capacity, orig.capacity);
+        std::swap(count, orig.count);
+        std::swap(growAt, orig.growAt);
+        std::swap(maxLoad, orig.maxLoad);
+        std::swap(hasher, orig.hasher);
+        return *this;
+    }
+
+    ~UnorderedMap() {
+        for (std::size_t i = 0; i < capacity; i++) {
+            if (ctrl[i] != EMPTY) slots[i].~pair();
+        }
+        ::operator delete(slots);
+        delete[] hashes;
+        delete[] ctrl;
+    }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    float load_factor() const { return capacity ? static_cast<float>(count) / capacity : 0.0f; }
+    float max_load_factor() const { return maxLoad; }
+
+    void max_load_factor(float f) {
+        if (f <= 0.0f || f > 0.95f) throw std::invalid_argument("UnorderedMap load factor must be in (0, 0.95]");
+        maxLoad = f;
+        if (!capacity) return;
+        growAt = limitFor(capacity);
+        if (count > growAt) rehash(capacityFor(count));
+    }
+
+    // Size the table so 'n' entries fit without rehashing
+    void reserve(std::size_t n) {
+        std::size_t cap = capacityFor(n);
+        if (cap > capacity) rehash(cap);
+    }
+
+    void insert(const K& key, const V& val) {
+        std::size_t i = findSlot(key);
+        if (i != capacity) {
+            slots[i].second = val;
+            return;
+        }
+        if (count >= growAt) rehash(capacityFor(count + 1));
+        std::size_t h = hashOf(key);
+        i = findEmpty(h);
+        new (&slots[i]) std::pair<K, V>(key, val);
+        hashes[i] = h;
+        setCtrl(i, h2(h));
+        count++;
+    }
+
+    V get(const K& key) {
+        std::size_t i = findSlot(key);
+        if (i == capacity) throw std::out_of_range("Key not found in UnorderedMap");
+        return slots[i].second;
+    }
+
+    void remove(const K& key) {
+        std::size_t i = findSlot(key);
+        if (i != capacity) eraseSlot(i);
+    }
+
+    bool contains(const K& key) const {
+        return findSlot(key) != capacity;
+    }
+
+    // Value stored for key, or nullptr; valid until the next insert/remove
+    V* find(const K& key) {
+        std::size_t i = findSlot(key);
+        return (i == capacity) ? nullptr : &slots[i].second;
+    }
+
+    // Calls fn(key, value) for every entry, in slot order
+    template<typename Fn>
+    void forEach(Fn fn) const {
+        for (std::size_t i = 0; i < capacity; i++) {
+            if (ctrl[i] != EMPTY) fn(slots[i].first, slots[i].second);
+        }
+    }
+
+    void print() {
+        std::cout << "UnorderedMap: ";
+        std::size_t printed = 0;
+        for (std::size_t i = 0; i < capacity; i++) {
+            if (ctrl[i] == EMPTY) continue;
+            std::cout << "(" << slots[i].first << ", " << slots[i].second << ")";
+            if (++printed < count) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+};
+
+//===================================================
+// Caches: LRUCache, ClockCache, ShardedCache
+//===================================================
+// Both caches keep their entries in a CircularLinkedList ring and find
+// nodes through an UnorderedMap<K, Node*> index, so get, put and evict
+// are O(1). Capacity is a budget of entry costs. By default every entry
+// costs 1, so the capacity is an entry count. Pass a cost function (for
+// example one returning a byte size) to bound memory instead. A put evicts
+// only what it must to fit, and the eviction callback, if set, sees each
+// evicted (key, value) just before it is destroyed. It is not called for
+// remove() or clear(), and it must not throw.
+
+template<typename K, typename V>
+class CacheBase {
+public:
+    typedef std::function<std::size_t(const K&, const V&)> CostFn;
+    typedef std::function<void(const K&, const V&)> EvictFn;
+
+protected:
+    std::size_t cap;
+    std::size_t used;
+    CostFn costFn;
+    EvictFn evictFn;
+    std::size_t hitCount;
+    std::size_t missCount;
+
+    CacheBase(std::size_t capacity, const CostFn& cost)
+    : cap(capacity), used(0), costFn(cost), hitCount(0), missCount(0) {}
+
+    std::size_t costOf(const K& key, const V& val) const {
+        std::size_t c = costFn ? costFn(key, val) : 1;
+        if (c > cap) throw std::invalid_argument("Cache entry cost exceeds the cache capacity");
+        return c;
+    }
+
+public:
+    void onEvict(const EvictFn& fn) { evictFn = fn; }
+
+    std::size_t capacity() const { return cap; }
+    std::size_t cost() const { return used; }   // sum of entry costs
+    std::size_t hits() const { return hitCount; }
+    std::size_t misses() const { return missCount; }
+    double hitRatio() const {
+        std::size_t total = hitCount + missCount;
+        return total ? static_cast<double>(hitCount) / total : 0.0;
+    }
+    void resetStats() {
+        hitCount = 0;
+        missCount = 0;
+    }
+};
+
+template<typename K, typename V>
+struct LruEntry {
+    K key;
+    V val;
+    std::size_t cost;
+    Node<LruEntry>* prev;   // ring predecessor
+};
+
+template<typename K, typename V>
+std::ostream& operator<<(std::ostream& os, const LruEntry<K, V>& e) {
+    return os << "(" << e.key << ", " << e.val << ")";
+}
+
+//---------------------------------------------------
+// LRUCache<K,V> - evicts the least recently used entry
+// The ring runs from head (least recent) to tail (most recent). Nodes
+// are singly linked, so each entry also stores its ring predecessor and
+// can be unlinked in O(1). A hit on the head only rotates the ring.
+template<typename K, typename V, typename Hash = std::hash<K>>
+class LRUCache : public CacheBase<K, V>, private CircularLinkedList<LruEntry<K, V>> {
+private:
+    typedef LruEntry<K, V> Entry;
+    typedef CircularLinkedList<Entry> Ring;
+    typedef CacheBase<K, V> Base;
+
+    UnorderedMap<K, Node<Entry>*, Hash> index;
+
+    void linkBack(Node<Entry>* x) {
+        if (!this->head) {
+            x->setNext(x);
+            x->getVal().prev = x;
+            this->head = x;
+            this->tail = x;
+            return;
+        }
+        x->setNext(this->head);
+        x->getVal().prev = this->tail;
+        this->tail->setNext(x);
+        this->head->getVal().prev = x;
+        this->tail = x;
+    }
+
+    void unlink(Node<Entry>* x) {
+        if (x->getNext() == x) {
+            this->head = nullptr;
+            this->tail = nullptr;
+            return;
+        }
+        Node<Entry>* p = x->getVal().prev;
+        Node<Entry>* s = x->getNext();
+        p->setNext(s);
+        s->getVal().prev = p;
+        if (x == this->head) this->head = s;
+        if (x == this->tail) this->tail = p;
+    }
+
+    // Makes x the most recently used entry
+    void touch(Node<Entry>* x) {
+        if (x == this->tail) return;
+        if (x == this->head) {   // the ring is already in order, just turn it
+            this->tail = this->head;
+            this->head = this->head->getNext();
+            return;
+        }
+        unlink(x);
+        linkBack(x);
+    }
+
+    void evictOne() {
+        Node<Entry>* victim = this->head;
+        unlink(victim);
+        Entry& e = victim->getVal();
+        index.remove(e.key);
+        this->used -= e.cost;
+        if (this->evictFn) this->evictFn(e.key, e.val);
+        this->freeNode(victim);
+    }
+
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef typename Base::CostFn CostFn;
+
+    explicit LRUCache(std::size_t capacity, const CostFn& cost = CostFn()) : Base(capacity, cost) {}
+    LRUCache(const LRUCache&) = delete;
+    LRUCache& operator=(const LRUCache&) = delete;
+
+    // On a hit copies the value to 'out' and marks the entry most recent
+    bool try_get(const K& key, V& out) {
+        Node<Entry>** slot = index.find(key);
+        if (!slot) {
+            this->missCount++;
+            return false;
+        }
+        this->hitCount++;
+        touch(*slot);
+        out = (*slot)->getVal().val;
+        return true;
+    }
+
+    V get(const K& key) {
+        V out;
+        if (!try_get(key, out)) throw std::out_of_range("Key not found in LRUCache");
+        return out;
+    }
+
+    // Inserts or replaces the value, evicting least recent entries to fit
+    void put(const K& key, const V& val) {
+        std::size_t c = this->costOf(key, val);
+        Node<Entry>** slot = index.find(key);
+        if (slot) {
+            Node<Entry>* x = *slot;
+            this->used -= x->getVal().cost;
+            x->getVal().val = val;
+            x->getVal().cost = c;
+            touch(x);
+            this->used += c;
+            while (this->used > this->cap) evictOne();   // never reaches x, which fits alone
+            return;
+        }
+        while (this->used + c > this->cap) evictOne();
+        Node<Entry>* x = this->makeNode(Entry{key, val, c, nullptr});
+        linkBack(x);
+        index.insert(key, x);
+        this->used += c;
+    }
+
+    // Looks the key up without counting a hit or changing recency
+    bool contains(const K& key) const { return index.contains(key); }
+
+    void remove(const K& key) {
+        Node<Entry>** slot = index.find(key);
+        if (!slot) return;
+        Node<Entry>* x = *slot;
+        unlink(x);
+        this->used -= x->getVal().cost;
+        index.remove(key);
+        this->freeNode(x);
+    }
+
+    // Evicts least recent entries until the total cost fits
+    void setCapacity(std::size_t capacity) {
+        this->cap = capacity;
+        while (this->used > this->cap) evictOne();
+    }
+
+    std::size_t size() const { return index.size(); }
+    bool empty() const { return index.empty(); }
+
+    void clear() {
+        Ring::clear();
+        index = UnorderedMap<K, Node<Entry>*, Hash>();
+        this->used = 0;
+    }
+
+    void print() override {
+        std::cout << "LRUCache (least->most recent): ";
+        Node<Entry>* temp = this->head;
+        while (temp) {
+            std::cout << temp->getVal();
+            temp = (temp == this->tail) ? nullptr : temp->getNext();
+            if (temp) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+};
+
+template<typename K, typename V>
+struct ClockEntry {
+    K key;
+    V val;
+    std::size_t cost;
+    bool referenced;   // used since the hand last passed
+    bool live;         // false once removed; the hand frees it later
+};
+
+template<typename K, typename V>
+std::ostream& operator<<(std::ostream& os, const ClockEntry<K, V>& e) {
+    return os << "(" << e.key << ", " << e.val << ")";
+}
+
+//---------------------------------------------------
+// ClockCache<K,V> - CLOCK (second chance) approximation of LRU
+// The ring's head is the clock hand and new entries go in just behind it.
+// A hit only sets the entry's referenced bit, so reads never relink
+// nodes. To evict, the hand clears set bits as it passes and takes the
+// first entry whose bit is already clear. remove() marks the node dead
+// and the hand frees it later. Dead nodes are swept in one pass once
+// they outnumber live ones, so remove() is amortized O(1).
+template<typename K, typename V, typename Hash = std::hash<K>>
+class ClockCache : public CacheBase<K, V>, private CircularLinkedList<ClockEntry<K, V>> {
+private:
+    typedef ClockEntry<K, V> Entry;
+    typedef CircularLinkedList<Entry> Ring;
+    typedef CacheBase<K, V> Base;
+
+    UnorderedMap<K, Node<Entry>*, Hash> index;
+    std::size_t dead;
+
+    // Takes the node under the hand off the ring; the hand moves on
+    Node<Entry>* popHand() {
+        Node<Entry>* x = this->head;
+        if (x == this->tail) {
+            this->head = nullptr;
+            this->tail = nullptr;
+        } else {
+            this->head = x->getNext();
+            this->tail->setNext(this->head);
+        }
+        return x;
+    }
+
+    // Takes the next victim under the hand, stepping over 'keep'
+    void evictOne(Node<Entry>* keep = nullptr) {
+        while (true) {
+            Entry& e = this->head->getVal();
+            if (!e.live) {
+                this->freeNode(popHand());
+                dead--;
+            } else if (this->head == keep) {
+                this->tail = this->head;
+                this->head = this->head->getNext();
+            } else if (e.referenced) {
+                e.referenced = false;
+                this->tail = this->head;
+                this->head = this->head->getNext();
+            } else {
+                break;
+            }
+        }
+        Node<Entry>* victim = popHand();
+        Entry& e = victim->getVal();
+        index.remove(e.key);
+        this->used -= e.cost;
+        if (this->evictFn) this->evictFn(e.key, e.val);
+        this->freeNode(victim);
+    }
+
+    // Frees every dead node in one trip around the ring
+    void sweepDead() {
+        std::size_t n = index.size() + dead;
+        Node<Entry>* cur = this->head;
+        Node<Entry>* first = nullptr;
+        Node<Entry>* last = nullptr;
+        for (std::size_t i = 0; i < n; i++) {
+            Node<Entry>* next = cur->getNext();
+            if (cur->getVal().live) {
+                if (last) last->setNext(cur);
+                else first = cur;
+                last = cur;
+            } else {
+                this->freeNode(cur);
+            }
+            cur = next;
+        }
+        if (last) last->setNext(first);
+        this->head = first;
+        this->tail = last;
+        dead = 0;
+    }
+
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef typename Base::CostFn CostFn;
+
+    explicit ClockCache(std::size_t capacity, const CostFn& cost = CostFn()) : Base(capacity, cost), dead(0) {}
+    ClockCache(const ClockCache&) = delete;
+    ClockCache& operator=(const ClockCache&) = delete;
+
+    // On a hit copies the value to 'out' and sets the referenced bit
+    bool try_get(const K& key, V& out) {
+        Node<Entry>** slot = index.find(key);
+        if (!slot) {
+            this->missCount++;
+            return false;
+        }
+        this->hitCount++;
+        (*slot)->getVal().referenced = true;
+        out = (*slot)->getVal().val;
+        return true;
+    }
+
+    V get(const K& key) {
+        V out;
+        if (!try_get(key, out)) throw std::out_of_range("Key not found in ClockCache");
+        return out;
+    }
+
+    // Inserts or replaces the value, running the hand to make room
+    void put(const K& key, const V& val) {
+        std::size_t c = this->costOf(key, val);
+        Node<Entry>** slot = index.find(key);
+        if (slot) {
+            Node<Entry>* x = *slot;
+            Entry& e = x->getVal();
+            this->used -= e.cost;
+            e.val = val;
+            e.cost = c;
+            e.referenced = true;
+            this->used += c;
+            // x is never the victim; once it is the only live entry it fits
+            while (this->used > this->cap) evictOne(x);
+            return;
+        }
+        while (this->used + c > this->cap) evictOne();
+        Node<Entry>* x = this->makeNode(Entry{key, val, c, false, true});
+        if (!this->head) {
+            x->setNext(x);
+            this->head = x;
+        } else {
+            x->setNext(this->head);
+            this->tail->setNext(x);
+        }
+        this->tail = x;
+        index.insert(key, x);
+        this->used += c;
+    }
+
+    // Looks the key up without counting a hit or setting the bit
+    bool contains(const K& key) const { return index.contains(key); }
+
+    void remove(const K& key) {
+        Node<Entry>** slot = index.find(key);
+        if (!slot) return;
+        Entry& e = (*slot)->getVal();
+        e.live = false;
+        this->used -= e.cost;
+        index.remove(key);
+        if (++dead > index.size()) sweepDead();
+    }
+
+    // Runs the hand until the total cost fits
+    void setCapacity(std::size_t capacity) {
+        this->cap = capacity;
+        while (this->used > this->cap) evictOne();
+    }
+
+    std::size_t size() const { return index.size(); }
+    bool empty() const { return index.empty(); }
+
+    void clear() {
+        Ring::clear();
+        index = UnorderedMap<K, Node<Entry>*, Hash>();
+        this->used = 0;
+        dead = 0;
+    }
+
+    void print() override {
+        std::cout << "ClockCache (from the hand): ";
+        std::size_t printed = 0;
+        Node<Entry>* temp = this->head;
+        while (temp) {
+            if (temp->getVal().live) {
+                if (printed++) std::cout << ", ";
+                std::cout << temp->getVal() << (temp->getVal().referenced ? "*" : "");
+            }
+            temp = (temp == this->tail) ? nullptr : temp->getNext();
+        }
+        std::cout << std::endl;
+    }
+};
+
+//---------------------------------------------------
+// ShardedCache<K,V,Cache> - a cache split by key hash for many threads
+// Each shard is an independent Cache with its own mutex and an equal
+// share of the capacity, so threads working on different shards never
+// contend. The shard comes from the top bits of the mixed hash, which
+// UnorderedMap does not use for its slot index. Eviction is per shard,
+// so the policy is only approximately LRU/CLOCK across the whole cache.
+// Likewise, with a cost function an entry must fit within one shard's
+// share of the capacity, not just the total.
+// The eviction callback runs while its shard is locked.
+template<typename K, typename V, typename Cache = LRUCache<K, V>, typename Hash = std::hash<K>>
+class ShardedCache {
+private:
+    struct alignas(64) Shard {
+        std::mutex lock;
+        std::unique_ptr<Cache> cache;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    std::size_t shardCount;   // a power of two, at most 2^16 and at most the capacity
+    Hash hasher;
+
+    Shard& shardFor(const K& key) {
+        return shards[(mixBits(hasher(key)) >> 48) & (shardCount - 1)];
+    }
+
+    template<typename Fn>
+    std::size_t total(Fn fn) {
+        std::size_t sum = 0;
+        for (std::size_t i = 0; i < shardCount; i++) {
+            std::lock_guard<std::mutex> guard(shards[i].lock);
+            sum += fn(*shards[i].cache);
+        }
+        return sum;
+    }
+
+public:
+    typedef typename CacheBase<K, V>::CostFn CostFn;
+    typedef typename CacheBase<K, V>::EvictFn EvictFn;
+
+    // The shard count is rounded up to a power of two, then halved until
+    // every shard gets a capacity of at least 1
+    ShardedCache(std::size_t capacity, std::size_t shardsWanted, const CostFn& cost = CostFn()) : shardCount(1) {
+        if (shardsWanted == 0 || shardsWanted > 65536) throw std::invalid_argument("ShardedCache needs 1 to 65536 shards");
+        if (capacity == 0) throw std::invalid_argument("ShardedCache capacity must be positive");
+        while (shardCount < shardsWanted) shardCount <<= 1;
+        while (shardCount > capacity) shardCount >>= 1;
+        shards.reset(new Shard[shardCount]);
+        for (std::size_t i = 0; i < shardCount; i++) {
+            // Spread the remainder so the shard capacities add up to 'capacity'
+            shards[i].cache.reset(new Cache(capacity / shardCount + (i < capacity % shardCount ? 1 : 0), cost));
+        }
+    }
+    ShardedCache(const ShardedCache&) = delete;
+    ShardedCache& operator=(const ShardedCache&) = delete;
+
+    void onEvict(const EvictFn& fn) {
+        for (std::size_t i = 0; i < shardCount; i++) {
+            std::lock_guard<std::mutex> guard(shards[i].lock);
+            shards[i].cache->onEvict(fn);
+        }
+    }
+
+    bool try_get(const K& key, V& out) {
+        Shard& s = shardFor(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        return s.cache->try_get(key, out);
+    }
+
+    V get(const K& key) {
+        V out;
+        if (!try_get(key, out)) throw std::out_of_range("Key not found in ShardedCache");
+        return out;
+    }
+
+    void put(const K& key, const V& val) {
+        Shard& s = shardFor(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.cache->put(key, val);
+    }
+
+    bool contains(const K& key) {
+        Shard& s = shardFor(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        return s.cache->contains(key);
+    }
+
+    void remove(const K& key) {
+        Shard& s = shardFor(key);
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.cache->remove(key);
+    }
+
+    // Totals over all shards; each shard is read under its own lock, so
+    // under concurrent use the sum is not one consistent snapshot
+    std::size_t size() { return total([](const Cache& c) { return c.size(); }); }
+    std::size_t cost() { return total([](const Cache& c) { return c.cost(); }); }
+    std::size_t hits() { return total([](const Cache& c) { return c.hits(); }); }
+    std::size_t misses() { return total([](const Cache& c) { return c.misses(); }); }
+    double hitRatio() {
+        std::size_t h = hits(), m = misses();
+        return (h + m) ? static_cast<double>(h) / (h + m) : 0.0;
+    }
+    std::size_t shardsUsed() const { return shardCount; }
+
+    void clear() {
+        for (std::size_t i = 0; i < shardCount; i++) {
+            std::lock_guard<std::mutex> guard(shards[i].lock);
+            shards[i].cache->clear();
+        }
+    }
+};
+
+//===================================================
+// GEMM kernels (C += A * B, row-major)
+//===================================================
+// Goto/BLIS-style blocking: B is packed one KC x NC block at a time into
+// NR-wide column panels, and A one MC x KC block at a time into MR-tall row
+// panels. Each packed A panel stays in L2 while it meets every B panel, and
+// the micro-kernel keeps an MR x NR tile of C in registers across the whole
+// KC loop. Edge tiles are zero-padded when packed, so the kernel always
+// computes a full tile; only the valid part is added back to C.
+
+// Portable micro-kernel; simple enough for the compiler to vectorise
+template<typename T>
+struct GemmKernel {
+    static const std::size_t MR = 4;
+    static const std::size_t NR = 8;
+
+    static void run(std::size_t kc, const T* a, const T* b, T* c, std::size_t ldc) {
+        T acc[MR][NR] = {};
+        for (std::size_t p = 0; p < kc; p++) {
+            for (std::size_t i = 0; i < MR; i++) {
+                T ai = a[p * MR + i];
+                for (std::size_t j = 0; j < NR; j++) acc[i][j] += ai * b[p * NR + j];
+            }
+        }
+        for (std::size_t i = 0; i < MR; i++) {
+            for (std::size_t j = 0; j < NR; j++) c[i * ldc + j] += acc[i][j];
+        }
+    }
+};
+
+#if defined(__AVX512F__)
+// 12x32 floats: twenty-four zmm accumulators, two B vectors, one broadcast
+template<>
+struct GemmKernel<float> {
+    static const std::size_t MR = 12;
+    static const std::size_t NR = 32;
+
+    static void run(std::size_t kc, const float* a, const float* b, float* c, std::size_t ldc) {
+        __m512 acc[MR][2];
+        for (std::size_t i = 0; i < MR; i++) acc[i][0] = acc[i][1] = _mm512_setzero_ps();
+        for (std::size_t p = 0; p < kc; p++) {
+            __m512 b0 = _mm512_loadu_ps(b + p * NR);
+            __m512 b1 = _mm512_loadu_ps(b + p * NR + 16);
+            for (std::size_t i = 0; i < MR; i++) {
+                __m512 ai = _mm512_set1_ps(a[p * MR + i]);
+                acc[i][0] = _mm512_fmadd_ps(ai, b0, acc[i][0]);
+                acc[i][1] = _mm512_fmadd_ps(ai, b1, acc[i][1]);
+            }
+        }
+        for (std::size_t i = 0; i < MR; i++) {
+            float* row = c + i * ldc;
+            _mm512_storeu_ps(row,      _mm512_add_ps(_mm512_loadu_ps(row),      acc[i][0]));
+            _mm512_storeu_ps(row + 16, _mm512_add_ps(_mm512_loadu_ps(row + 16), acc[i][1]));
+        }
+    }
+};
+
+// 12x16 doubles, same register budget as the float kernel
+template<>
+struct GemmKernel<double> {
+    static const std::size_t MR = 12;
+    static const std::size_t NR = 16;
+
+    static void run(std::size_t kc, const double* a, const double* b, double* c, std::size_t ldc) {
+        __m512d acc[MR][2];
+        for (std::size_t i = 0; i < MR; i++) acc[i][0] = acc[i][1] = _mm512_setzero_pd();
+        for (std::size_t p = 0; p < kc; p++) {
+            __m512d b0 = _mm512_loadu_pd(b + p * NR);
+            __m512d b1 = _mm512_loadu_pd(b + p * NR + 8);
+            for (std::size_t i = 0; i < MR; i++) {
+                __m512d ai = _mm512_set1_pd(a[p * MR + i]);
+                acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+                acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+            }
+        }
+        for (std::size_t i = 0; i < MR; i++) {
+            double* row = c + i * ldc;
+            _mm512_storeu_pd(row,     _mm512_add_pd(_mm512_loadu_pd(row),     acc[i][0]));
+            _mm512_storeu_pd(row + 8, _mm512_add_pd(_mm512_loadu_pd(row + 8), acc[i][1]));
+        }
+    }
+};
+#elif defined(__AVX2__) && defined(__FMA__)
+// 6x16 floats: twelve ymm accumulators, two B vectors, one broadcast
+template<>
+struct GemmKernel<float> {
+    static const std::size_t MR = 6;
+    static const std::size_t NR = 16;
+
+    static void run(std::size_t kc, const float* a, const float* b, float* c, std::size_t ldc) {
+        __m256 acc[MR][2];
+        for (std::size_t i = 0; i < MR; i++) acc[i][0] = acc[i][1] = _mm256_setzero_ps();
+        for (std::size_t p = 0; p < kc; p++) {
+            __m256 b0 = _mm256_loadu_ps(b + p * NR);
+            __m256 b1 = _mm256_loadu_ps(b + p * NR + 8);
+            for (std::size_t i = 0; i < MR; i++) {
+                __m256 ai = _mm256_broadcast_ss(a + p * MR + i);
+                acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+                acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+            }
+        }
+        for (std::size_t i = 0; i < MR; i++) {
+            float* row = c + i * ldc;
+            _mm256_storeu_ps(row,     _mm256_add_ps(_mm256_loadu_ps(row),     acc[i][0]));
+            _mm256_storeu_ps(row + 8, _mm256_add_ps(_mm256_loadu_ps(row + 8), acc[i][1]));
+        }
+    }
+};
+
+// 6x8 doubles, same register budget as the float kernel
+template<>
+struct GemmKernel<double> {
+    static const std::size_t MR = 6;
+    static const std::size_t NR = 8;
+
+    static void run(std::size_t kc, const double* a, const double* b, double* c, std::size_t ldc) {
+        __m256d acc[MR][2];
+        for (std::size_t i = 0; i < MR; i++) acc[i][0] = acc[i][1] = _mm256_setzero_pd();
+        for (std::size_t p = 0; p < kc; p++) {
+            __m256d b0 = _mm256_loadu_pd(b + p * NR);
+            __m256d b1 = _mm256_loadu_pd(b + p * NR + 4);
+            for (std::size_t i = 0; i < MR; i++) {
+                __m256d ai = _mm256_broadcast_sd(a + p * MR + i);
+                acc[i][0] = _mm256_fmadd_pd(ai, b0, acc[i][0]);
+                acc[i][1] = _mm256_fmadd_pd(ai, b1, acc[i][1]);
+            }
+        }
+        for (std::size_t i = 0; i < MR; i++) {
+            double* row = c + i * ldc;
+            _mm256_storeu_pd(row,     _mm256_add_pd(_mm256_loadu_pd(row),     acc[i][0]));
+            _mm256_storeu_pd(row + 4, _mm256_add_pd(_mm256_loadu_pd(row + 4), acc[i][1]));
+        }
+    }
+};
+#endif
+
+template<typename T>
+class Gemm {
+private:
+    typedef GemmKernel<T> K;
+    static const std::size_t KC = 256;           // packed A panel ~ L2, B panel slice ~ L1
+    static const std::size_t MC = K::MR * 16;
+    static const std::size_t NC = K::NR * 256;   // packed B block ~ L3
+    static const std::size_t MIN_WORK = std::size_t(1) << 21;  // multiply-adds per extra thread
+    static const std::size_t SMALL_WORK = std::size_t(1) << 11; // below this, packing costs more than it saves
+
+    // Packing space, kept per thread and only ever grown, so repeated
+    // products (and every block of an out-of-core multiply) reuse it
+    struct PackBuffer {
+        std::unique_ptr<T[]> data;
+        std::size_t size;
+
+        PackBuffer() : size(0) {}
+        T* reserve(std::size_t n) {
+            if (n > size) {
+                data.reset(new T[n]);
+                size = n;
+            }
+            return data.get();
+        }
+    };
+
+    static std::size_t roundUp(std::size_t x, std::size_t r) { return (x + r - 1) / r * r; }
+
+    // C += A * B with no packing, for products too small to amortise it
+    static void direct(std::size_t m, std::size_t n, std::size_t k,
+                       const T* A, std::size_t lda, const T* B, std::size_t ldb,
+                       T* C, std::size_t ldc) {
+        for (std::size_t i = 0; i < m; i++) {
+            T* crow = C + i * ldc;
+            for (std::size_t p = 0; p < k; p++) {
+                T a = A[i * lda + p];
+                const T* brow = B + p * ldb;
+                for (std::size_t j = 0; j < n; j++) crow[j] += a * brow[j];
+            }
+        }
+    }
+
+    // B[kc x nc] -> panels of NR columns, each stored row by row
+    static void packB(std::size_t kc, std::size_t nc, const T* B, std::size_t ldb, T* out) {
+        for (std::size_t j = 0; j < nc; j += K::NR) {
+            std::size_t nr = (nc - j < K::NR) ? nc - j : K::NR;
+            for (std::size_t p = 0; p < kc; p++) {
+                const T* src = B + p * ldb + j;
+                for (std::size_t jj = 0; jj < K::NR; jj++) *out++ = (jj < nr) ? src[jj] : T();
+            }
+        }
+    }
+
+    // A[mc x kc] -> panels of MR rows, each stored column by column
+    static void packA(std::size_t mc, std::size_t kc, const T* A, std::size_t lda, T* out) {
+        for (std::size_t i = 0; i < mc; i += K::MR) {
+            std::size_t mr = (mc - i < K::MR) ? mc - i : K::MR;
+            for (std::size_t p = 0; p < kc; p++) {
+                for (std::size_t ii = 0; ii < K::MR; ii++) *out++ = (ii < mr) ? A[(i + ii) * lda + p] : T();
+            }
+        }
+    }
+
+    // Single-threaded blocked multiply of an m-row slice
+    static void blocked(std::size_t m, std::size_t n, std::size_t k,
+                        const T* A, std::size_t lda, const T* B, std::size_t ldb,
+                        T* C, std::size_t ldc) {
+        thread_local PackBuffer packedA, packedB;
+        std::size_t kcMax = (k < KC) ? k : KC;
+        T* bufA = packedA.reserve(roundUp((m < MC) ? m : MC, K::MR) * kcMax);
+        T* bufB = packedB.reserve(roundUp((n < NC) ? n : NC, K::NR) * kcMax);
+        T edge[K::MR * K::NR];
+        for (std::size_t jc = 0; jc < n; jc += NC) {
+            std::size_t nc = (n - jc < NC) ? n - jc : NC;
+            for (std::size_t pc = 0; pc < k; pc += KC) {
+                std::size_t kc = (k - pc < KC) ? k - pc : KC;
+                packB(kc, nc, B + pc * ldb + jc, ldb, bufB);
+                for (std::size_t ic = 0; ic < m; ic += MC) {
+                    std::size_t mc = (m - ic < MC) ? m - ic : MC;
+                    packA(mc, kc, A + ic * lda + pc, lda, bufA);
+                    for (std::size_t jr = 0; jr < nc; jr += K::NR) {
+                        std::size_t nr = (nc - jr < K::NR) ? nc - jr : K::NR;
+                        const T* b = bufB + jr * kc;
+                        for (std::size_t ir = 0; ir < mc; ir += K::MR) {
+                            std::size_t mr = (mc - ir < K::MR) ? mc - ir : K::MR;
+                            const T* a = bufA + ir * kc;
+                            T* c = C + (ic + ir) * ldc + jc + jr;
+                            if (mr == K::MR && nr == K::NR) {
+                                K::run(kc, a, b, c, ldc);
+                                continue;
+                            }
+                            for (std::size_t e = 0; e < K::MR * K::NR; e++) edge[e] = T();
+                            K::run(kc, a, b, edge, K::NR);
+                            for (std::size_t i = 0; i < mr; i++) {
+                                for (std::size_t j = 0; j < nr; j++) c[i * ldc + j] += edge[i * K::NR + j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    // C[m x n] += A[m x k] * B[k x n]. With threads > 1 the rows of C are
+    // split into MR-aligned slices, one per thread, so no two threads write
+    // the same output tile. Each thread gets at least MIN_WORK multiply-adds,
+    // so a small product stays on the calling thread whatever is asked for,
+    // and one under SMALL_WORK skips packing altogether.
+    static void multiply(std::size_t m, std::size_t n, std::size_t k,
+                         const T* A, std::size_t lda, const T* B, std::size_t ldb,
+                         T* C, std::size_t ldc, unsigned threads = 1) {
+        if (!m || !n || !k) return;
+        std::size_t maxThreads = (m + MC - 1) / MC;
+        std::size_t work = m * n;
+        work = (work / n == m && work <= std::size_t(-1) / k) ? work * k : std::size_t(-1);
+        if (work < SMALL_WORK) {
+            direct(m, n, k, A, lda, B, ldb, C, ldc);
+            return;
+        }
+        if (maxThreads > work / MIN_WORK) maxThreads = work / MIN_WORK;
+        if (threads > maxThreads) threads = static_cast<unsigned>(maxThreads);
+        if (threads < 2) {
+            blocked(m, n, k, A, lda, B, ldb, C, ldc);
+            return;
+        }
+        std::size_t slice = (m + threads - 1) / threads;
+        slice = (slice + K::MR - 1) / K::MR * K::MR;
+        std::vector<std::thread> workers;
+        for (std::size_t r = 0; r < m; r += slice) {
+            std::size_t rows = (m - r < slice) ? m - r : slice;
+            workers.emplace_back([=]() { blocked(rows, n, k, A + r * lda, lda, B, ldb, C + r * ldc, ldc); });
+        }
+        for (std::thread& w : workers) w.join();
+    }
+};
+
+//===================================================
+// Expression templates for element-wise Matrix / MdSpan arithmetic
+//===================================================
+// The element-wise operators return small expression nodes, not
+// temporaries. Nothing is computed until the expression is assigned to a
+// Matrix or MdSpan or reduced with sum(). At that point one loop walks the
+// flat row-major storage once, with every operation fused into its body.
+// Leaves (Matrix, MdSpan) are held by reference and inner nodes by value,
+// so an expression must be evaluated while the matrices it names are alive.
+template<typename E>
+struct MatExpr {
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+template<typename E>
+struct ExprHolder {
+    typedef typename std::conditional<E::IS_LEAF, const E&, const E>::type type;
+};
+
+struct OpAdd { template<typename A> static A apply(const A& a, const A& b) { return a + b; } };
+struct OpSub { template<typename A> static A apply(const A& a, const A& b) { return a - b; } };
+struct OpMul { template<typename A> static A apply(const A& a, const A& b) { return a * b; } };
+struct OpDiv { template<typename A> static A apply(const A& a, const A& b) { return a / b; } };
+
+template<typename L, typename R, typename Op>
+class MatBinaryExpr : public MatExpr<MatBinaryExpr<L, R, Op>> {
+private:
+    typename ExprHolder<L>::type lhs;
+    typename ExprHolder<R>::type rhs;
+
+public:
+    typedef typename L::value_type value_type;
+    static const bool IS_LEAF = false;
+
+    MatBinaryExpr(const L& l, const R& r) : lhs(l), rhs(r) {
+        if (l.rows() != r.rows() || l.cols() != r.cols()) {
+            throw std::invalid_argument("Matrix dimensions do not match");
+        }
+    }
+    std::size_t rows() const { return lhs.rows(); }
+    std::size_t cols() const { return lhs.cols(); }
+    value_type flat(std::size_t i) const { return Op::apply(lhs.flat(i), rhs.flat(i)); }
+};
+
+// Expression combined with a scalar; SCALAR_LEFT picks 's op e' over 'e op s'
+template<typename E, typename Op, bool SCALAR_LEFT>
+class MatScalarExpr : public MatExpr<MatScalarExpr<E, Op, SCALAR_LEFT>> {
+public:
+    typedef typename E::value_type value_type;
+    static const bool IS_LEAF = false;
+
+private:
+    typename ExprHolder<E>::type expr;
+    value_type s;
+
+public:
+    MatScalarExpr(const E& e, const value_type& scalar) : expr(e), s(scalar) {}
+    std::size_t rows() const { return expr.rows(); }
+    std::size_t cols() const { return expr.cols(); }
+    value_type flat(std::size_t i) const {
+        return SCALAR_LEFT ? Op::apply(s, expr.flat(i)) : Op::apply(expr.flat(i), s);
+    }
+};
+
+template<typename L, typename R>
+MatBinaryExpr<L, R, OpAdd> operator+(const MatExpr<L>& l, const MatExpr<R>& r) {
+    return MatBinaryExpr<L, R, OpAdd>(l.self(), r.self());
+}
+
+template<typename L, typename R>
+MatBinaryExpr<L, R, OpSub> operator-(const MatExpr<L>& l, const MatExpr<R>& r) {
+    return MatBinaryExpr<L, R, OpSub>(l.self(), r.self());
+}
+
+// Element-wise product (operator* between matrices is the matrix product)
+template<typename L, typename R>
+MatBinaryExpr<L, R, OpMul> hadamard(const MatExpr<L>& l, const MatExpr<R>& r) {
+    return MatBinaryExpr<L, R, OpMul>(l.self(), r.self());
+}
+
+template<typename E>
+MatScalarExpr<E, OpMul, false> operator*(const MatExpr<E>& e, const typename E::value_type& s) {
+    return MatScalarExpr<E, OpMul, false>(e.self(), s);
+}
+
+template<typename E>
+MatScalarExpr<E, OpMul, true> operator*(const typename E::value_type& s, const MatExpr<E>& e) {
+    return MatScalarExpr<E, OpMul, true>(e.self(), s);
+}
+
+template<typename E>
+MatScalarExpr<E, OpDiv, false> operator/(const MatExpr<E>& e, const typename E::value_type& s) {
+    return MatScalarExpr<E, OpDiv, false>(e.self(), s);
+}
+
+template<typename E>
+MatScalarExpr<E, OpAdd, false> operator+(const MatExpr<E>& e, const typename E::value_type& s) {
+    return MatScalarExpr<E, OpAdd, false>(e.self(), s);
+}
+
+template<typename E>
+MatScalarExpr<E, OpSub, false> operator-(const MatExpr<E>& e, const typename E::value_type& s) {
+    return MatScalarExpr<E, OpSub, false>(e.self(), s);
+}
+
+template<typename E>
+MatScalarExpr<E, OpDiv, true> operator/(const typename E::value_type& s, const MatExpr<E>& e) {
+    return MatScalarExpr<E, OpDiv, true>(e.self(), s);
+}
+
+template<typename E>
+MatScalarExpr<E, OpAdd, true> operator+(const typename E::value_type& s, const MatExpr<E>& e) {
+    return MatScalarExpr<E, OpAdd, true>(e.self(), s);
+}
+
+template<typename E>
+MatScalarExpr<E, OpSub, true> operator-(const typename E::value_type& s, const MatExpr<E>& e) {
+    return MatScalarExpr<E, OpSub, true>(e.self(), s);
+}
+
+template<typename E>
+MatScalarExpr<E, OpSub, true> operator-(const MatExpr<E>& e) {
+    return MatScalarExpr<E, OpSub, true>(e.self(), typename E::value_type());
+}
+
+// Reductions run the whole expression in a single pass
+template<typename E>
+typename E::value_type sum(const MatExpr<E>& expr) {
+    const E& e = expr.self();
+    typename E::value_type acc = typename E::value_type();
+    std::size_t n = e.rows() * e.cols();
+    for (std::size_t i = 0; i < n; i++) acc += e.flat(i);
+    return acc;
+}
+
+template<typename L, typename R>
+typename L::value_type dot(const MatExpr<L>& l, const MatExpr<R>& r) {
+    return sum(hadamard(l, r));
+}
+
+//===================================================
+// Matrix (templated 2D array)
+//===================================================
+template<typename T>
+class Matrix : public MatExpr<Matrix<T>> {
+public:
+    typedef T value_type;
+    static const bool IS_LEAF = true;
+
+    Matrix(std::size_t rows, std::size_t cols)
+    : m_(rows), n_(cols) {
+        data_ = new T[m_ * n_];
+        for (std::size_t i = 0; i < m_ * n_; i++) {
+            data_[i] = T();
+        }
+    }
+
+    Matrix(const Matrix &orig) : m_(orig.m_), n_(orig.n_) {
+        data_ = new T[m_ * n_];
+        for (std::size_t i = 0; i < m_ * n_; i++) {
+            data_[i] = orig.data_[i];
+        }
+    }
+
+    // Steals the buffer; 'orig' is left as an empty 0x0 matrix
+    Matrix(Matrix &&orig) noexcept : m_(orig.m_), n_(orig.n_), data_(orig.data_) {
+        orig.m_ = 0;
+        orig.n_ = 0;
+        orig.data_ = nullptr;
+    }
+
+    // Evaluates an element-wise expression straight into new storage
+    template<typename E>
+    Matrix(const MatExpr<E> &expr) : m_(expr.self().rows()), n_(expr.self().cols()) {
+        data_ = new T[m_ * n_];
+        const E& e = expr.self();
+        for (std::size_t i = 0; i < m_ * n_; i++) {
+            data_[i] = e.flat(i);
+        }
+    }
+
+    ~Matrix() {
+        delete[] data_;
+        data_ = nullptr;
+    }
+
+    Matrix &operator=(const Matrix &other) {
+        if (this != &other) {
+            Matrix tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    Matrix &operator=(Matrix &&other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    template<typename E>
+    Matrix &operator=(const MatExpr<E> &expr) {
+        const E& e = expr.self();
+        if (e.rows() != m_ || e.cols() != n_) {
+            // The expression may still read from this matrix, so build aside
+            Matrix tmp(e);
+            swap(tmp);
+            return *this;
+        }
+        for (std::size_t i = 0; i < m_ * n_; i++) {
+            data_[i] = e.flat(i);
+        }
+        return *this;
+    }
+
+    void swap(Matrix &other) noexcept {
+        std::swap(m_, other.m_);
+        std::swap(n_, other.n_);
+        std::swap(data_, other.data_);
+    }
+
+    T &operator()(std::size_t r, std::size_t c) {
+        if (r >= m_ || c >= n_) throw std::out_of_range("Matrix index out of range");
+        return data_[r * n_ + c];
+    }
+
+    const T &operator()(std::size_t r, std::size_t c) const {
+        if (r >= m_ || c >= n_) throw std::out_of_range("Matrix index out of range");
+        return data_[r * n_ + c];
+    }
+
+    std::size_t rows() const { return m_; }
+    std::size_t cols() const { return n_; }
+    T* data()             { return data_; }
+    const T* data() const { return data_; }
+    T flat(std::size_t i) const { return data_[i]; }
+
+    Matrix &operator*=(const T& scalar) {
+        for (std::size_t i = 0; i < m_ * n_; i++) {
+            data_[i] *= scalar;
+        }
+        return *this;
+    }
+
+    template<typename E>
+    Matrix &operator+=(const MatExpr<E>& expr) {
+        const E& e = expr.self();
+        if (m_ != e.rows() || n_ != e.cols()) throw std::invalid_argument("Matrix dimensions do not match");
+        for (std::size_t i = 0; i < m_ * n_; i++) {
+            data_[i] += e.flat(i);
+        }
+        return *this;
+    }
+
+    template<typename E>
+    Matrix &operator-=(const MatExpr<E>& expr) {
+        const E& e = expr.self();
+        if (m_ != e.rows() || n_ != e.cols()) throw std::invalid_argument("Matrix dimensions do not match");
+        for (std::size_t i = 0; i < m_ * n_; i++) {
+            data_[i] -= e.flat(i);
+        }
+        return *this;
+    }
+
+    // Blocked so that both the reads and the writes stay within a tile
+    Matrix transpose() const {
+        const std::size_t TILE = 32;
+        Matrix res(n_, m_);
+        for (std::size_t rb = 0; rb < m_; rb += TILE) {
+            for (std::size_t cb = 0; cb < n_; cb += TILE) {
+                std::size_t rEnd = (rb + TILE < m_) ? rb + TILE : m_;
+                std::size_t cEnd = (cb + TILE < n_) ? cb + TILE : n_;
+                for (std::size_t r = rb; r < rEnd; r++) {
+                    for (std::size_t c = cb; c < cEnd; c++) res.data_[c * m_ + r] = data_[r * n_ + c];
+                }
+            }
+        }
+        return res;
+    }
+
+    // Matrix product through the blocked Gemm kernels; Gemm decides how many
+    // of the threads the product is big enough to use
+    Matrix multiply(const Matrix& other, unsigned threads = hardwareThreads()) const {
+        if (n_ != other.m_) throw std::invalid_argument("Matrix dimensions do not match for multiply");
+        Matrix res(m_, other.n_);
+        Gemm<T>::multiply(m_, other.n_, n_, data_, n_, other.data_, other.n_, res.data_, other.n_, threads);
+        return res;
+    }
+
+    Matrix operator*(const Matrix& other) const {
+        return multiply(other);
+    }
+
+    void print() {
+        std::cout << "Matrix " << m_ << "x" << n_ << ":\n";
+        for (std::size_t r = 0; r < m_; r++) {
+            for (std::size_t c = 0; c < n_; c++) {
+                std::cout << data_[r * n_ + c] << " ";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+private:
+    std::size_t m_;
+    std::size_t n_;
+    T* data_;
+};
+
+//===================================================
+// SparseMatrix (CSR / CSC storage)
+//===================================================
+// Compressed storage: 'ptr' has one entry per row (CSR) or column (CSC),
+// plus one at the end. The non-zeros of line i sit in idx/vals at
+// [ptr[i], ptr[i+1]), sorted by their column (CSR) or row (CSC) index.
+// Building from COO triplets and switching between formats are counting
+// sorts, O(nnz + rows + cols). The multiply kernels split the work into
+// slices with equal non-zero counts rather than equal line counts, so
+// one dense row in a power-law matrix does not leave the other threads idle.
+enum class SparseFormat { CSR, CSC };
+
+template<typename T>
+struct SparseEntry {
+    std::size_t row;
+    std::size_t col;
+    T val;
+};
+
+template<typename T>
+class SparseMatrix {
+private:
+    std::size_t m_;
+    std::size_t n_;
+    SparseFormat format_;
+    std::vector<std::size_t> ptr;
+    std::vector<std::size_t> idx;
+    std::vector<T> vals;
+
+    std::size_t lines() const { return format_ == SparseFormat::CSR ? m_ : n_; }
+
+    // Cuts [0, lines) into 'parts' slices holding about nnz/parts entries each
+    std::vector<std::size_t> balancedSplit(unsigned parts) const {
+        std::vector<std::size_t> bounds(parts + 1, lines());
+        bounds[0] = 0;
+        for (unsigned p = 1; p < parts; p++) {
+            std::size_t target = nnz() * p / parts;
+            bounds[p] = std::upper_bound(ptr.begin(), ptr.end(), target) - ptr.begin() - 1;
+            if (bounds[p] < bounds[p - 1]) bounds[p] = bounds[p - 1];
+        }
+        return bounds;
+    }
+
+    template<typename Fn>
+    void parallelOverSlices(unsigned threads, Fn work) const {
+        if (threads < 2 || nnz() < (std::size_t(1) << 15)) {
+            work(0, 0, lines());
+            return;
+        }
+        std::vector<std::size_t> bounds = balancedSplit(threads);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&work, &bounds, t]() { work(t, bounds[t], bounds[t + 1]); });
+        }
+        for (std::thread& w : workers) w.join();
+    }
+
+    SparseMatrix(std::size_t rows, std::size_t cols, SparseFormat format)
+    : m_(rows), n_(cols), format_(format) {}
+
+public:
+    // O(nnz + rows + cols); entries at the same position are summed
+    SparseMatrix(std::size_t rows, std::size_t cols, const std::vector<SparseEntry<T>>& coo,
+                 SparseFormat format = SparseFormat::CSR)
+    : m_(rows), n_(cols), format_(format) {
+        bool csr = (format == SparseFormat::CSR);
+        std::size_t major = csr ? rows : cols;
+        std::size_t minor = csr ? cols : rows;
+        for (const SparseEntry<T>& e : coo) {
+            if (e.row >= rows || e.col >= cols) throw std::out_of_range("SparseMatrix entry out of range");
+        }
+        // Bucket by the minor index first, then stably by the major index,
+        // so each line comes out sorted
+        std::vector<std::size_t> minorPtr(minor + 1, 0);
+        for (const SparseEntry<T>& e : coo) minorPtr[(csr ? e.col : e.row) + 1]++;
+        for (std::size_t i = 0; i < minor; i++) minorPtr[i + 1] += minorPtr[i];
+        std::vector<std::size_t> byMinor(coo.size());
+        for (std::size_t k = 0; k < coo.size(); k++) byMinor[minorPtr[csr ? coo[k].col : coo[k].row]++] = k;
+
+        std::vector<std::size_t> majorPtr(major + 1, 0);
+        for (const SparseEntry<T>& e : coo) majorPtr[(csr ? e.row : e.col) + 1]++;
+        for (std::size_t i = 0; i < major; i++) majorPtr[i + 1] += majorPtr[i];
+        std::vector<std::size_t> order(coo.size());
+        std::vector<std::size_t> fill(majorPtr.begin(), majorPtr.end() - 1);
+        for (std::size_t k : byMinor) order[fill[csr ? coo[k].row : coo[k].col]++] = k;
+
+        ptr.assign(major + 1, 0);
+        idx.reserve(coo.size());
+        vals.reserve(coo.size());
+        for (std::size_t line = 0; line < major; line++) {
+            for (std::size_t p = majorPtr[line]; p < majorPtr[line + 1]; p++) {
+                const SparseEntry<T>& e = coo[order[p]];
+                std::size_t at = csr ? e.col : e.row;
+                if (idx.size() > ptr[line] && idx.back() == at) vals.back() += e.val;
+                else {
+                    idx.push_back(at);
+                    vals.push_back(e.val);
+                }
+            }
+            ptr[line + 1] = idx.size();
+        }
+    }
+
+    static SparseMatrix fromDense(const Matrix<T>& dense, SparseFormat format = SparseFormat::CSR) {
+        std::vector<SparseEntry<T>> coo;
+        for (std::size_t r = 0; r < dense.rows(); r++) {
+            for (std::size_t c = 0; c < dense.cols(); c++) {
+                if (dense(r, c) != T()) coo.push_back(SparseEntry<T>{r, c, dense(r, c)});
+            }
+        }
+        return SparseMatrix(dense.rows(), dense.cols(), coo, format);
+    }
+
+    Matrix<T> toDense() const {
+        Matrix<T> res(m_, n_);
+        for (std::size_t line = 0; line < lines(); line++) {
+            for (std::size_t p = ptr[line]; p < ptr[line + 1]; p++) {
+                if (format_ == SparseFormat::CSR) res(line, idx[p]) = vals[p];
+                else res(idx[p], line) = vals[p];
+            }
+        }
+        return res;
+    }
+
+    // Same matrix in the other storage order (a transpose of the arrays)
+    SparseMatrix convert(SparseFormat target) const {
+        if (target == format_) return *this;
+        SparseMatrix res(m_, n_, target);
+        std::size_t other = (target == SparseFormat::CSR) ? m_ : n_;
+        res.ptr.assign(other + 1, 0);
+        for (std::size_t k = 0; k < idx.size(); k++) res.ptr[idx[k] + 1]++;
+        for (std::size_t i = 0; i < other; i++) res.ptr[i + 1] += res.ptr[i];
+        res.idx.resize(idx.size());
+        res.vals.resize(vals.size());
+        std::vector<std::size_t> fill(res.ptr.begin(), res.ptr.end() - 1);
+        for (std::size_t line = 0; line < lines(); line++) {
+            for (std::size_t p = ptr[line]; p < ptr[line + 1]; p++) {
+                std::size_t dst = fill[idx[p]]++;
+                res.idx[dst] = line;
+                res.vals[dst] = vals[p];
+            }
+        }
+        return res;
+    }
+
+    std::size_t rows() const { return m_; }
+    std::size_t cols() const { return n_; }
+    std::size_t nnz() const { return vals.size(); }
+    SparseFormat format() const { return format_; }
+
+    // y = A * x, with x of length cols() and y of length rows()
+    void multiply(const T* x, T* y, unsigned threads = hardwareThreads()) const {
+        if (format_ == SparseFormat::CSR) {
+            parallelOverSlices(threads, [&](unsigned, std::size_t begin, std::size_t end) {
+                for (std::size_t r = begin; r < end; r++) {
+                    T acc = T();
+                    for (std::size_t p = ptr[r]; p < ptr[r + 1]; p++) acc += vals[p] * x[idx[p]];
+                    y[r] = acc;
+                }
+            });
+            return;
+        }
+        // CSC scatters into y, so each thread accumulates privately first
+        unsigned parts = (threads < 2 || nnz() < (std::size_t(1) << 15)) ? 1 : threads;
+        std::vector<std::vector<T>> partial(parts, std::vector<T>(m_, T()));
+        parallelOverSlices(parts, [&](unsigned t, std::size_t begin, std::size_t end) {
+            std::vector<T>& out = partial[t];
+            for (std::size_t c = begin; c < end; c++) {
+                for (std::size_t p = ptr[c]; p < ptr[c + 1]; p++) out[idx[p]] += vals[p] * x[c];
+            }
+        });
+        for (std::size_t r = 0; r < m_; r++) {
+            T acc = T();
+            for (unsigned t = 0; t < parts; t++) acc += partial[t][r];
+            y[r] = acc;
+        }
+    }
+
+    std::vector<T> multiply(const std::vector<T>& x, unsigned threads = hardwareThreads()) const {
+        if (x.size() != n_) throw std::invalid_argument("SparseMatrix vector length does not match");
+        std::vector<T> y(m_);
+        multiply(x.data(), y.data(), threads);
+        return y;
+    }
+
+    // C = A * B for a dense B; row i of C is a weighted sum of rows of B
+    Matrix<T> multiply(const Matrix<T>& B, unsigned threads = hardwareThreads()) const {
+        if (B.rows() != n_) throw std::invalid_argument("Matrix dimensions do not match for multiply");
+        if (format_ == SparseFormat::CSC) return convert(SparseFormat::CSR).multiply(B, threads);
+        Matrix<T> C(m_, B.cols());
+        std::size_t w = B.cols();
+        const T* b = B.data();
+        T* c = C.data();
+        parallelOverSlices(threads, [&](unsigned, std::size_t begin, std::size_t end) {
+            for (std::size_t r = begin; r < end; r++) {
+                T* crow = c + r * w;
+                for (std::size_t p = ptr[r]; p < ptr[r + 1]; p++) {
+                    const T* brow = b + idx[p] * w;
+                    T v = vals[p];
+                    for (std::size_t j = 0; j < w; j++) crow[j] += v * brow[j];
+                }
+            }
+        });
+        return C;
+    }
+
+    void print() {
+        std::cout << "SparseMatrix " << m_ << "x" << n_ << " ("
+                  << (format_ == SparseFormat::CSR ? "CSR" : "CSC") << ", nnz " << nnz() << "): ";
+        for (std::size_t line = 0; line < lines(); line++) {
+            for (std::size_t p = ptr[line]; p < ptr[line + 1]; p++) {
+                std::size_t r = (format_ == SparseFormat::CSR) ? line : idx[p];
+                std::size_t c = (format_ == SparseFormat::CSR) ? idx[p] : line;
+                std::cout << "(" << r << "," << c << ")=" << vals[p];
+                if (p + 1 < nnz()) std::cout << " ";
+            }
+        }
+        std::cout << std::endl;
+    }
+};
+
+//===================================================
+// Resampling (polyphase FIR, rational factors)
+//===================================================
+// Resampling by up/down puts output j at input position j * down / up =
+// base + phase / up. The kernel's weights depend only on the phase, so
+// each of the 'up' phases gets one precomputed row of taps. Output j is
+// then a dot product of that row with in[base - left, base - left + taps).
+// Reads before the first sample or past the last one repeat the edge sample.
+//  - Hold:   the sample at or before the position (zero-order hold)
+//  - Linear: two taps
+//  - Cubic:  four taps, Catmull-Rom (Keys, a = -0.5)
+//  - Sinc:   Blackman-windowed sinc with 'sincZeros' zero crossings per
+//            side, low-passed at min(up, down) / down, so downsampling
+//            does not alias; Linear and Cubic do not band-limit
+// Every row is normalized to sum to 1, so a constant signal passes unchanged.
+enum class ResampleKernel { Hold, Linear, Cubic, Sinc };
+
+template<typename C>
+struct ResamplePlan {
+    std::size_t up, down;         // reduced ratio
+    std::size_t stepInt, stepFrac;   // down / up, down % up
+    std::size_t taps;             // weights per phase
+    std::size_t left;             // taps before the output position
+    std::size_t stride;           // row length: taps, zero-padded for SIMD
+    std::vector<C> coef;          // 'up' rows of 'stride' weights
+
+    void advance(std::size_t& base, std::size_t& phase) const {
+        base += stepInt;
+        phase += stepFrac;
+        if (phase >= up) {
+            phase -= up;
+            base++;
+        }
+    }
+
+    // Outputs from (base, phase) on whose position is at most 'last'
+    std::size_t countUpTo(std::size_t base, std::size_t phase, std::size_t last) const {
+        if (last < base) return 0;
+        unsigned long long span = (static_cast<unsigned long long>(last - base) + 1) * up - phase;
+        return static_cast<std::size_t>((span + down - 1) / down);
+    }
+};
+
+// Sample arithmetic. Integer samples are computed in double, then
+// rounded and clamped. Non-arithmetic samples only support Hold, which
+// copies values.
+template<typename T, bool ARITHMETIC = std::is_arithmetic<T>::value>
+struct ResampleMath {
+    typedef typename std::conditional<std::is_floating_point<T>::value, T, double>::type Coef;
+
+    static T toSample(Coef v, std::true_type) { return static_cast<T>(v); }
+    static T toSample(Coef v, std::false_type) {
+        v = (v < 0) ? v - 0.5 : v + 0.5;
+        if (v <= static_cast<Coef>(std::numeric_limits<T>::lowest())) return std::numeric_limits<T>::lowest();
+        if (v >= static_cast<Coef>(std::numeric_limits<T>::max())) return std::numeric_limits<T>::max();
+        return static_cast<T>(v);
+    }
+
+    static T dot(const T* p, const Coef* c, std::size_t taps) {
+        if (taps == 1) return p[0];
+        Coef acc = 0;
+        for (std::size_t k = 0; k < taps; k++) acc += c[k] * p[k];
+        return toSample(acc, std::is_floating_point<T>());
+    }
+
+    // Same as dot, with sample 'first + k' clamped into [0, n)
+    static T dotClamped(const T* src, std::size_t n, long long first, const Coef* c, std::size_t taps) {
+        Coef acc = 0;
+        for (std::size_t k = 0; k < taps; k++) {
+            long long i = first + static_cast<long long>(k);
+            i = (i < 0) ? 0 : (i >= static_cast<long long>(n) ? static_cast<long long>(n) - 1 : i);
+            if (taps == 1) return src[i];
+            acc += c[k] * src[i];
+        }
+        return toSample(acc, std::is_floating_point<T>());
+    }
+};
+
+template<typename T>
+struct ResampleMath<T, false> {
+    typedef double Coef;
+
+    static T dot(const T* p, const Coef*, std::size_t) { return p[0]; }
+    static T dotClamped(const T* src, std::size_t n, long long first, const Coef*, std::size_t) {
+        return src[(first < 0) ? 0 : (first >= static_cast<long long>(n) ? n - 1 : first)];
+    }
+};
+
+// Vectorized dot products. LANES = 1 means there is no kernel and run() leaves all the work to the scalar loop.
+template<typename T>
+struct ResampleSimd {
+    static const std::size_t LANES = 1;
+    template<typename C>
+    static std::size_t run(const ResamplePlan<C>&, const T*, std::size_t&, std::size_t&, T*, std::size_t) { return 0; }
+};
+
+#if defined(__AVX2__) && defined(__FMA__)
+// Kernels at least LANES taps long use one output per vector, with
+// the taps loaded contiguously and then summed across lanes. Shorter kernels
+// put one output in each lane and gather the samples and weights. Both
+// leave 'base' and 'phase' after the outputs they computed.
+template<>
+struct ResampleSimd<float> {
+    static const std::size_t LANES = 8;
+
+    static float hsum(__m256 v) {
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        return _mm_cvtss_f32(s);
+    }
+
+    static std::size_t run(const ResamplePlan<float>& pl, const float* src, std::size_t& base, std::size_t& phase,
+                           float* out, std::size_t count) {
+        const float* coef = pl.coef.data();
+        if (pl.taps >= LANES) {
+            for (std::size_t i = 0; i < count; i++) {
+                const float* p = src + base - pl.left;
+                const float* c = coef + phase * pl.stride;
+                __m256 acc = _mm256_setzero_ps();
+                for (std::size_t k = 0; k < pl.stride; k += LANES) {
+                    acc = _mm256_fmadd_ps(_mm256_loadu_ps(p + k), _mm256_loadu_ps(c + k), acc);
+                }
+                out[i] = hsum(acc);
+                pl.advance(base, phase);
+            }
+            return count;
+        }
+        // Gather indices are 32-bit
+        if (base + count * (pl.stepInt + 1) > 0x7FFFFFFF || pl.up * pl.stride > 0x7FFFFFFF) return 0;
+        alignas(32) int idx[LANES];
+        alignas(32) int cidx[LANES];
+        std::size_t done = 0;
+        for (; done + LANES <= count; done += LANES) {
+            for (std::size_t l = 0; l < LANES; l++) {
+                idx[l] = static_cast<int>(base - pl.left);
+                cidx[l] = static_cast<int>(phase * pl.stride);
+                pl.advance(base, phase);
+            }
+            __m256i vi = _mm256_load_si256(reinterpret_cast<const __m256i*>(idx));
+            __m256i vc = _mm256_load_si256(reinterpret_cast<const __m256i*>(cidx));
+            __m256 acc = _mm256_setzero_ps();
+            for (std::size_t k = 0; k < pl.taps; k++) {
+                acc = _mm256_fmadd_ps(_mm256_i32gather_ps(src + k, vi, 4), _mm256_i32gather_ps(coef + k, vc, 4), acc);
+            }
+            _mm256_storeu_ps(out + done, acc);
+        }
+        return done;
+    }
+};
+
+template<>
+struct ResampleSimd<double> {
+    static const std::size_t LANES = 4;
+
+    static double hsum(__m256d v) {
+        __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+    }
+
+    static std::size_t run(const ResamplePlan<double>& pl, const double* src, std::size_t& base, std::size_t& phase,
+                           double* out, std::size_t count) {
+        const double* coef = pl.coef.data();
+        if (pl.taps >= LANES) {
+            for (std::size_t i = 0; i < count; i++) {
+                const double* p = src + base - pl.left;
+                const double* c = coef + phase * pl.stride;
+                __m256d acc = _mm256_setzero_pd();
+                for (std::size_t k = 0; k < pl.stride; k += LANES) {
+                    acc = _mm256_fmadd_pd(_mm256_loadu_pd(p + k), _mm256_loadu_pd(c + k), acc);
+                }
+                out[i] = hsum(acc);
+                pl.advance(base, phase);
+            }
+            return count;
+        }
+        if (base + count * (pl.stepInt + 1) > 0x7FFFFFFF || pl.up * pl.stride > 0x7FFFFFFF) return 0;
+        alignas(16) int idx[LANES];
+        alignas(16) int cidx[LANES];
+        std::size_t done = 0;
+        for (; done + LANES <= count; done += LANES) {
+            for (std::size_t l = 0; l < LANES; l++) {
+                idx[l] = static_cast<int>(base - pl.left);
+                cidx[l] = static_cast<int>(phase * pl.stride);
+                pl.advance(base, phase);
+            }
+            __m128i vi = _mm_load_si128(reinterpret_cast<const __m128i*>(idx));
+            __m128i vc = _mm_load_si128(reinterpret_cast<const __m128i*>(cidx));
+            // The masked form, with every lane enabled, avoids GCC's
+            // maybe-uninitialized warning on the plain double gather
+            const __m256d zero = _mm256_setzero_pd();
+            const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+            __m256d acc = zero;
+            for (std::size_t k = 0; k < pl.taps; k++) {
+                __m256d x = _mm256_mask_i32gather_pd(zero, src + k, vi, all, 8);
+                __m256d c = _mm256_mask_i32gather_pd(zero, coef + k, vc, all, 8);
+                acc = _mm256_fmadd_pd(x, c, acc);
+            }
+            _mm256_storeu_pd(out + done, acc);
+        }
+        return done;
+    }
+};
+#endif
+
+//---------------------------------------------------
+// Resampler<T> - reusable up/down resampler with streaming state
+// resample() converts a whole buffer. It is const, so one Resampler can
+// serve many buffers and threads. push() and flush() process a stream in
+// blocks of any size. The output matches one resample() call over the
+// concatenated input, up to floating-point rounding. Each block's outputs
+// appear once the kernel's right-hand taps have arrived. The unconsumed
+// tail, at most a few rows of input, is carried to the next call.
+template<typename T>
+class Resampler {
+public:
+    typedef typename ResampleMath<T>::Coef Coef;
+
+private:
+    typedef ResampleMath<T> Math;
+
+    ResamplePlan<Coef> plan;
+    std::vector<T> pending;   // buffered input; pending[0] is input index 'origin'
+    long long origin;         // negative while the left edge padding is buffered
+    unsigned long long seen;  // samples pushed since the last reset
+    std::size_t pos;          // next output's base, as an index into pending
+    std::size_t phase;
+
+    static double keysCubic(double x) {
+        const double a = -0.5;
+        x = (x < 0) ? -x : x;
+        if (x <= 1) return ((a + 2) * x - (a + 3)) * x * x + 1;
+        if (x < 2) return ((a * x - 5 * a) * x + 8 * a) * x - 4 * a;
+        return 0;
+    }
+
+    void buildPlan(ResampleKernel kernel, std::size_t sincZeros) {
+        const double PI = 3.14159265358979323846;
+        double cutoff = (plan.up >= plan.down) ? 1.0 : static_cast<double>(plan.up) / plan.down;
+        std::size_t half = 0;
+        switch (kernel) {
+            case ResampleKernel::Hold:   plan.taps = 1; plan.left = 0; break;
+            case ResampleKernel::Linear: plan.taps = 2; plan.left = 0; break;
+            case ResampleKernel::Cubic:  plan.taps = 4; plan.left = 1; break;
+            case ResampleKernel::Sinc:
+                half = static_cast<std::size_t>(std::ceil(sincZeros / cutoff));
+                plan.taps = 2 * half;
+                plan.left = half - 1;
+                break;
+        }
+        const std::size_t lanes = ResampleSimd<T>::LANES;
+        plan.stride = (lanes > 1 && plan.taps >= lanes) ? (plan.taps + lanes - 1) / lanes * lanes : plan.taps;
+        plan.coef.assign(plan.up * plan.stride, Coef(0));
+        std::vector<double> w(plan.taps);
+        for (std::size_t p = 0; p < plan.up; p++) {
+            double frac = static_cast<double>(p) / plan.up;
+            double sum = 0;
+            for (std::size_t k = 0; k < plan.taps; k++) {
+                // Distance from the output position to tap k's sample
+                double d = static_cast<double>(k) - static_cast<double>(plan.left) - frac;
+                switch (kernel) {
+                    case ResampleKernel::Hold:   w[k] = 1; break;
+                    case ResampleKernel::Linear: w[k] = 1 - (d < 0 ? -d : d); break;
+                    case ResampleKernel::Cubic:  w[k] = keysCubic(d); break;
+                    case ResampleKernel::Sinc: {
+                        double u = d / half;
+                        double window = 0.42 + 0.5 * std::cos(PI * u) + 0.08 * std::cos(2 * PI * u);
+                        double x = PI * cutoff * d;
+                        w[k] = cutoff * (d == 0 ? 1.0 : std::sin(x) / x) * window;
+                        break;
+                    }
+                }
+                sum += w[k];
+            }
+            for (std::size_t k = 0; k < plan.taps; k++) plan.coef[p * plan.stride + k] = static_cast<Coef>(w[k] / sum);
+        }
+    }
+
+    // Writes 'count' outputs from (base, phase); every tap must be in src
+    void emit(const T* src, std::size_t& base, std::size_t& ph, T* out, std::size_t count) const {
+        std::size_t done = ResampleSimd<T>::run(plan, src, base, ph, out, count);
+        for (; done < count; done++) {
+            out[done] = Math::dot(src + base - plan.left, plan.coef.data() + ph * plan.stride, plan.taps);
+            plan.advance(base, ph);
+        }
+    }
+
+    // Outputs computable from pending, given 'avail' buffered samples
+    std::size_t ready(std::size_t avail) const {
+        if (avail + plan.left < plan.stride) return 0;
+        return plan.countUpTo(pos, phase, avail + plan.left - plan.stride);
+    }
+
+public:
+    Resampler(std::size_t up, std::size_t down, ResampleKernel kernel = ResampleKernel::Linear,
+              std::size_t sincZeros = 8) {
+        if (up == 0 || down == 0) throw std::invalid_argument("Resampler factors must be positive");
+        if (kernel == ResampleKernel::Sinc && sincZeros == 0) throw std::invalid_argument("Resampler needs sincZeros >= 1");
+        if (!std::is_arithmetic<T>::value && kernel != ResampleKernel::Hold) {
+            throw std::invalid_argument("Resampler: only Hold works on non-arithmetic samples");
+        }
+        std::size_t a = up, b = down;
+        while (b) {
+            std::size_t t = a % b;
+            a = b;
+            b = t;
+        }
+        plan.up = up / a;
+        plan.down = down / a;
+        plan.stepInt = plan.down / plan.up;
+        plan.stepFrac = plan.down % plan.up;
+        buildPlan(kernel, sincZeros);
+        reset();
+    }
+
+    std::size_t up() const { return plan.up; }
+    std::size_t down() const { return plan.down; }
+    std::size_t taps() const { return plan.taps; }
+
+    // Output length for n input samples: ceil(n * up / down)
+    std::size_t outputLength(std::size_t n) const {
+        return static_cast<std::size_t>((static_cast<unsigned long long>(n) * plan.up + plan.down - 1) / plan.down);
+    }
+
+    // Resamples in[0, n) into out[0, outputLength(n)), edges clamped
+    std::size_t resample(const T* in, std::size_t n, T* out) const {
+        std::size_t m = outputLength(n);
+        std::size_t j = 0, base = 0, ph = 0;
+        const Coef* coef = plan.coef.data();
+        for (; j < m && base < plan.left; j++) {
+            out[j] = Math::dotClamped(in, n, static_cast<long long>(base) - static_cast<long long>(plan.left),
+                                      coef + ph * plan.stride, plan.taps);
+            plan.advance(base, ph);
+        }
+        if (j < m && n + plan.left >= plan.stride) {
+            std::size_t k = plan.countUpTo(base, ph, n + plan.left - plan.stride);
+            if (k > m - j) k = m - j;
+            emit(in, base, ph, out + j, k);
+            j += k;
+        }
+        for (; j < m; j++) {
+            out[j] = Math::dotClamped(in, n, static_cast<long long>(base) - static_cast<long long>(plan.left),
+                                      coef + ph * plan.stride, plan.taps);
+            plan.advance(base, ph);
+        }
+        return m;
+    }
+
+    // Largest number of outputs one push of n samples can produce
+    std::size_t maxOutput(std::size_t n) const {
+        return static_cast<std::size_t>(static_cast<unsigned long long>(n) * plan.up / plan.down) + 2;
+    }
+    // Largest number of outputs flush() can produce
+    std::size_t maxFlush() const { return maxOutput(plan.stride + 1); }
+
+    // Feeds n more samples; writes every output whose taps are now all
+    // available and returns how many. Throws before consuming anything if
+    // they would not fit in outCap.
+    std::size_t push(const T* in, std::size_t n, T* out, std::size_t outCap) {
+        if (n == 0) return 0;
+        std::size_t pad = (seen == 0) ? plan.left : 0;   // left edge: repeat the first sample
+        std::size_t count = ready(pending.size() + pad + n);
+        if (count > outCap) throw std::invalid_argument("Resampler push: output buffer too small");
+        if (pad) {
+            pending.assign(pad, in[0]);
+            origin = -static_cast<long long>(pad);
+        }
+        pending.insert(pending.end(), in, in + n);
+        seen += n;
+        emit(pending.data(), pos, phase, out, count);
+        // Drop the samples no later output will read. When downsampling,
+        // the next output can lie beyond everything buffered so far.
+        std::size_t drop = (pos > plan.left) ? pos - plan.left : 0;
+        if (drop > pending.size()) drop = pending.size();
+        pending.erase(pending.begin(), pending.begin() + drop);
+        origin += static_cast<long long>(drop);
+        pos -= drop;
+        return count;
+    }
+
+    // Ends the stream: writes the remaining outputs, reading past the
+    // last sample as repeats of it, and resets for a new stream
+    std::size_t flush(T* out, std::size_t outCap) {
+        if (seen == 0) return 0;
+        long long end = static_cast<long long>(seen) - origin;   // one past the last sample in pending
+        std::size_t count = (static_cast<long long>(pos) < end) ? plan.countUpTo(pos, phase, static_cast<std::size_t>(end - 1)) : 0;
+        if (count > outCap) throw std::invalid_argument("Resampler flush: output buffer too small");
+        if (count) {
+            pending.insert(pending.end(), plan.stride, pending.back());
+            emit(pending.data(), pos, phase, out, count);
+        }
+        reset();
+        return count;
+    }
+
+    void reset() {
+        pending.clear();
+        origin = 0;
+        seen = 0;
+        pos = plan.left;
+        phase = 0;
+    }
+};
+
+//===================================================
+// Templated Dynamic Array
+//===================================================
+template<typename T>
+class Array {
+public:
+    Array(std::size_t cap)
+    : cap_(cap) {
+        arr_ = new T[cap_];
+        for (std::size_t i = 0; i < cap_; i++) {
+            arr_[i] = T();
+        }
+    }
+
+    Array(const Array &orig) : cap_(orig.cap_) {
+        arr_ = new T[cap_];
+        for (std::size_t i = 0; i < cap_; i++) {
+            arr_[i] = orig.arr_[i];
+        }
+    }
+
+    ~Array() {
+        delete[] arr_;
+        arr_ = nullptr;
+    }
+
+    // Doubles the length, repeating each sample (a 2/1 Hold resample)
+    void interpolate() {
+        T *newArr = new T[cap_ * 2];
+        Resampler<T>(2, 1, ResampleKernel::Hold).resample(arr_, cap_, newArr);
+        delete[] arr_;
+        arr_ = newArr;
+        cap_ *= 2;
+    }
+
+    // Length after resampling by up/down
+    std::size_t resampledLength(std::size_t up, std::size_t down) const {
+        return Resampler<T>(up, down, ResampleKernel::Hold).outputLength(cap_);
+    }
+
+    // Resamples into caller-provided storage of at least outCap elements;
+    // returns the number written. Reuse one Resampler to skip rebuilding
+    // its tables.
+    std::size_t resample(const Resampler<T>& r, T* out, std::size_t outCap) const {
+        if (outCap < r.outputLength(cap_)) throw std::invalid_argument("Array resample: output buffer too small");
+        return r.resample(arr_, cap_, out);
+    }
+
+    std::size_t resample(std::size_t up, std::size_t down, ResampleKernel kernel, T* out, std::size_t outCap) const {
+        return resample(Resampler<T>(up, down, kernel), out, outCap);
+    }
+
+    // Resamples in place for up <= down, streaming through the buffer so
+    // nothing is reallocated. capacity() becomes the new length.
+    std::size_t resampleInPlace(std::size_t up, std::size_t down, ResampleKernel kernel = ResampleKernel::Linear) {
+        Resampler<T> r(up, down, kernel);
+        return resampleInPlace(r);
+    }
+
+    // Same, reusing r's tables; any stream r was in the middle of is dropped
+    std::size_t resampleInPlace(Resampler<T>& r) {
+        if (r.up() > r.down()) throw std::invalid_argument("Array resampleInPlace: needs up <= down");
+        r.reset();
+        const std::size_t BLOCK = 4096;
+        std::size_t written = 0;
+        for (std::size_t i = 0; i < cap_; i += BLOCK) {
+            std::size_t n = (cap_ - i < BLOCK) ? cap_ - i : BLOCK;
+            // Outputs never outrun the input consumed so far
+            written += r.push(arr_ + i, n, arr_ + written, i + n - written);
+        }
+        written += r.flush(arr_ + written, cap_ - written);
+        cap_ = written;
+        return written;
+    }
+
+    T& operator[](std::size_t idx) {
+        if (idx >= cap_) throw std::out_of_range("Array index out of range");
+        return arr_[idx];
+    }
+    const T& operator[](std::size_t idx) const {
+        if (idx >= cap_) throw std::out_of_range("Array index out of range");
+        return arr_[idx];
+    }
+    T* data() { return arr_; }
+    const T* data() const { return arr_; }
+
+    std::size_t capacity() const { return cap_; }
+
+    void print() {
+        std::cout << "Array: ";
+        for (std::size_t i = 0; i < cap_; i++) {
+            std::cout << arr_[i];
+            if (i < cap_ - 1) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+
+private:
+    std::size_t cap_;
+    T* arr_;
+};
+
+//===================================================
+// Additional Minimal "Standard-Like" Containers
+//===================================================
+
+//---------------------------------------------------
+// BitWords - word-array kernels shared by Bitset and DynamicBitset
+// Arrays are 64-byte aligned and a whole number of 64-byte lines long,
+// and every bit past the logical size is kept zero. So the bulk loops
+// have no scalar tail, and count/find never see stray bits.
+struct BitWords {
+    static const std::size_t WORD_BITS = 64;
+    static const std::size_t LINE_WORDS = 8;   // one cache line of words
+    static const std::size_t npos = std::size_t(-1);
+
+    // Words for 'bits' bits, rounded up to whole cache lines
+    static constexpr std::size_t wordsFor(std::size_t bits) {
+        std::size_t lines = (bits + LINE_WORDS * WORD_BITS - 1) / (LINE_WORDS * WORD_BITS);
+        return (lines ? lines : 1) * LINE_WORDS;
+    }
+
+    static unsigned long long* allocate(std::size_t nWords) {
+        void* p = ::operator new(nWords * sizeof(unsigned long long), std::align_val_t(64));
+        std::memset(p, 0, nWords * sizeof(unsigned long long));
+        return static_cast<unsigned long long*>(p);
+    }
+    static void deallocate(unsigned long long* p) {
+        if (p) ::operator delete(p, std::align_val_t(64));
+    }
+
+    struct And {
+        static unsigned long long word(unsigned long long a, unsigned long long b) { return a & b; }
+#if defined(__AVX2__)
+        static __m256i vec(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+#elif defined(__SSE2__)
+        static __m128i vec(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+#endif
+    };
+    struct Or {
+        static unsigned long long word(unsigned long long a, unsigned long long b) { return a | b; }
+#if defined(__AVX2__)
+        static __m256i vec(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+#elif defined(__SSE2__)
+        static __m128i vec(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+#endif
+    };
+    struct Xor {
+        static unsigned long long word(unsigned long long a, unsigned long long b) { return a ^ b; }
+#if defined(__AVX2__)
+        static __m256i vec(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+#elif defined(__SSE2__)
+        static __m128i vec(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+#endif
+    };
+    struct AndNot {
+        static unsigned long long word(unsigned long long a, unsigned long long b) { return a & ~b; }
+#if defined(__AVX2__)
+        static __m256i vec(__m256i a, __m256i b) { return _mm256_andnot_si256(b, a); }
+#elif defined(__SSE2__)
+        static __m128i vec(__m128i a, __m128i b) { return _mm_andnot_si128(b, a); }
+#endif
+    };
+
+    // dst[i] = Op(dst[i], src[i]) over nWords (a multiple of LINE_WORDS)
+    template<typename Op>
+    static void combine(unsigned long long* dst, const unsigned long long* src, std::size_t nWords) {
+#if defined(__AVX2__)
+        for (std::size_t i = 0; i < nWords; i += 4) {
+            __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(dst + i));
+            __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(src + i));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(dst + i), Op::vec(a, b));
+        }
+#elif defined(__SSE2__)
+        for (std::size_t i = 0; i < nWords; i += 2) {
+            __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(dst + i));
+            __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst + i), Op::vec(a, b));
+        }
+#else
+        for (std::size_t i = 0; i < nWords; i++) dst[i] = Op::word(dst[i], src[i]);
+#endif
+    }
+
+    // Complements the first 'bits' bits and leaves the rest zero
+    static void flipAll(unsigned long long* w, std::size_t nWords, std::size_t bits) {
+        std::size_t full = bits / WORD_BITS;
+        for (std::size_t i = 0; i < full; i++) w[i] = ~w[i];
+        if (bits % WORD_BITS) {
+            w[full] = ~w[full] & ((1ULL << (bits % WORD_BITS)) - 1);
+            full++;
+        }
+        for (std::size_t i = full; i < nWords; i++) w[i] = 0;
+    }
+
+    static std::size_t count(const unsigned long long* w, std::size_t nWords) {
+        std::size_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;   // independent chains keep popcnt busy
+        for (std::size_t i = 0; i < nWords; i += 4) {
+            c0 += popCount(w[i]);
+            c1 += popCount(w[i + 1]);
+            c2 += popCount(w[i + 2]);
+            c3 += popCount(w[i + 3]);
+        }
+        return c0 + c1 + c2 + c3;
+    }
+
+    static bool equal(const unsigned long long* a, const unsigned long long* b, std::size_t nWords) {
+        return !nWords || std::memcmp(a, b, nWords * sizeof(unsigned long long)) == 0;
+    }
+
+    // First set bit at index >= from, or npos
+    static std::size_t findFrom(const unsigned long long* w, std::size_t nWords, std::size_t from) {
+        std::size_t i = from / WORD_BITS;
+        if (i >= nWords) return npos;
+        unsigned long long cur = w[i] & (~0ULL << (from % WORD_BITS));
+        while (!cur) {
+            if (++i == nWords) return npos;
+            cur = w[i];
+        }
+        return i * WORD_BITS + countTrailingZeros(cur);
+    }
+
+    // Sets (value = true) or clears bits [first, last)
+    static void fill(unsigned long long* w, std::size_t first, std::size_t last, bool value) {
+        if (first >= last) return;
+        std::size_t lo = first / WORD_BITS, hi = (last - 1) / WORD_BITS;
+        unsigned long long loMask = ~0ULL << (first % WORD_BITS);
+        unsigned long long hiMask = ~0ULL >> (WORD_BITS - 1 - (last - 1) % WORD_BITS);
+        if (lo == hi) loMask &= hiMask;
+        if (value) w[lo] |= loMask;
+        else w[lo] &= ~loMask;
+        if (lo == hi) return;
+        for (std::size_t i = lo + 1; i < hi; i++) w[i] = value ? ~0ULL : 0ULL;
+        if (value) w[hi] |= hiMask;
+        else w[hi] &= ~hiMask;
+    }
+};
+
+//---------------------------------------------------
+// Bitset<N>
+// Any N. The words live inline in a 64-byte-aligned array. set/reset/test
+// check the index; the *_unchecked forms skip that for hot loops.
+template<std::size_t N>
+class Bitset {
+private:
+    static const std::size_t WORDS = BitWords::wordsFor(N);
+    alignas(64) unsigned long long words[WORDS];
+
+public:
+    static const std::size_t npos = BitWords::npos;
+
+    Bitset() {
+        for (std::size_t i = 0; i < WORDS; i++) words[i] = 0ULL;
+    }
+    void set(std::size_t pos) {
+        if (pos >= N) throw std::out_of_range("Bitset index out of range");
+        set_unchecked(pos);
+    }
+    void reset(std::size_t pos) {
+        if (pos >= N) throw std::out_of_range("Bitset index out of range");
+        reset_unchecked(pos);
+    }
+    bool test(std::size_t pos) const {
+        if (pos >= N) throw std::out_of_range("Bitset index out of range");
+        return test_unchecked(pos);
+    }
+    void set_unchecked(std::size_t pos) { words[pos / 64] |= (1ULL << (pos % 64)); }
+    void reset_unchecked(std::size_t pos) { words[pos / 64] &= ~(1ULL << (pos % 64)); }
+    bool test_unchecked(std::size_t pos) const { return (words[pos / 64] >> (pos % 64)) & 1ULL; }
+
+    // Half-open range [first, last)
+    void set(std::size_t first, std::size_t last) {
+        if (first > last || last > N) throw std::out_of_range("Bitset range out of range");
+        BitWords::fill(words, first, last, true);
+    }
+    void reset(std::size_t first, std::size_t last) {
+        if (first > last || last > N) throw std::out_of_range("Bitset range out of range");
+        BitWords::fill(words, first, last, false);
+    }
+
+    std::size_t size() const { return N; }
+    std::size_t count() const { return BitWords::count(words, WORDS); }
+    bool any() const { return find_first() != npos; }
+    bool none() const { return !any(); }
+
+    std::size_t find_first() const { return BitWords::findFrom(words, WORDS, 0); }
+    // First set bit after pos, or npos
+    std::size_t find_next(std::size_t pos) const {
+        return pos + 1 >= N ? npos : BitWords::findFrom(words, WORDS, pos + 1);
+    }
+
+    Bitset& operator&=(const Bitset& o) { BitWords::combine<BitWords::And>(words, o.words, WORDS); return *this; }
+    Bitset& operator|=(const Bitset& o) { BitWords::combine<BitWords::Or>(words, o.words, WORDS); return *this; }
+    Bitset& operator^=(const Bitset& o) { BitWords::combine<BitWords::Xor>(words, o.words, WORDS); return *this; }
+    // Clears every bit that is set in o
+    Bitset& andNot(const Bitset& o) { BitWords::combine<BitWords::AndNot>(words, o.words, WORDS); return *this; }
+    Bitset operator&(const Bitset& o) const { Bitset r(*this); return r &= o; }
+    Bitset operator|(const Bitset& o) const { Bitset r(*this); return r |= o; }
+    Bitset operator^(const Bitset& o) const { Bitset r(*this); return r ^= o; }
+    Bitset operator~() const {
+        Bitset r(*this);
+        BitWords::flipAll(r.words, WORDS, N);
+        return r;
+    }
+    bool operator==(const Bitset& o) const { return BitWords::equal(words, o.words, WORDS); }
+    bool operator!=(const Bitset& o) const { return !(*this == o); }
+
+    void print() {
+        std::cout << "Bitset<" << N << ">: ";
+        for (std::size_t i = 0; i < N; i++) {
+            std::cout << (test_unchecked(i) ? 1 : 0);
+        }
+        std::cout << std::endl;
+    }
+};
+
+//---------------------------------------------------
+// DynamicBitset - Bitset whose size is chosen at runtime
+// Same kernels and layout as Bitset<N>, with the words on the heap.
+// Binary operators require both sides to have the same size.
+class DynamicBitset {
+private:
+    std::size_t nBits;
+    std::size_t nWords;
+    unsigned long long* words;
+
+    void checkSameSize(const DynamicBitset& o) const {
+        if (o.nBits != nBits) throw std::invalid_argument("DynamicBitset sizes do not match");
+    }
+
+public:
+    static const std::size_t npos = BitWords::npos;
+
+    // An empty bitset owns no words
+    explicit DynamicBitset(std::size_t bits = 0)
+    : nBits(bits), nWords(bits ? BitWords::wordsFor(bits) : 0),
+      words(nWords ? BitWords::allocate(nWords) : nullptr) {}
+
+    DynamicBitset(const DynamicBitset& orig)
+    : nBits(orig.nBits), nWords(orig.nWords), words(nWords ? BitWords::allocate(nWords) : nullptr) {
+        if (nWords) std::memcpy(words, orig.words, nWords * sizeof(unsigned long long));
+    }
+
+    DynamicBitset(DynamicBitset&& orig) noexcept
+    : nBits(orig.nBits), nWords(orig.nWords), words(orig.words) {
+        orig.nBits = 0;
+        orig.nWords = 0;
+        orig.words = nullptr;
+    }
+
+    DynamicBitset& operator=(DynamicBitset orig) {
+        std::swap(nBits, orig.nBits);
+        std::swap(nWords, orig.nWords);
+        std::swap(words, orig.words);
+        return *this;
+    }
+
+    ~DynamicBitset() { BitWords::deallocate(words); }
+
+    // Keeps the first min(size, bits) bits; new bits are zero
+    void resize(std::size_t bits) {
+        std::size_t need = bits ? BitWords::wordsFor(bits) : 0;
+        if (need != nWords) {
+            unsigned long long* fresh = need ? BitWords::allocate(need) : nullptr;
+            std::size_t keep = need < nWords ? need : nWords;
+            if (keep) std::memcpy(fresh, words, keep * sizeof(unsigned long long));
+            BitWords::deallocate(words);
+            words = fresh;
+            nWords = need;
+        }
+        if (bits < nBits) BitWords::fill(words, bits, nWords * BitWords::WORD_BITS, false);
+        nBits = bits;
+    }
+
+    void set(std::size_t pos) {
+        if (pos >= nBits) throw std::out_of_range("DynamicBitset index out of range");
+        set_unchecked(pos);
+    }
+    void reset(std::size_t pos) {
+        if (pos >= nBits) throw std::out_of_range("DynamicBitset index out of range");
+        reset_unchecked(pos);
+    }
+    bool test(std::size_t pos) const {
+        if (pos >= nBits) throw std::out_of_range("DynamicBitset index out of range");
+        return test_unchecked(pos);
+    }
+    void set_unchecked(std::size_t pos) { words[pos / 64] |= (1ULL << (pos % 64)); }
+    void reset_unchecked(std::size_t pos) { words[pos / 64] &= ~(1ULL << (pos % 64)); }
+    bool test_unchecked(std::size_t pos) const { return (words[pos / 64] >> (pos % 64)) & 1ULL; }
+
+    void set(std::size_t first, std::size_t last) {
+        if (first > last || last > nBits) throw std::out_of_range("DynamicBitset range out of range");
+        BitWords::fill(words, first, last, true);
+    }
+    void reset(std::size_t first, std::size_t last) {
+        if (first > last || last > nBits) throw std::out_of_range("DynamicBitset range out of range");
+        BitWords::fill(words, first, last, false);
+    }
+
+    std::size_t size() const { return nBits; }
+    // Raw words, bit i in word i / 64; bits past size() must stay zero
+    unsigned long long* data() { return words; }
+    const unsigned long long* data() const { return words; }
+    std::size_t count() const { return BitWords::count(words, nWords); }
+    bool any() const { return find_first() != npos; }
+    bool none() const { return !any(); }
+
+    std::size_t find_first() const { return BitWords::findFrom(words, nWords, 0); }
+    std::size_t find_next(std::size_t pos) const {
+        return pos + 1 >= nBits ? npos : BitWords::findFrom(words, nWords, pos + 1);
+    }
+
+    DynamicBitset& operator&=(const DynamicBitset& o) {
+        checkSameSize(o);
+        BitWords::combine<BitWords::And>(words, o.words, nWords);
+        return *this;
+    }
+    DynamicBitset& operator|=(const DynamicBitset& o) {
+        checkSameSize(o);
+        BitWords::combine<BitWords::Or>(words, o.words, nWords);
+        return *this;
+    }
+    DynamicBitset& operator^=(const DynamicBitset& o) {
+        checkSameSize(o);
+        BitWords::combine<BitWords::Xor>(words, o.words, nWords);
+        return *this;
+    }
+    DynamicBitset& andNot(const DynamicBitset& o) {
+        checkSameSize(o);
+        BitWords::combine<BitWords::AndNot>(words, o.words, nWords);
+        return *this;
+    }
+    DynamicBitset operator&(const DynamicBitset& o) const { DynamicBitset r(*this); return r &= o; }
+    DynamicBitset operator|(const DynamicBitset& o) const { DynamicBitset r(*this); return r |= o; }
+    DynamicBitset operator^(const DynamicBitset& o) const { DynamicBitset r(*this); return r ^= o; }
+    DynamicBitset operator~() const {
+        DynamicBitset r(*this);
+        BitWords::flipAll(r.words, r.nWords, nBits);
+        return r;
+    }
+    bool operator==(const DynamicBitset& o) const {
+        return nBits == o.nBits && BitWords::equal(words, o.words, nWords);
+    }
+    bool operator!=(const DynamicBitset& o) const { return !(*this == o); }
+
+    void print() {
+        std::cout << "DynamicBitset(" << nBits << "): ";
+        for (std::size_t i = 0; i < nBits; i++) {
+            std::cout << (test_unchecked(i) ? 1 : 0);
+        }
+        std::cout << std::endl;
+    }
+};
+
+//---------------------------------------------------
+// RoaringBitmap - compressed set of 32-bit unsigned integers
+// A value's high 16 bits pick a chunk and its low 16 bits are stored in
+// that chunk's container:
+//  - array:  sorted uint16 values, used up to 4096 values (8 KB at most)
+//  - bitmap: a 65536-bit DynamicBitset (8 KB), used above 4096 values
+//  - run:    (start, length - 1) pairs, produced by runOptimize()
+// Set operations work chunk by chunk. Bitmap-bitmap pairs use the SIMD
+// BitWords kernels and popcount. Array pairs use a linear merge, or
+// galloping when one side is much smaller. A run container is expanded
+// before it is modified or combined.
+// serialize() writes a fixed little-endian layout, so the bytes read the
+// same on any host:
+//   u32 chunk count, then per chunk: u16 key, u8 kind, u32 n, payload
+//   (n u16 values | 1024 u64 words | n u16 start/length pairs)
+class RoaringBitmap {
+private:
+    static const std::uint32_t ARRAY_MAX = 4096;
+    static const std::uint32_t CHUNK_BITS = 65536;
+
+    enum Kind : unsigned char { ARRAY = 0, BITMAP = 1, RUN = 2 };
+
+    struct Container {
+        Kind kind;
+        std::uint32_t card;
+        std::vector<std::uint16_t> vals;   // ARRAY: sorted values; RUN: start, length-1 pairs
+        DynamicBitset bits;                // BITMAP only
+
+        Container() : kind(ARRAY), card(0) {}
+    };
+
+    std::vector<std::uint16_t> keys;
+    std::vector<Container> conts;
+
+    template<typename Fn>
+    static void forEachIn(const Container& c, Fn fn) {
+        if (c.kind == ARRAY) {
+            for (std::uint16_t v : c.vals) fn(v);
+        } else if (c.kind == BITMAP) {
+            for (std::size_t p = c.bits.find_first(); p != DynamicBitset::npos; p = c.bits.find_next(p)) {
+                fn(static_cast<std::uint16_t>(p));
+            }
+        } else {
+            for (std::size_t r = 0; r < c.vals.size(); r += 2) {
+                std::uint32_t end = std::uint32_t(c.vals[r]) + c.vals[r + 1];
+                for (std::uint32_t v = c.vals[r]; v <= end; v++) fn(static_cast<std::uint16_t>(v));
+            }
+        }
+    }
+
+    static void toBitmap(Container& c) {
+        DynamicBitset bits(CHUNK_BITS);
+        forEachIn(c, [&bits](std::uint16_t v) { bits.set_unchecked(v); });
+        c.bits = std::move(bits);
+        c.vals.clear();
+        c.vals.shrink_to_fit();
+        c.kind = BITMAP;
+    }
+
+    static void toArray(Container& c) {
+        std::vector<std::uint16_t> vals;
+        vals.reserve(c.card);
+        forEachIn(c, [&vals](std::uint16_t v) { vals.push_back(v); });
+        c.vals.swap(vals);
+        c.bits = DynamicBitset();
+        c.kind = ARRAY;
+    }
+
+    // Picks array or bitmap by cardinality; run containers are expanded
+    static void normalize(Container& c) {
+        if (c.kind == BITMAP && c.card <= ARRAY_MAX) toArray(c);
+        else if (c.kind == ARRAY && c.card > ARRAY_MAX) toBitmap(c);
+        else if (c.kind == RUN) {
+            if (c.card > ARRAY_MAX) toBitmap(c);
+            else toArray(c);
+        }
+    }
+
+    static const Container& expanded(const Container& c, Container& scratch) {
+        if (c.kind != RUN) return c;
+        scratch = c;
+        normalize(scratch);
+        return scratch;
+    }
+
+    static bool containerContains(const Container& c, std::uint16_t v) {
+        if (c.kind == ARRAY) return std::binary_search(c.vals.begin(), c.vals.end(), v);
+        if (c.kind == BITMAP) return c.bits.test_unchecked(v);
+        std::size_t lo = 0, hi = c.vals.size() / 2;   // first run starting after v
+        while (lo < hi) {
+            std::size_t mid = (lo + hi) / 2;
+            if (c.vals[2 * mid] <= v) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo > 0 && v <= std::uint32_t(c.vals[2 * (lo - 1)]) + c.vals[2 * (lo - 1) + 1];
+    }
+
+    // First index in [from, n) with a[index] >= v, probing 1, 2, 4, ... ahead
+    static std::size_t gallop(const std::vector<std::uint16_t>& a, std::size_t from, std::uint16_t v) {
+        std::size_t step = 1, hi = from;
+        while (hi < a.size() && a[hi] < v) {
+            from = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        if (hi > a.size()) hi = a.size();
+        return std::lower_bound(a.begin() + from, a.begin() + hi, v) - a.begin();
+    }
+
+    static std::vector<std::uint16_t> intersectArrays(const std::vector<std::uint16_t>& a,
+                                                      const std::vector<std::uint16_t>& b) {
+        const std::vector<std::uint16_t>& small = a.size() <= b.size() ? a : b;
+        const std::vector<std::uint16_t>& large = a.size() <= b.size() ? b : a;
+        std::vector<std::uint16_t> out;
+        if (small.size() * 32 < large.size()) {
+            std::size_t j = 0;
+            for (std::uint16_t v : small) {
+                j = gallop(large, j, v);
+                if (j == large.size()) break;
+                if (large[j] == v) out.push_back(v);
+            }
+            return out;
+        }
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+        return out;
+    }
+
+    static Container unite(const Container& x, const Container& y) {
+        Container sx, sy;
+        const Container& a = expanded(x, sx);
+        const Container& b = expanded(y, sy);
+        Container r;
+        if (a.kind == ARRAY && b.kind == ARRAY) {
+            r.vals.reserve(a.vals.size() + b.vals.size());
+            std::set_union(a.vals.begin(), a.vals.end(), b.vals.begin(), b.vals.end(), std::back_inserter(r.vals));
+            r.card = static_cast<std::uint32_t>(r.vals.size());
+            normalize(r);
+            return r;
+        }
+        const Container& big = (a.kind == BITMAP) ? a : b;
+        const Container& other = (a.kind == BITMAP) ? b : a;
+        r.kind = BITMAP;
+        r.bits = big.bits;
+        if (other.kind == BITMAP) r.bits |= other.bits;
+        else for (std::uint16_t v : other.vals) r.bits.set_unchecked(v);
+        r.card = static_cast<std::uint32_t>(r.bits.count());
+        return r;
+    }
+
+    static Container intersect(const Container& x, const Container& y) {
+        Container sx, sy;
+        const Container& a = expanded(x, sx);
+        const Container& b = expanded(y, sy);
+        Container r;
+        if (a.kind == BITMAP && b.kind == BITMAP) {
+            r.kind = BITMAP;
+            r.bits = a.bits & b.bits;
+            r.card = static_cast<std::uint32_t>(r.bits.count());
+            normalize(r);
+            return r;
+        }
+        if (a.kind == ARRAY && b.kind == ARRAY) r.vals = intersectArrays(a.vals, b.vals);
+        else {
+            const Container& arr = (a.kind == ARRAY) ? a : b;
+            const Container& bm = (a.kind == ARRAY) ? b : a;
+            for (std::uint16_t v : arr.vals) {
+                if (bm.bits.test_unchecked(v)) r.vals.push_back(v);
+            }
+        }
+        r.card = static_cast<std::uint32_t>(r.vals.size());
+        return r;
+    }
+
+    static Container subtract(const Container& x, const Container& y) {
+        Container sx, sy;
+        const Container& a = expanded(x, sx);
+        const Container& b = expanded(y, sy);
+        Container r;
+        if (a.kind == ARRAY) {
+            if (b.kind == ARRAY) {
+                std::set_difference(a.vals.begin(), a.vals.end(), b.vals.begin(), b.vals.end(), std::back_inserter(r.vals));
+            } else {
+                for (std::uint16_t v : a.vals) {
+                    if (!b.bits.test_unchecked(v)) r.vals.push_back(v);
+                }
+            }
+            r.card = static_cast<std::uint32_t>(r.vals.size());
+            return r;
+        }
+        r.kind = BITMAP;
+        r.bits = a.bits;
+        if (b.kind == BITMAP) r.bits.andNot(b.bits);
+        else for (std::uint16_t v : b.vals) r.bits.reset_unchecked(v);
+        r.card = static_cast<std::uint32_t>(r.bits.count());
+        normalize(r);
+        return r;
+    }
+
+    // Index of 'key' in keys, or of the slot where it would be inserted
+    std::size_t findKey(std::uint16_t key) const {
+        return std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+    }
+
+    void append(std::uint16_t key, Container&& c) {
+        if (!c.card) return;
+        keys.push_back(key);
+        conts.push_back(std::move(c));
+    }
+
+    static void putU16(std::vector<unsigned char>& out, std::uint16_t v) {
+        out.push_back(static_cast<unsigned char>(v));
+        out.push_back(static_cast<unsigned char>(v >> 8));
+    }
+    static void putU32(std::vector<unsigned char>& out, std::uint32_t v) {
+        for (int i = 0; i < 4; i++) out.push_back(static_cast<unsigned char>(v >> (8 * i)));
+    }
+    static unsigned long long getLE(const unsigned char*& p, const unsigned char* end, int bytes) {
+        if (end - p < bytes) throw std::invalid_argument("RoaringBitmap data truncated");
+        unsigned long long v = 0;
+        for (int i = 0; i < bytes; i++) v |= static_cast<unsigned long long>(p[i]) << (8 * i);
+        p += bytes;
+        return v;
+    }
+
+public:
+    void add(std::uint32_t x) {
+        std::uint16_t key = static_cast<std::uint16_t>(x >> 16), low = static_cast<std::uint16_t>(x);
+        std::size_t i = findKey(key);
+        if (i == keys.size() || keys[i] != key) {
+            keys.insert(keys.begin() + i, key);
+            conts.insert(conts.begin() + i, Container());
+        }
+        Container& c = conts[i];
+        if (c.kind == RUN) normalize(c);
+        if (c.kind == BITMAP) {
+            if (!c.bits.test_unchecked(low)) {
+                c.bits.set_unchecked(low);
+                c.card++;
+            }
+            return;
+        }
+        std::vector<std::uint16_t>::iterator it = std::lower_bound(c.vals.begin(), c.vals.end(), low);
+        if (it != c.vals.end() && *it == low) return;
+        c.vals.insert(it, low);
+        c.card++;
+        if (c.card > ARRAY_MAX) toBitmap(c);
+    }
+
+    bool remove(std::uint32_t x) {
+        std::uint16_t key = static_cast<std::uint16_t>(x >> 16), low = static_cast<std::uint16_t>(x);
+        std::size_t i = findKey(key);
+        if (i == keys.size() || keys[i] != key || !containerContains(conts[i], low)) return false;
+        Container& c = conts[i];
+        if (c.kind == RUN) normalize(c);
+        if (c.kind == BITMAP) {
+            c.bits.reset_unchecked(low);
+            c.card--;
+            if (c.card <= ARRAY_MAX) toArray(c);
+        } else {
+            c.vals.erase(std::lower_bound(c.vals.begin(), c.vals.end(), low));
+            c.card--;
+        }
+        if (!c.card) {
+            keys.erase(keys.begin() + i);
+            conts.erase(conts.begin() + i);
+        }
+        return true;
+    }
+
+    bool contains(std::uint32_t x) const {
+        std::uint16_t key = static_cast<std::uint16_t>(x >> 16);
+        std::size_t i = findKey(key);
+        return i < keys.size() && keys[i] == key && containerContains(conts[i], static_cast<std::uint16_t>(x));
+    }
+
+    std::size_t cardinality() const {
+        std::size_t total = 0;
+        for (const Container& c : conts) total += c.card;
+        return total;
+    }
+    bool empty() const { return keys.empty(); }
+
+    // Turns each container into runs where that is the smallest encoding
+    void runOptimize() {
+        for (Container& c : conts) {
+            if (c.kind == RUN) continue;
+            std::vector<std::uint16_t> runs;
+            forEachIn(c, [&runs](std::uint16_t v) {
+                if (!runs.empty() && std::uint32_t(runs[runs.size() - 2]) + runs.back() + 1 == v) runs.back()++;
+                else {
+                    runs.push_back(v);
+                    runs.push_back(0);
+                }
+            });
+            std::size_t current = (c.kind == ARRAY) ? 2 * c.vals.size() : CHUNK_BITS / 8;
+            if (2 * runs.size() < current) {
+                c.vals.swap(runs);
+                c.bits = DynamicBitset();
+                c.kind = RUN;
+            }
+        }
+    }
+
+    RoaringBitmap operator|(const RoaringBitmap& o) const {
+        RoaringBitmap r;
+        std::size_t i = 0, j = 0;
+        while (i < keys.size() || j < o.keys.size()) {
+            if (j == o.keys.size() || (i < keys.size() && keys[i] < o.keys[j])) {
+                r.keys.push_back(keys[i]);
+                r.conts.push_back(conts[i++]);
+            } else if (i == keys.size() || o.keys[j] < keys[i]) {
+                r.keys.push_back(o.keys[j]);
+                r.conts.push_back(o.conts[j++]);
+            } else {
+                r.append(keys[i], unite(conts[i], o.conts[j]));
+                i++;
+                j++;
+            }
+        }
+        return r;
+    }
+
+    RoaringBitmap operator&(const RoaringBitmap& o) const {
+        RoaringBitmap r;
+        std::size_t i = 0, j = 0;
+        while (i < keys.size() && j < o.keys.size()) {
+            if (keys[i] < o.keys[j]) i++;
+            else if (o.keys[j] < keys[i]) j++;
+            else {
+                r.append(keys[i], intersect(conts[i], o.conts[j]));
+                i++;
+                j++;
+            }
+        }
+        return r;
+    }
+
+    // Values in *this that are not in o
+    RoaringBitmap operator-(const RoaringBitmap& o) const {
+        RoaringBitmap r;
+        std::size_t j = 0;
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            while (j < o.keys.size() && o.keys[j] < keys[i]) j++;
+            if (j < o.keys.size() && o.keys[j] == keys[i]) r.append(keys[i], subtract(conts[i], o.conts[j]));
+            else {
+                r.keys.push_back(keys[i]);
+                r.conts.push_back(conts[i]);
+            }
+        }
+        return r;
+    }
+
+    RoaringBitmap& operator|=(const RoaringBitmap& o) { return *this = *this | o; }
+    RoaringBitmap& operator&=(const RoaringBitmap& o) { return *this = *this & o; }
+    RoaringBitmap& operator-=(const RoaringBitmap& o) { return *this = *this - o; }
+
+    // Calls fn(value) for every value in ascending order
+    template<typename Fn>
+    void forEach(Fn fn) const {
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            std::uint32_t high = std::uint32_t(keys[i]) << 16;
+            forEachIn(conts[i], [&fn, high](std::uint16_t low) { fn(high | low); });
+        }
+    }
+
+    std::vector<unsigned char> serialize() const {
+        std::vector<unsigned char> out;
+        putU32(out, static_cast<std::uint32_t>(keys.size()));
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            const Container& c = conts[i];
+            putU16(out, keys[i]);
+            out.push_back(static_cast<unsigned char>(c.kind));
+            if (c.kind == BITMAP) {
+                putU32(out, c.card);
+                const unsigned long long* words = c.bits.data();
+                for (std::size_t w = 0; w < CHUNK_BITS / 64; w++) {
+                    for (int b = 0; b < 8; b++) out.push_back(static_cast<unsigned char>(words[w] >> (8 * b)));
+                }
+            } else {
+                std::uint32_t n = static_cast<std::uint32_t>(c.kind == RUN ? c.vals.size() / 2 : c.vals.size());
+                putU32(out, n);
+                for (std::uint16_t v : c.vals) putU16(out, v);
+            }
+        }
+        return out;
+    }
+
+    // Rebuilds a bitmap from serialize() output; malformed input throws
+    static RoaringBitmap deserialize(const unsigned char* data, std::size_t size) {
+        const unsigned char* p = data;
+        const unsigned char* end = data + size;
+        RoaringBitmap r;
+        std::uint32_t chunks = static_cast<std::uint32_t>(getLE(p, end, 4));
+        for (std::uint32_t k = 0; k < chunks; k++) {
+            std::uint16_t key = static_cast<std::uint16_t>(getLE(p, end, 2));
+            if (!r.keys.empty() && key <= r.keys.back()) throw std::invalid_argument("RoaringBitmap keys not ascending");
+            Container c;
+            unsigned kind = static_cast<unsigned>(getLE(p, end, 1));
+            std::uint32_t n = static_cast<std::uint32_t>(getLE(p, end, 4));
+            if (kind == BITMAP) {
+                c.kind = BITMAP;
+                c.bits = DynamicBitset(CHUNK_BITS);
+                unsigned long long* words = c.bits.data();
+                for (std::size_t w = 0; w < CHUNK_BITS / 64; w++) words[w] = getLE(p, end, 8);
+                c.card = static_cast<std::uint32_t>(c.bits.count());
+                if (c.card != n) throw std::invalid_argument("RoaringBitmap bitmap cardinality mismatch");
+            } else if (kind == ARRAY) {
+                if (n > ARRAY_MAX) throw std::invalid_argument("RoaringBitmap array container too large");
+                for (std::uint32_t v = 0; v < n; v++) {
+                    c.vals.push_back(static_cast<std::uint16_t>(getLE(p, end, 2)));
+                    if (v && c.vals[v] <= c.vals[v - 1]) throw std::invalid_argument("RoaringBitmap array not sorted");
+                }
+                c.card = n;
+            } else if (kind == RUN) {
+                c.kind = RUN;
+                std::uint32_t next = 0;   // smallest start the next run may have
+                for (std::uint32_t v = 0; v < n; v++) {
+                    std::uint32_t start = static_cast<std::uint32_t>(getLE(p, end, 2));
+                    std::uint32_t len = static_cast<std::uint32_t>(getLE(p, end, 2));
+                    if (start < next || start + len >= CHUNK_BITS) throw std::invalid_argument("RoaringBitmap bad run");
+                    c.vals.push_back(static_cast<std::uint16_t>(start));
+                    c.vals.push_back(static_cast<std::uint16_t>(len));
+                    c.card += len + 1;
+                    next = start + len + 2;
+                }
+            } else {
+                throw std::invalid_argument("RoaringBitmap unknown container kind");
+            }
+            if (!c.card) throw std::invalid_argument("RoaringBitmap empty container");
+            r.keys.push_back(key);
+            r.conts.push_back(std::move(c));
+        }
+        if (p != end) throw std::invalid_argument("RoaringBitmap trailing bytes");
+        return r;
+    }
+
+    void print() {
+        std::cout << "RoaringBitmap (" << cardinality() << " values, " << keys.size() << " chunks): ";
+        bool first = true;
+        forEach([&first](std::uint32_t v) {
+            if (!first) std::cout << ", ";
+            std::cout << v;
+            first = false;
+        });
+        std::cout << std::endl;
+    }
+};
+
+//---------------------------------------------------
+// Deque<T> - segmented block map
+// Elements live in fixed-size blocks of about 512 bytes. A map of block
+// pointers tracks them, and the map has free slots at both ends. Growing
+// at either end allocates at most one block and never moves an element.
+// When the map itself runs out, only the block pointers are re-centred
+// into a bigger map. References stay valid until their element is popped.
+// Position p (counted from the start of the map) is block p / BLOCK_SIZE,
+// slot p % BLOCK_SIZE.
+template<typename T>
+class Deque {
+private:
+    static const std::size_t BLOCK_SIZE = (sizeof(T) < 32) ? 512 / sizeof(T) : 16;
+
+    T** map;
+    std::size_t mapSize;
+    std::size_t begin;    // position of the front element
+    std::size_t count;
+    T* spare;             // one emptied block kept back to avoid alloc/free thrash
+
+    T* allocBlock() {
+        if (spare) {
+            T* b = spare;
+            spare = nullptr;
+            return b;
+        }
+        return static_cast<T*>(::operator new(sizeof(T) * BLOCK_SIZE));
+    }
+
+    void freeBlock(T* b) {
+        if (!spare) spare = b;
+        else ::operator delete(b);
+    }
+
+    // Moves the block pointers into a map with room for 'extra' more blocks,
+    // centred so both ends have slack
+    void remap(std::size_t extra) {
+        std::size_t firstUsed = begin / BLOCK_SIZE;
+        std::size_t used = count ? (begin + count - 1) / BLOCK_SIZE - firstUsed + 1 : 0;
+        std::size_t newSize = mapSize;
+        while (newSize < used + extra + 2) newSize = newSize ? newSize * 2 : 8;
+        std::size_t offset = (newSize - used) / 2;
+        T** newMap = new T*[newSize]();
+        for (std::size_t i = 0; i < used; i++) newMap[offset + i] = map[firstUsed + i];
+        // Blocks outside the used range only exist when count == 0
+        for (std::size_t i = 0; i < mapSize; i++) {
+            if (map[i] && (i < firstUsed || i >= firstUsed + used)) freeBlock(map[i]);
+        }
+        delete[] map;
+        map = newMap;
+        mapSize = newSize;
+        begin = offset * BLOCK_SIZE + begin % BLOCK_SIZE;
+    }
+
+    T& at(std::size_t pos) { return map[pos / BLOCK_SIZE][pos % BLOCK_SIZE]; }
+
+public:
+    Deque() : map(nullptr), mapSize(0), begin(0), count(0), spare(nullptr) {}
+    Deque(const Deque&) = delete;
+    Deque& operator=(const Deque&) = delete;
+
+    ~Deque() {
+        clear();
+        for (std::size_t i = 0; i < mapSize; i++) {
+            if (map[i]) ::operator delete(map[i]);
+        }
+        ::operator delete(spare);
+        delete[] map;
+    }
+
+    bool empty() const { return count == 0; }
+    std::size_t size() const { return count; }
+
+    void push_back(const T& val) {
+        if (!map || (begin + count) / BLOCK_SIZE >= mapSize) remap(1);
+        std::size_t pos = begin + count;
+        T*& block = map[pos / BLOCK_SIZE];
+        if (!block) block = allocBlock();
+        new (&block[pos % BLOCK_SIZE]) T(val);
+        count++;
+    }
+
+    void push_front(const T& val) {
+        if (!map || begin == 0) remap(1);
+        std::size_t pos = begin - 1;
+        T*& block = map[pos / BLOCK_SIZE];
+        if (!block) block = allocBlock();
+        new (&block[pos % BLOCK_SIZE]) T(val);
+        begin = pos;
+        count++;
+    }
+
+    T pop_back() {
+        if (empty()) throw std::underflow_error("Deque is empty");
+        std::size_t pos = begin + count - 1;
+        T val = std::move(at(pos));
+        at(pos).~T();
+        count--;
+        if (pos % BLOCK_SIZE == 0) {
+            freeBlock(map[pos / BLOCK_SIZE]);
+            map[pos / BLOCK_SIZE] = nullptr;
+        }
+        return val;
+    }
+
+    T pop_front() {
+        if (empty()) throw std::underflow_error("Deque is empty");
+        T val = std::move(at(begin));
+        at(begin).~T();
+        count--;
+        begin++;
+        if (begin % BLOCK_SIZE == 0 || count == 0) {
+            std::size_t b = (begin - 1) / BLOCK_SIZE;
+            freeBlock(map[b]);
+            map[b] = nullptr;
+        }
+        return val;
+    }
+
+    T& front() {
+        if (empty()) throw std::underflow_error("Deque is empty");
+        return at(begin);
+    }
+
+    T& back() {
+        if (empty()) throw std::underflow_error("Deque is empty");
+        return at(begin + count - 1);
+    }
+
+    T& operator[](std::size_t idx) {
+        if (idx >= count) throw std::out_of_range("Deque index out of range");
+        return at(begin + idx);
+    }
+
+    void clear() {
+        while (count) pop_back();
+    }
+
+    // Returns unused memory: the spare block, and the map if it is
+    // much larger than the blocks in use
+    void shrink_to_fit() {
+        ::operator delete(spare);
+        spare = nullptr;
+        if (!count) {
+            for (std::size_t i = 0; i < mapSize; i++) ::operator delete(map[i]);
+            delete[] map;
+            map = nullptr;
+            mapSize = 0;
+            begin = 0;
+            return;
+        }
+        std::size_t firstUsed = begin / BLOCK_SIZE;
+        std::size_t used = (begin + count - 1) / BLOCK_SIZE - firstUsed + 1;
+        if (mapSize <= 4 * (used + 2)) return;
+        T** newMap = new T*[used + 2]();
+        for (std::size_t i = 0; i < used; i++) newMap[1 + i] = map[firstUsed + i];
+        delete[] map;
+        map = newMap;
+        mapSize = used + 2;
+        begin = BLOCK_SIZE + begin % BLOCK_SIZE;
+    }
+
+    void print() {
+        std::cout << "Deque: ";
+        for (std::size_t i = 0; i < count; i++) {
+            std::cout << at(begin + i);
+            if (i < count - 1) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+};
+
+//---------------------------------------------------
+// ForwardList<T>
+template<typename T>
+class ForwardList {
+private:
+    Node<T>* head;
+    NodeArena<T> arena;
+
+public:
+    ForwardList() : head(nullptr) {}
+    ~ForwardList() {
+        if (!std::is_trivially_destructible<T>::value) {
+            Node<T>* temp = head;
+            while (temp) {
+                Node<T>* toDel = temp;
+                temp = temp->getNext();
+                toDel->~Node<T>();
+            }
+        }
+    }
+
+    void push_front(const T& val) {
+        Node<T>* newNode = arena.create(val);
+        newNode->setNext(head);
+        head = newNode;
+    }
+
+    T pop_front() {
+        if (!head) throw std::underflow_error("ForwardList is empty");
+        Node<T>* temp = head;
+        T retVal = temp->getVal();
+        head = head->getNext();
+        arena.destroy(temp);
+        return retVal;
+    }
+
+    bool empty() const { return head == nullptr; }
+
+    void print() {
+        std::cout << "ForwardList: ";
+        Node<T>* temp = head;
+        while (temp) {
+            std::cout << temp->getVal();
+            temp = temp->getNext();
+            if (temp) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+};
+
+template<typename T> class Vector;
+template<typename T, std::size_t N> class SmallVector;
+
+//---------------------------------------------------
+// VectorBase<T> - the dynamic array shared by Vector and SmallVector
+// Storage is raw memory; elements are placement-new'd only as they are
+// added, so a reserve() or a growth step costs no default constructions.
+// Growing relocates the old elements with std::move_if_noexcept, or with
+// one memcpy when T is trivially copyable. The new element is built in
+// the new buffer before the old one is released, so push_back(v[0])
+// stays valid across a reallocation.
+// A derived class may lend it a fixed inline buffer (see SmallVector); the
+// buffer is used while the elements fit and is never freed. Construction,
+// destruction and moves are protected. Moving out of an inline buffer
+// costs an allocation and per-element moves, either of which can throw.
+// Keeping the moves protected means Vector's noexcept move can only ever
+// see another Vector, which always has its elements on the heap.
+template<typename T>
+class VectorBase {
+private:
+    static const bool TRIVIAL = std::is_trivially_copyable<T>::value;
+
+    T* elems;
+    std::size_t cap;
+    std::size_t length;
+    double growth;
+    T* inlineBuf;
+    std::size_t inlineCap;
+
+    static T* allocate(std::size_t n) {
+        if (!n) return nullptr;
+        if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    static void deallocate(T* p) {
+        if (!p) return;
+        if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) ::operator delete(p, std::align_val_t(alignof(T)));
+        else ::operator delete(p);
+    }
+
+    void release(T* p) {
+        if (p != inlineBuf) deallocate(p);
+    }
+
+    static void destroy(T* first, std::size_t n) {
+        if (!std::is_trivially_destructible<T>::value) {
+            for (std::size_t i = 0; i < n; i++) first[i].~T();
+        }
+    }
+
+    // Moves (or copies, if moving could throw) n elements into raw memory at
+    // dst and destroys the sources. On an exception dst is left empty.
+    static void relocate(T* src, std::size_t n, T* dst) {
+        if (TRIVIAL) {
+            if (n) std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), n * sizeof(T));
+            return;
+        }
+        std::size_t i = 0;
+        try {
+            for (; i < n; i++) new (dst + i) T(std::move_if_noexcept(src[i]));
+        } catch (...) {
+            destroy(dst, i);
+            throw;
+        }
+        destroy(src, n);
+    }
+
+    std::size_t nextCapacity(std::size_t minCap) const {
+        std::size_t next = static_cast<std::size_t>(cap * growth);
+        if (next <= cap) next = cap + 1;
+        if (next < 4) next = 4;
+        return next < minCap ? minCap : next;
+    }
+
+    // Also moves the elements back into the inline buffer when they fit
+    void reallocate(std::size_t newCap) {
+        bool toInline = inlineBuf && newCap <= inlineCap;
+        if (toInline && elems == inlineBuf) return;
+        T* fresh = toInline ? inlineBuf : allocate(newCap);
+        try {
+            relocate(elems, length, fresh);
+        } catch (...) {
+            release(fresh);
+            throw;
+        }
+        release(elems);
+        elems = fresh;
+        cap = toInline ? inlineCap : newCap;
+    }
+
+    // Takes over orig's heap buffer, or relocates out of its inline one
+    void takeFrom(VectorBase& orig) {
+        if (orig.isInline()) {
+            reserve(orig.length);
+            relocate(orig.elems, orig.length, elems);
+            length = orig.length;
+        } else {
+            elems = orig.elems;
+            cap = orig.cap;
+            length = orig.length;
+            orig.elems = orig.inlineBuf;
+            orig.cap = orig.inlineCap;
+        }
+        orig.length = 0;
+    }
+
+    // Builds the new last element into a larger buffer, then moves the rest
+    template<typename... Args>
+    T& growAndEmplace(Args&&... args) {
+        std::size_t newCap = nextCapacity(length + 1);
+        T* fresh = allocate(newCap);
+        try {
+            new (fresh + length) T(std::forward<Args>(args)...);
+        } catch (...) {
+            deallocate(fresh);
+            throw;
+        }
+        try {
+            relocate(elems, length, fresh);
+        } catch (...) {
+            fresh[length].~T();
+            deallocate(fresh);
+            throw;
+        }
+        release(elems);
+        elems = fresh;
+        cap = newCap;
+        return elems[length++];
+    }
+
+protected:
+    explicit VectorBase(std::size_t initialCap)
+    : elems(allocate(initialCap)), cap(initialCap), length(0), growth(2.0),
+      inlineBuf(nullptr), inlineCap(0) {}
+
+    // 'storage' is raw memory for inlineCapacity elements owned by the caller
+    VectorBase(T* storage, std::size_t inlineCapacity)
+    : elems(storage), cap(inlineCapacity), length(0), growth(2.0),
+      inlineBuf(storage), inlineCap(inlineCapacity) {}
+
+    VectorBase(std::initializer_list<T> list) : VectorBase(list.size()) {
+        for (const T& v : list) new (elems + length++) T(v);
+    }
+
+    VectorBase(const VectorBase& orig) : VectorBase(orig.length) {
+        growth = orig.growth;
+        if (TRIVIAL) {
+            if (orig.length) std::memcpy(static_cast<void*>(elems), static_cast<const void*>(orig.elems), orig.length * sizeof(T));
+            length = orig.length;
+            return;
+        }
+        try {
+            for (; length < orig.length; length++) new (elems + length) T(orig.elems[length]);
+        } catch (...) {
+            destroy(elems, length);
+            deallocate(elems);
+            throw;
+        }
+    }
+
+    // Only Vector calls this, and a Vector's buffer is never inline
+    VectorBase(VectorBase&& orig) noexcept
+    : elems(nullptr), cap(0), length(0), growth(orig.growth), inlineBuf(nullptr), inlineCap(0) {
+        takeFrom(orig);
+    }
+
+    VectorBase& operator=(const VectorBase& orig) {
+        if (this != &orig) {
+            clear();
+            reserve(orig.length);
+            for (std::size_t i = 0; i < orig.length; i++) {
+                new (elems + i) T(orig.elems[i]);
+                length++;
+            }
+        }
+        return *this;
+    }
+
+    ~VectorBase() {
+        destroy(elems, length);
+        release(elems);
+    }
+
+    bool isInline() const { return inlineBuf && elems == inlineBuf; }
+
+    // Move assignment proper. Throws only when orig keeps its elements
+    // inline and relocating them (or allocating room for them) throws.
+    void moveFrom(VectorBase& orig) {
+        if (this == &orig) return;
+        clear();
+        growth = orig.growth;
+        if (!orig.isInline()) {
+            release(elems);
+            elems = inlineBuf;
+            cap = inlineCap;
+        }
+        takeFrom(orig);
+    }
+
+public:
+    void swap(VectorBase& other) {
+        if (isInline() || other.isInline()) {
+            VectorBase tmp(0);
+            tmp.moveFrom(other);
+            other.moveFrom(*this);
+            moveFrom(tmp);
+            return;
+        }
+        std::swap(elems, other.elems);
+        std::swap(cap, other.cap);
+        std::swap(length, other.length);
+        std::swap(growth, other.growth);
+    }
+
+    // Capacity multiplier applied when a full vector grows (must be > 1)
+    void setGrowthFactor(double factor) {
+        if (!(factor > 1.0)) throw std::invalid_argument("Vector growth factor must be > 1");
+        growth = factor;
+    }
+    double growthFactor() const { return growth; }
+
+    void reserve(std::size_t n) {
+        if (n > cap) reallocate(n);
+    }
+
+    void shrink_to_fit() {
+        if (length < cap) reallocate(length);
+    }
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (length == cap) return growAndEmplace(std::forward<Args>(args)...);
+        new (elems + length) T(std::forward<Args>(args)...);
+        return elems[length++];
+    }
+
+    void push_back(const T& val) { emplace_back(val); }
+    void push_back(T&& val) { emplace_back(std::move(val)); }
+
+    T pop_back() {
+        if (length == 0) throw std::underflow_error("Vector empty");
+        T val = std::move(elems[--length]);
+        elems[length].~T();
+        return val;
+    }
+
+    // Inserts before position idx (idx == size() appends)
+    template<typename... Args>
+    T& emplace(std::size_t idx, Args&&... args) {
+        if (idx > length) throw std::out_of_range("Vector index out of range");
+        if (idx == length) return emplace_back(std::forward<Args>(args)...);
+        T val(std::forward<Args>(args)...);   // args may alias an element that is about to shift
+        if (length == cap) reallocate(nextCapacity(length + 1));
+        if (TRIVIAL) {
+            std::memmove(static_cast<void*>(elems + idx + 1), static_cast<const void*>(elems + idx), (length - idx) * sizeof(T));
+            new (elems + idx) T(std::move(val));
+        } else {
+            new (elems + length) T(std::move(elems[length - 1]));
+            std::move_backward(elems + idx, elems + length - 1, elems + length);
+            elems[idx] = std::move(val);
+        }
+        length++;
+        return elems[idx];
+    }
+
+    void insert(std::size_t idx, const T& val) { emplace(idx, val); }
+    void insert(std::size_t idx, T&& val) { emplace(idx, std::move(val)); }
+
+    // Removes [first, last) and closes the gap
+    void erase(std::size_t first, std::size_t last) {
+        if (first > last || last > length) throw std::out_of_range("Vector index out of range");
+        if (first == last) return;
+        if (TRIVIAL) {
+            std::memmove(static_cast<void*>(elems + first), static_cast<const void*>(elems + last), (length - last) * sizeof(T));
+        } else {
+            std::move(elems + last, elems + length, elems + first);
+            destroy(elems + length - (last - first), last - first);
+        }
+        length -= last - first;
+    }
+
+    void erase(std::size_t idx) {
+        if (idx >= length) throw std::out_of_range("Vector index out of range");
+        erase(idx, idx + 1);
+    }
+
+    void clear() {
+        destroy(elems, length);
+        length = 0;
+    }
+
+    T& operator[](std::size_t idx) {
+        if (idx >= length) throw std::out_of_range("Vector index out of range");
+        return elems[idx];
+    }
+    const T& operator[](std::size_t idx) const {
+        if (idx >= length) throw std::out_of_range("Vector index out of range");
+        return elems[idx];
+    }
+
+    T* data() { return elems; }
+    const T* data() const { return elems; }
+    T* begin() { return elems; }
+    T* end() { return elems + length; }
+    const T* begin() const { return elems; }
+    const T* end() const { return elems + length; }
+
+    std::size_t size() const { return length; }
+    std::size_t capacity() const { return cap; }
+    bool empty() const { return length == 0; }
+
+    void print() {
+        std::cout << "Vector: ";
+        for (std::size_t i = 0; i < length; i++) {
+            std::cout << elems[i];
+            if (i < length - 1) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+};
+
+//---------------------------------------------------
+// Vector<T> - dynamic array, always heap-backed
+// Its elements are never inline, so its moves only hand over a buffer and
+// are noexcept. A SmallVector source picks the overloads that may have
+// to move inline elements one by one.
+template<typename T>
+class Vector : public VectorBase<T> {
+public:
+    Vector(std::size_t initialCap = 0) : VectorBase<T>(initialCap) {}
+    Vector(std::initializer_list<T> list) : VectorBase<T>(list) {}
+    Vector(const Vector& orig) : VectorBase<T>(orig) {}
+    Vector(Vector&& orig) noexcept : VectorBase<T>(std::move(orig)) {}
+
+    template<std::size_t N>
+    Vector(SmallVector<T, N>&& orig) : VectorBase<T>(0) {
+        this->moveFrom(orig);
+    }
+
+    Vector& operator=(const Vector& orig) {
+        VectorBase<T>::operator=(orig);
+        return *this;
+    }
+
+    Vector& operator=(Vector&& orig) noexcept {
+        this->moveFrom(orig);
+        return *this;
+    }
+
+    template<std::size_t N>
+    Vector& operator=(SmallVector<T, N>&& orig) {
+        this->moveFrom(orig);
+        return *this;
+    }
+};
+
+//---------------------------------------------------
+// SmallVector<T,N> - Vector with room for N elements inside the object
+// Up to N elements need no heap allocation. The next push moves them to
+// a heap buffer with Vector's usual growth, and shrink_to_fit() moves them
+// back when they fit again. Every operation is VectorBase's own code, so a
+// SmallVector can be passed to anything taking a VectorBase<T>&.
+template<typename T, std::size_t N>
+class SmallVector : public VectorBase<T> {
+    static_assert(N > 0, "SmallVector needs inline room for at least one element");
+
+private:
+    alignas(T) unsigned char storage[N * sizeof(T)];
+
+    T* inlineStorage() { return reinterpret_cast<T*>(storage); }
+
+public:
+    SmallVector() : VectorBase<T>(inlineStorage(), N) {}
+
+    SmallVector(std::initializer_list<T> list) : SmallVector() {
+        this->reserve(list.size());
+        for (const T& v : list) this->push_back(v);
+    }
+
+    SmallVector(const SmallVector& orig) : SmallVector() {
+        VectorBase<T>::operator=(orig);
+    }
+
+    // Inline elements fit this inline buffer, so only T's move can throw
+    SmallVector(SmallVector&& orig) noexcept(std::is_nothrow_move_constructible<T>::value) : SmallVector() {
+        this->moveFrom(orig);
+    }
+
+    SmallVector& operator=(const SmallVector& orig) {
+        VectorBase<T>::operator=(orig);
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector&& orig) noexcept(std::is_nothrow_move_constructible<T>::value) {
+        this->moveFrom(orig);
+        return *this;
+    }
+
+    // Takes over a plain Vector's heap buffer
+    SmallVector(Vector<T>&& orig) : SmallVector() {
+        this->moveFrom(orig);
+    }
+
+    SmallVector& operator=(Vector<T>&& orig) {
+        this->moveFrom(orig);
+        return *this;
+    }
+
+    // The elements may live in 'storage', which goes away before ~Vector runs
+    ~SmallVector() { this->clear(); }
+
+    bool isSmall() const { return this->isInline(); }
+
+    void print() {
+        std::cout << "SmallVector<" << N << ">" << (isSmall() ? " (inline)" : " (heap)") << ": ";
+        for (std::size_t i = 0; i < this->size(); i++) {
+            std::cout << (*this)[i];
+            if (i < this->size() - 1) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+};
+
+//---------------------------------------------------
+// Span<T> - pointer + size
+// subspan/first/last are views into the same buffer; nothing is copied.
+template<typename T>
+class Span {
+private:
+    T* ptr;
+    std::size_t length;
+
+public:
+    static const std::size_t npos = std::size_t(-1);
+
+    Span(T* p, std::size_t len) : ptr(p), length(len) {}
+    T& operator[](std::size_t idx) const {
+        if (idx >= length) throw std::out_of_range("Span index out of range");
+        return ptr[idx];
+    }
+    T& at_unchecked(std::size_t idx) const { return ptr[idx]; }
+
+    // count == npos runs to the end
+    Span subspan(std::size_t offset, std::size_t count = npos) const {
+        if (offset > length) throw std::out_of_range("Span subspan out of range");
+        if (count == npos) count = length - offset;
+        if (count > length - offset) throw std::out_of_range("Span subspan out of range");
+        return Span(ptr + offset, count);
+    }
+    Span first(std::size_t count) const { return subspan(0, count); }
+    Span last(std::size_t count) const {
+        if (count > length) throw std::out_of_range("Span subspan out of range");
+        return subspan(length - count, count);
+    }
+
+    T* data() const { return ptr; }
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + length; }
+    std::size_t size() const { return length; }
+    void print() {
+        std::cout << "Span: ";
+        for (std::size_t i = 0; i < length; i++) {
+            std::cout << ptr[i];
+            if (i < length - 1) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+};
+
+//---------------------------------------------------
+// SortedSearch - branchless lower_bound over a sorted array
+// Each step halves the window with a conditional move instead of a
+// branch, so the loop runs a fixed log2(n) steps and never mispredicts.
+// Both possible next probes are prefetched one step ahead.
+struct SortedSearch {
+    // First position whose element is not less than key (n if none)
+    template<typename T>
+    static std::size_t lowerBound(const T* a, std::size_t n, const T& key) {
+        if (!n) return 0;
+        const T* base = a;
+        std::size_t len = n;
+        while (len > 1) {
+            std::size_t half = len / 2;
+            prefetchRead(base + half / 2);
+            prefetchRead(base + half + half / 2);
+            base = (base[half] < key) ? base + half : base;
+            len -= half;
+        }
+        return (base - a) + (*base < key);
+    }
+
+    // lowerBound for each of count keys. GROUP searches advance in
+    // lockstep (they all take the same number of steps), so up to
+    // 2 * GROUP cache misses are in flight at once instead of one.
+    template<typename T>
+    static void lowerBoundMany(const T* a, std::size_t n, const T* keys, std::size_t count, std::size_t* out) {
+        const std::size_t GROUP = 16;
+        const T* base[GROUP];
+        for (std::size_t g = 0; g < count; g += GROUP) {
+            std::size_t gn = (count - g < GROUP) ? count - g : GROUP;
+            if (!n) {
+                for (std::size_t i = 0; i < gn; i++) out[g + i] = 0;
+                continue;
+            }
+            for (std::size_t i = 0; i < gn; i++) base[i] = a;
+            std::size_t len = n;
+            while (len > 1) {
+                std::size_t half = len / 2;
+                for (std::size_t i = 0; i < gn; i++) {
+                    prefetchRead(base[i] + half / 2);
+                    prefetchRead(base[i] + half + half / 2);
+                }
+                for (std::size_t i = 0; i < gn; i++) {
+                    base[i] = (base[i][half] < keys[g + i]) ? base[i] + half : base[i];
+                }
+                len -= half;
+            }
+            for (std::size_t i = 0; i < gn; i++) out[g + i] = (base[i] - a) + (*base[i] < keys[g + i]);
+        }
+    }
+};
+
+// What insert_bulk does with a key that is already present, or repeated
+// within the batch: keep the earliest value, keep the latest value (as a
+// plain insert does), or throw std::invalid_argument and change nothing.
+enum class DuplicatePolicy { KeepFirst, KeepLast, Throw };
+
+//---------------------------------------------------
+// EytzingerIndex<K> - read-optimised copy of a sorted key array
+// Keys are laid out in BFS order of the implicit search tree (node k has
+// children 2k and 2k+1, slot 0 is unused). The top levels share a few
+// cache lines, and the prefetch a few levels ahead covers all 2^d
+// descendants at once, because they are contiguous. rank[k] maps a node
+// back to its position in the sorted array.
+template<typename K>
+class EytzingerIndex {
+private:
+    Vector<K> keys;
+    Vector<std::size_t> rank;
+    static const std::size_t AHEAD = (sizeof(K) < 64) ? 64 / sizeof(K) : 1;   // descendants per cache line
+
+public:
+    void build(const K* sorted, std::size_t n) {
+        keys.clear();
+        rank.clear();
+        if (!n) return;
+        // order[k] = sorted position of node k, from an in-order walk
+        std::vector<std::size_t> order(n + 1);
+        std::size_t next = 0, k = 1;
+        std::vector<std::size_t> stack;
+        while (next < n) {
+            while (k <= n) {
+                stack.push_back(k);
+                k = 2 * k;
+            }
+            k = stack.back();
+            stack.pop_back();
+            order[k] = next++;
+            k = 2 * k + 1;
+        }
+        keys.reserve(n + 1);
+        rank.reserve(n + 1);
+        keys.push_back(sorted[0]);   // slot 0 placeholder
+        rank.push_back(n);
+        for (std::size_t i = 1; i <= n; i++) {
+            keys.push_back(sorted[order[i]]);
+            rank.push_back(order[i]);
+        }
+    }
+
+    void clear() {
+        keys.clear();
+        rank.clear();
+    }
+
+    // Sorted position of the first key not less than 'key' (size if none)
+    std::size_t lowerBound(const K& key) const {
+        std::size_t n = keys.empty() ? 0 : keys.size() - 1;
+        const K* e = keys.data();
+        std::size_t k = 1;
+        while (k <= n) {
+            if (k * AHEAD <= n) prefetchRead(e + k * AHEAD);
+            k = 2 * k + (e[k] < key);
+        }
+        k >>= countTrailingZeros(~k) + 1;   // undo the trailing right turns
+        return k ? rank.data()[k] : n;
+    }
+
+    // Batched lowerBound, GROUP descents interleaved level by level
+    void lowerBoundMany(const K* query, std::size_t count, std::size_t* out) const {
+        const std::size_t GROUP = 16;
+        std::size_t n = keys.empty() ? 0 : keys.size() - 1;
+        const K* e = keys.data();
+        std::size_t k[GROUP];
+        for (std::size_t g = 0; g < count; g += GROUP) {
+            std::size_t gn = (count - g < GROUP) ? count - g : GROUP;
+            for (std::size_t i = 0; i < gn; i++) k[i] = 1;
+            for (unsigned level = bitLength(n); level > 0; level--) {
+                for (std::size_t i = 0; i < gn; i++) {
+                    if (k[i] * AHEAD <= n) prefetchRead(e + k[i] * AHEAD);
+                }
+                for (std::size_t i = 0; i < gn; i++) {
+                    if (k[i] <= n) k[i] = 2 * k[i] + (e[k[i]] < query[g + i]);
+                }
+            }
+            for (std::size_t i = 0; i < gn; i++) {
+                std::size_t node = k[i] >> (countTrailingZeros(~k[i]) + 1);
+                out[g + i] = node ? rank.data()[node] : n;
+            }
+        }
+    }
+};
+
+//---------------------------------------------------
+// FlatSet<T> 
+// Sorted Vector with O(log n) branchless lookups. insert shifts the tail
+// in one memmove for trivially copyable T. freeze() adds an Eytzinger
+// index for read-heavy phases; the next insert drops it again.
+template<typename T>
+class FlatSet {
+private:
+    Vector<T> vec;
+    EytzingerIndex<T> index;
+    bool frozen;
+
+    std::size_t lowerBound(const T& val) const {
+        return frozen ? index.lowerBound(val) : SortedSearch::lowerBound(vec.data(), vec.size(), val);
+    }
+
+public:
+    FlatSet() : frozen(false) {}
+
+    void insert(const T& val) {
+        std::size_t pos = lowerBound(val);
+        if (pos < vec.size() && !(val < vec.data()[pos])) return;   // already present
+        if (frozen) {
+            index.clear();
+            frozen = false;
+        }
+        vec.insert(pos, val);
+    }
+
+    bool contains(const T& val) const {
+        std::size_t pos = lowerBound(val);
+        return pos < vec.size() && !(val < vec.data()[pos]);
+    }
+
+    // Sorts the batch and merges it into the set in one linear pass
+    template<typename It>
+    void insert_bulk(It first, It last, DuplicatePolicy policy = DuplicatePolicy::KeepLast) {
+        std::vector<T> batch(first, last);
+        std::stable_sort(batch.begin(), batch.end());
+        Vector<T> merged(vec.size() + batch.size());
+        const T* old = vec.data();
+        std::size_t i = 0, n = vec.size();
+        for (std::size_t j = 0; j < batch.size(); ) {
+            std::size_t run = j + 1;   // [j, run) are equal batch elements
+            while (run < batch.size() && !(batch[j] < batch[run])) run++;
+            while (i < n && old[i] < batch[j]) merged.push_back(old[i++]);
+            bool present = (i < n && !(batch[j] < old[i]));
+            if (policy == DuplicatePolicy::Throw && (present || run - j > 1)) {
+                throw std::invalid_argument("FlatSet insert_bulk: duplicate value");
+            }
+            if (present && policy == DuplicatePolicy::KeepFirst) merged.push_back(old[i]);
+            else merged.push_back(policy == DuplicatePolicy::KeepFirst ? batch[j] : batch[run - 1]);
+            if (present) i++;
+            j = run;
+        }
+        while (i < n) merged.push_back(old[i++]);
+        vec = std::move(merged);
+        index.clear();
+        frozen = false;
+    }
+
+    // out[i] = contains(query[i]), with the searches interleaved
+    void contains_many(const T* query, std::size_t count, bool* out) const {
+        std::vector<std::size_t> pos(count);
+        if (frozen) index.lowerBoundMany(query, count, pos.data());
+        else SortedSearch::lowerBoundMany(vec.data(), vec.size(), query, count, pos.data());
+        for (std::size_t i = 0; i < count; i++) {
+            out[i] = pos[i] < vec.size() && !(query[i] < vec.data()[pos[i]]);
+        }
+    }
+
+    void freeze() {
+        index.build(vec.data(), vec.size());
+        frozen = true;
+    }
+    bool isFrozen() const { return frozen; }
+    std::size_t size() const { return vec.size(); }
+
+    void print() {
+        std::cout << "FlatSet: ";
+        vec.print();
+    }
+};
+
+//---------------------------------------------------
+// FlatMap<K,V> 
+// Parallel sorted keys/vals Vectors, searched like FlatSet.
+template<typename K, typename V>
+class FlatMap {
+private:
+    Vector<K> keys;
+    Vector<V> vals;
+    EytzingerIndex<K> index;
+    bool frozen;
+
+    std::size_t lowerBound(const K& key) const {
+        return frozen ? index.lowerBound(key) : SortedSearch::lowerBound(keys.data(), keys.size(), key);
+    }
+
+    bool found(std::size_t pos, const K& key) const {
+        return pos < keys.size() && !(key < keys.data()[pos]);
+    }
+
+public:
+    FlatMap() : frozen(false) {}
+
+    void insert(const K& key, const V& val) {
+        std::size_t pos = lowerBound(key);
+        if (found(pos, key)) {
+            vals[pos] = val; // update
+            return;
+        }
+        if (frozen) {
+            index.clear();
+            frozen = false;
+        }
+        keys.insert(pos, key);
+        vals.insert(pos, val);
+    }
+
+    bool contains(const K& key) const {
+        return found(lowerBound(key), key);
+    }
+
+    V get(const K& key) const {
+        std::size_t pos = lowerBound(key);
+        if (!found(pos, key)) throw std::out_of_range("Key not found in FlatMap");
+        return vals.data()[pos];
+    }
+
+    // Sorts the (key, value) batch and merges it with keys/vals in one
+    // linear pass: O(m log m + n) instead of m shifting inserts
+    template<typename It>
+    void insert_bulk(It first, It last, DuplicatePolicy policy = DuplicatePolicy::KeepLast) {
+        std::vector<std::pair<K, V>> batch(first, last);
+        std::stable_sort(batch.begin(), batch.end(),
+                         [](const std::pair<K, V>& a, const std::pair<K, V>& b) { return a.first < b.first; });
+        Vector<K> newKeys(keys.size() + batch.size());
+        Vector<V> newVals(keys.size() + batch.size());
+        const K* oldK = keys.data();
+        const V* oldV = vals.data();
+        std::size_t i = 0, n = keys.size();
+        for (std::size_t j = 0; j < batch.size(); ) {
+            std::size_t run = j + 1;   // [j, run) share a key
+            while (run < batch.size() && !(batch[j].first < batch[run].first)) run++;
+            while (i < n && oldK[i] < batch[j].first) {
+                newKeys.push_back(oldK[i]);
+                newVals.push_back(oldV[i++]);
+            }
+            bool present = (i < n && !(batch[j].first < oldK[i]));
+            if (policy == DuplicatePolicy::Throw && (present || run - j > 1)) {
+                throw std::invalid_argument("FlatMap insert_bulk: duplicate key");
+            }
+            if (present && policy == DuplicatePolicy::KeepFirst) {
+                newKeys.push_back(oldK[i]);
+                newVals.push_back(oldV[i]);
+            } else {
+                const std::pair<K, V>& pick = (policy == DuplicatePolicy::KeepFirst) ? batch[j] : batch[run - 1];
+                newKeys.push_back(pick.first);
+                newVals.push_back(pick.second);
+            }
+            if (present) i++;
+            j = run;
+        }
+        for (; i < n; i++) {
+            newKeys.push_back(oldK[i]);
+            newVals.push_back(oldV[i]);
+        }
+        keys = std::move(newKeys);
+        vals = std::move(newVals);
+        index.clear();
+        frozen = false;
+    }
+
+    // Looks up count keys with interleaved, prefetched searches. With
+    // 'foundOut' given, missing keys set foundOut[i] = false and leave out[i]
+    // alone; without it a missing key throws like get().
+    void get_many(const K* query, std::size_t count, V* out, bool* foundOut = nullptr) const {
+        std::vector<std::size_t> pos(count);
+        if (frozen) index.lowerBoundMany(query, count, pos.data());
+        else SortedSearch::lowerBoundMany(keys.data(), keys.size(), query, count, pos.data());
+        for (std::size_t i = 0; i < count; i++) {
+            bool hit = found(pos[i], query[i]);
+            if (foundOut) foundOut[i] = hit;
+            else if (!hit) throw std::out_of_range("Key not found in FlatMap");
+            if (hit) out[i] = vals.data()[pos[i]];
+        }
+    }
+
+    std::vector<V> get_many(const std::vector<K>& query) const {
+        std::vector<V> out(query.size());
+        get_many(query.data(), query.size(), out.data());
+        return out;
+    }
+
+    void freeze() {
+        index.build(keys.data(), keys.size());
+        frozen = true;
+    }
+    bool isFrozen() const { return frozen; }
+    std::size_t size() const { return keys.size(); }
+
+    void print() {
+        std::cout << "FlatMap: ";
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            std::cout << "(" << keys[i] << "->" << vals[i] << ")";
+            if (i < keys.size()-1) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+};
+
+//===================================================
+// Templated Set (sorted array or hash table)
+//===================================================
+// SetPolicy::Sorted keeps the elements in one sorted Vector. Lookups are
+// binary searches, a bulk build is a sort, and the set algebra runs as
+// linear merges, which suits posting-list style queries over large ID sets.
+// SetPolicy::Hashed stores the elements in an UnorderedMap, for O(1)
+// add/remove/contains when order does not matter.
+enum class SetPolicy { Sorted, Hashed };
+
+//---------------------------------------------------
+// SortedSetOps - set algebra on strictly increasing arrays
+// Results are appended to 'out' (anything with push_back). intersect and
+// difference gallop through the larger input when the sizes differ by
+// GALLOP_RATIO or more, so the cost grows with the smaller side. Otherwise
+// intersect compares whole blocks of 32/64-bit integers with SIMD: every
+// lane of an a-block is compared against every lane of a b-block, and
+// then whichever block has the smaller maximum is replaced.
+struct SortedSetOps {
+    static const std::size_t GALLOP_RATIO = 32;
+
+    // First index in [from, n) with a[index] >= v, probing 1, 2, 4, ... ahead
+    template<typename T>
+    static std::size_t gallop(const T* a, std::size_t n, std::size_t from, const T& v) {
+        std::size_t step = 1;
+        while (from + step < n && a[from + step] < v) {
+            from += step;
+            step *= 2;
+        }
+        std::size_t hi = (from + step < n) ? from + step + 1 : n;
+        return from + SortedSearch::lowerBound(a + from, hi - from, v);
+    }
+
+    // Bit i of mask(a, b) is set if a[i] equals any of b[0, WIDTH)
+    template<typename T, std::size_t BYTES>
+    struct BlockMatch {
+        static const std::size_t WIDTH = 0;   // no SIMD kernel for this type
+        static unsigned mask(const T*, const T*) { return 0; }
+    };
+
+    template<typename T, typename Out>
+    static void intersect(const T* a, std::size_t na, const T* b, std::size_t nb, Out& out) {
+        if (na > nb) {
+            std::swap(a, b);
+            std::swap(na, nb);
+        }
+        std::size_t i = 0, j = 0;
+        if (na && nb / na >= GALLOP_RATIO) {
+            for (; i < na; i++) {
+                j = gallop(b, nb, j, a[i]);
+                if (j == nb) return;
+                if (!(a[i] < b[j])) out.push_back(a[i]);
+            }
+            return;
+        }
+        typedef BlockMatch<T, std::is_integral<T>::value ? sizeof(T) : 0> Match;
+        const std::size_t W = Match::WIDTH;
+        while (W && i + W <= na && j + W <= nb) {
+            unsigned m = Match::mask(a + i, b + j);
+            while (m) {
+                out.push_back(a[i + countTrailingZeros(m)]);
+                m &= m - 1;
+            }
+            T amax = a[i + W - 1], bmax = b[j + W - 1];
+            if (!(bmax < amax)) i += W;
+            if (!(amax < bmax)) j += W;
+        }
+        while (i < na && j < nb) {
+            if (a[i] < b[j]) i++;
+            else if (b[j] < a[i]) j++;
+            else {
+                out.push_back(a[i++]);
+                j++;
+            }
+        }
+    }
+
+    template<typename T, typename Out>
+    static void unite(const T* a, std::size_t na, const T* b, std::size_t nb, Out& out) {
+        std::size_t i = 0, j = 0;
+        while (i < na && j < nb) {
+            if (a[i] < b[j]) out.push_back(a[i++]);
+            else if (b[j] < a[i]) out.push_back(b[j++]);
+            else {
+                out.push_back(a[i++]);
+                j++;
+            }
+        }
+        while (i < na) out.push_back(a[i++]);
+        while (j < nb) out.push_back(b[j++]);
+    }
+
+    // a minus b
+    template<typename T, typename Out>
+    static void difference(const T* a, std::size_t na, const T* b, std::size_t nb, Out& out) {
+        std::size_t i = 0, j = 0;
+        if (na && nb / na >= GALLOP_RATIO) {   // few a: look each one up in b
+            for (; i < na; i++) {
+                j = gallop(b, nb, j, a[i]);
+                if (j == nb || a[i] < b[j]) out.push_back(a[i]);
+            }
+            return;
+        }
+        if (nb && na / nb >= GALLOP_RATIO) {   // few b: copy the runs of a between them
+            for (; j < nb; j++) {
+                std::size_t k = gallop(a, na, i, b[j]);
+                while (i < k) out.push_back(a[i++]);
+                if (i < na && !(b[j] < a[i])) i++;
+            }
+            while (i < na) out.push_back(a[i++]);
+            return;
+        }
+        while (i < na && j < nb) {
+            if (a[i] < b[j]) out.push_back(a[i++]);
+            else if (b[j] < a[i]) j++;
+            else {
+                i++;
+                j++;
+            }
+        }
+        while (i < na) out.push_back(a[i++]);
+    }
+
+    template<typename T, typename Out>
+    static void symmetricDifference(const T* a, std::size_t na, const T* b, std::size_t nb, Out& out) {
+        std::size_t i = 0, j = 0;
+        while (i < na && j < nb) {
+            if (a[i] < b[j]) out.push_back(a[i++]);
+            else if (b[j] < a[i]) out.push_back(b[j++]);
+            else {
+                i++;
+                j++;
+            }
+        }
+        while (i < na) out.push_back(a[i++]);
+        while (j < nb) out.push_back(b[j++]);
+    }
+};
+
+#if defined(__AVX2__)
+template<typename T>
+struct SortedSetOps::BlockMatch<T, 4> {
+    static const std::size_t WIDTH = 8;
+    static unsigned mask(const T* a, const T* b) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        const __m256i rot = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+        __m256i m = _mm256_cmpeq_epi32(va, vb);
+        for (int r = 1; r < 8; r++) {
+            vb = _mm256_permutevar8x32_epi32(vb, rot);
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi32(va, vb));
+        }
+        return static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+    }
+};
+
+template<typename T>
+struct SortedSetOps::BlockMatch<T, 8> {
+    static const std::size_t WIDTH = 4;
+    static unsigned mask(const T* a, const T* b) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        __m256i m = _mm256_cmpeq_epi64(va, vb);
+        for (int r = 1; r < 4; r++) {
+            vb = _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi64(va, vb));
+        }
+        return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+    }
+};
+#elif defined(__SSE2__)
+template<typename T>
+struct SortedSetOps::BlockMatch<T, 4> {
+    static const std::size_t WIDTH = 4;
+    static unsigned mask(const T* a, const T* b) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        __m128i m = _mm_cmpeq_epi32(va, vb);
+        for (int r = 1; r < 4; r++) {
+            vb = _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1));
+            m = _mm_or_si128(m, _mm_cmpeq_epi32(va, vb));
+        }
+        return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(m)));
+    }
+};
+#endif
+
+template<typename T, SetPolicy P = SetPolicy::Sorted>
+class Set;
+
+//---------------------------------------------------
+// Set<T, SetPolicy::Sorted>
+// add/remove shift the tail, so build large sets with the range
+// constructor or add_bulk (one sort plus one merge) instead.
+template<typename T>
+class Set<T, SetPolicy::Sorted> {
+private:
+    Vector<T> elems;   // strictly increasing
+
+    std::size_t lowerBound(const T& val) const {
+        return SortedSearch::lowerBound(elems.data(), elems.size(), val);
+    }
+
+    // Sorts v and drops repeated values
+    static void sortUnique(Vector<T>& v) {
+        std::sort(v.begin(), v.end());
+        std::size_t n = std::unique(v.begin(), v.end(), [](const T& x, const T& y) { return !(x < y) && !(y < x); })
+                        - v.begin();
+        v.erase(n, v.size());
+    }
+
+public:
+    Set() {}
+    Set(std::initializer_list<T> init_list) : Set(init_list.begin(), init_list.end()) {}
+
+    template<typename It>
+    Set(It first, It last) {
+        for (; first != last; ++first) elems.push_back(*first);
+        sortUnique(elems);
+    }
+
+    void add(const T& val) {
+        std::size_t pos = lowerBound(val);
+        if (pos < elems.size() && !(val < elems.data()[pos])) return;
+        elems.insert(pos, val);
+    }
+
+    // Adds a batch of values in O(m log m + n)
+    template<typename It>
+    void add_bulk(It first, It last) {
+        Vector<T> batch;
+        for (; first != last; ++first) batch.push_back(*first);
+        sortUnique(batch);
+        Vector<T> merged(elems.size() + batch.size());
+        SortedSetOps::unite(elems.data(), elems.size(), batch.data(), batch.size(), merged);
+        elems = std::move(merged);
+    }
+
+    void remove(const T& val) {
+        std::size_t pos = lowerBound(val);
+        if (pos < elems.size() && !(val < elems.data()[pos])) elems.erase(pos);
+    }
+
+    bool contains(const T& val) const {
+        std::size_t pos = lowerBound(val);
+        return pos < elems.size() && !(val < elems.data()[pos]);
+    }
+
+    std::size_t size() const { return elems.size(); }
+    bool empty() const { return elems.empty(); }
+    void clear() { elems.clear(); }
+
+    const T* data() const { return elems.data(); }
+    const T* begin() const { return elems.begin(); }
+    const T* end() const { return elems.end(); }
+
+    template<typename Fn>
+    void forEach(Fn fn) const {
+        for (const T& v : elems) fn(v);
+    }
+
+    Set unite(const Set& other) const {
+        Set r;
+        r.elems.reserve(size() + other.size());
+        SortedSetOps::unite(data(), size(), other.data(), other.size(), r.elems);
+        return r;
+    }
+
+    Set intersect(const Set& other) const {
+        Set r;
+        r.elems.reserve(std::min(size(), other.size()));
+        SortedSetOps::intersect(data(), size(), other.data(), other.size(), r.elems);
+        return r;
+    }
+
+    Set difference(const Set& other) const {
+        Set r;
+        r.elems.reserve(size());
+        SortedSetOps::difference(data(), size(), other.data(), other.size(), r.elems);
+        return r;
+    }
+
+    Set symmetric_difference(const Set& other) const {
+        Set r;
+        r.elems.reserve(size() + other.size());
+        SortedSetOps::symmetricDifference(data(), size(), other.data(), other.size(), r.elems);
+        return r;
+    }
+
+    void print() {
+        std::cout << "Set: ";
+        for (std::size_t i = 0; i < elems.size(); i++) {
+            std::cout << elems[i];
+            if (i < elems.size() - 1) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+};
+
+//---------------------------------------------------
+// Set<T, SetPolicy::Hashed>
+// The set operations walk the smaller operand and probe the larger one.
+template<typename T>
+class Set<T, SetPolicy::Hashed> {
+private:
+    UnorderedMap<T, bool> table;   // the mapped value is unused
+
+    const Set& smaller(const Set& other) const { return size() <= other.size() ? *this : other; }
+    const Set& larger(const Set& other) const { return size() <= other.size() ? other : *this; }
+
+public:
+    Set() {}
+    Set(std::initializer_list<T> init_list) : Set(init_list.begin(), init_list.end()) {}
+
+    template<typename It>
+    Set(It first, It last) {
+        for (; first != last; ++first) add(*first);
+    }
+
+    Set(const Set& orig) {
+        table.reserve(orig.size());
+        orig.forEach([this](const T& v) { add(v); });
+    }
+
+    Set(Set&& orig) noexcept : table(std::move(orig.table)) {}
+
+    Set& operator=(Set orig) {
+        table = std::move(orig.table);
+        return *this;
+    }
+
+    void add(const T& val) { table.insert(val, true); }
+
+    template<typename It>
+    void add_bulk(It first, It last) {
+        for (; first != last; ++first) add(*first);
+    }
+
+    void remove(const T& val) { table.remove(val); }
+    bool contains(const T& val) const { return table.contains(val); }
+
+    std::size_t size() const { return table.size(); }
+    bool empty() const { return table.empty(); }
+    void clear() { table = UnorderedMap<T, bool>(); }
+
+    template<typename Fn>
+    void forEach(Fn fn) const {
+        table.forEach([&fn](const T& v, bool) { fn(v); });
+    }
+
+    Set unite(const Set& other) const {
+        Set r(larger(other));
+        smaller(other).forEach([&r](const T& v) { r.add(v); });
+        return r;
+    }
+
+    Set intersect(const Set& other) const {
+        const Set& big = larger(other);
+        Set r;
+        smaller(other).forEach([&](const T& v) {
+            if (big.contains(v)) r.add(v);
+        });
+        return r;
+    }
+
+    Set difference(const Set& other) const {
+        Set r;
+        forEach([&](const T& v) {
+            if (!other.contains(v)) r.add(v);
+        });
+        return r;
+    }
+
+    Set symmetric_difference(const Set& other) const {
+        Set r = difference(other);
+        other.forEach([&](const T& v) {
+            if (!contains(v)) r.add(v);
+        });
+        return r;
+    }
+
+    void print() {
+        std::cout << "Set (hashed): ";
+        std::size_t printed = 0;
+        forEach([&](const T& v) {
+            std::cout << v;
+            if (++printed < size()) std::cout << ", ";
+        });
+        std::cout << std::endl;
+    }
+};
+
+//---------------------------------------------------
+// InplaceVector<T, CAP>
+// Fixed capacity, no heap. The slots are raw storage, so only the
+// elements actually pushed are ever constructed.
+template<typename T, std::size_t CAP>
+class InplaceVector {
+private:
+    alignas(T) unsigned char storage[CAP * sizeof(T)];
+    std::size_t length;
+
+    T* arr() { return reinterpret_cast<T*>(storage); }
+    const T* arr() const { return reinterpret_cast<const T*>(storage); }
+
+public:
+    InplaceVector() : length(0) {}
+
+    InplaceVector(const InplaceVector& orig) : length(0) {
+        for (; length < orig.length; length++) new (arr() + length) T(orig.arr()[length]);
+    }
+
+    InplaceVector& operator=(const InplaceVector& orig) {
+        if (this != &orig) {
+            clear();
+            for (; length < orig.length; length++) new (arr() + length) T(orig.arr()[length]);
+        }
+        return *this;
+    }
+
+    ~InplaceVector() { clear(); }
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (length >= CAP) throw std::overflow_error("InplaceVector full");
+        new (arr() + length) T(std::forward<Args>(args)...);
+        return arr()[length++];
+    }
+    void push_back(const T& val) { emplace_back(val); }
+    T pop_back() {
+        if (length == 0) throw std::underflow_error("InplaceVector empty");
+        T val = std::move(arr()[--length]);
+        arr()[length].~T();
+        return val;
+    }
+    T& operator[](std::size_t idx) {
+        if (idx >= length) throw std::out_of_range("InplaceVector index out of range");
+        return arr()[idx];
+    }
+    std::size_t size() const { return length; }
+
+    void clear() {
+        while (length) arr()[--length].~T();
+    }
+
+    void print() {
+        std::cout << "InplaceVector: ";
+        for (std::size_t i = 0; i < length; i++) {
+            std::cout << arr()[i];
+            if (i < length - 1) std::cout << ", ";
+        }
+        std::cout << std::endl;
+    }
+};
+
+//===================================================
+// Extents and layout policies for MdSpan
+//===================================================
+// Extents<E...> gives the size of each dimension. A number fixes it at
+// compile time; dynamic_extent leaves it to the constructor. A layout
+// policy's mapping turns a multi-index into an offset from the data pointer:
+//  - LayoutRight:  row-major (last index fastest), any rank
+//  - LayoutLeft:   column-major (first index fastest), any rank
+//  - LayoutStride: offset = sum(index[r] * stride[r]), any rank
+//  - LayoutTiled:  rank 2, row-major tiles of tileRows x tileCols, each
+//                  tile row-major, edge tiles padded (MappedMatrix's layout)
+//  - LayoutMorton: rank 2, Z-order, the bits of i and j interleaved
+// The first three are STRIDED, so a sub-block of them is itself a
+// LayoutStride view of the same memory; see MdSpan::submdspan.
+static constexpr std::size_t dynamic_extent = std::size_t(-1);
+
+template<std::size_t... E>
+class Extents {
+public:
+    static constexpr std::size_t RANK = sizeof...(E);
+    static_assert(RANK > 0, "Extents needs at least one dimension");
+
+private:
+    static constexpr std::size_t STATIC[RANK] = {E...};
+    std::size_t ext[RANK];
+
+    static constexpr std::size_t countDynamic() {
+        std::size_t n = 0;
+        for (std::size_t r = 0; r < RANK; r++) n += (STATIC[r] == dynamic_extent);
+        return n;
+    }
+
+public:
+    // Takes the dynamic extents only, in order
+    template<typename... D>
+    explicit Extents(D... dynExts) {
+        static_assert(sizeof...(D) == countDynamic(), "Extents: pass one size per dynamic extent");
+        std::size_t given[sizeof...(D) + 1] = {static_cast<std::size_t>(dynExts)...};
+        for (std::size_t r = 0, d = 0; r < RANK; r++) ext[r] = (STATIC[r] == dynamic_extent) ? given[d++] : STATIC[r];
+    }
+
+    // Takes every extent; static ones must match
+    explicit Extents(const std::array<std::size_t, RANK>& all) {
+        for (std::size_t r = 0; r < RANK; r++) {
+            if (STATIC[r] != dynamic_extent && STATIC[r] != all[r]) throw std::invalid_argument("Extents: static extent mismatch");
+            ext[r] = all[r];
+        }
+    }
+
+    static constexpr std::size_t rank() { return RANK; }
+    static constexpr std::size_t rank_dynamic() { return countDynamic(); }
+    static constexpr std::size_t static_extent(std::size_t r) { return STATIC[r]; }
+    std::size_t extent(std::size_t r) const { return STATIC[r] != dynamic_extent ? STATIC[r] : ext[r]; }
+
+    std::size_t size() const {
+        std::size_t n = 1;
+        for (std::size_t r = 0; r < RANK; r++) n *= extent(r);
+        return n;
+    }
+};
+
+template<typename Seq> struct DynamicExtentsOf;
+template<std::size_t... I>
+struct DynamicExtentsOf<std::index_sequence<I...>> {
+    typedef Extents<((void)I, dynamic_extent)...> type;
+};
+// Extents<dynamic_extent, ...> of rank R
+template<std::size_t R>
+using DynamicExtents = typename DynamicExtentsOf<std::make_index_sequence<R>>::type;
+
+struct LayoutRight {
+    template<typename Ext>
+    class mapping {
+    private:
+        Ext ext;
+
+    public:
+        static const bool STRIDED = true;
+        static const bool ROW_MAJOR_CONTIGUOUS = true;
+
+        explicit mapping(const Ext& e) : ext(e) {}
+        const Ext& extents() const { return ext; }
+
+        template<typename... I>
+        std::size_t operator()(I... idx) const {
+            std::size_t is[] = {static_cast<std::size_t>(idx)...};
+            std::size_t off = 0;
+            for (std::size_t r = 0; r < Ext::RANK; r++) off = off * ext.extent(r) + is[r];
+            return off;
+        }
+        std::size_t stride(std::size_t r) const {
+            std::size_t s = 1;
+            for (std::size_t k = r + 1; k < Ext::RANK; k++) s *= ext.extent(k);
+            return s;
+        }
+        std::size_t required_span_size() const { return ext.size(); }
+    };
+};
+
+struct LayoutLeft {
+    template<typename Ext>
+    class mapping {
+    private:
+        Ext ext;
+
+    public:
+        static const bool STRIDED = true;
+        static const bool ROW_MAJOR_CONTIGUOUS = false;
+
+        explicit mapping(const Ext& e) : ext(e) {}
+        const Ext& extents() const { return ext; }
+
+        template<typename... I>
+        std::size_t operator()(I... idx) const {
+            std::size_t is[] = {static_cast<std::size_t>(idx)...};
+            std::size_t off = 0;
+            for (std::size_t r = Ext::RANK; r-- > 0; ) off = off * ext.extent(r) + is[r];
+            return off;
+        }
+        std::size_t stride(std::size_t r) const {
+            std::size_t s = 1;
+            for (std::size_t k = 0; k < r; k++) s *= ext.extent(k);
+            return s;
+        }
+        std::size_t required_span_size() const { return ext.size(); }
+    };
+};
+
+struct LayoutStride {
+    template<typename Ext>
+    class mapping {
+    private:
+        Ext ext;
+        std::array<std::size_t, Ext::RANK> strides;
+
+    public:
+        static const bool STRIDED = true;
+        static const bool ROW_MAJOR_CONTIGUOUS = false;
+
+        // Row-major strides by default
+        explicit mapping(const Ext& e) : ext(e) {
+            std::size_t s = 1;
+            for (std::size_t r = Ext::RANK; r-- > 0; ) {
+                strides[r] = s;
+                s *= ext.extent(r);
+            }
+        }
+        mapping(const Ext& e, const std::array<std::size_t, Ext::RANK>& st) : ext(e), strides(st) {}
+        const Ext& extents() const { return ext; }
+
+        template<typename... I>
+        std::size_t operator()(I... idx) const {
+            std::size_t is[] = {static_cast<std::size_t>(idx)...};
+            std::size_t off = 0;
+            for (std::size_t r = 0; r < Ext::RANK; r++) off += is[r] * strides[r];
+            return off;
+        }
+        std::size_t stride(std::size_t r) const { return strides[r]; }
+        std::size_t required_span_size() const {
+            if (!ext.size()) return 0;
+            std::size_t last = 0;
+            for (std::size_t r = 0; r < Ext::RANK; r++) last += (ext.extent(r) - 1) * strides[r];
+            return last + 1;
+        }
+    };
+};
+
+struct LayoutTiled {
+    template<typename Ext>
+    class mapping {
+        static_assert(Ext::RANK == 2, "LayoutTiled is two-dimensional");
+
+    private:
+        Ext ext;
+        std::size_t tr;
+        std::size_t tc;
+        std::size_t tilesAcross;
+
+    public:
+        static const bool STRIDED = false;
+        static const bool ROW_MAJOR_CONTIGUOUS = false;
+
+        mapping(const Ext& e, std::size_t tileRows, std::size_t tileCols)
+        : ext(e), tr(tileRows), tc(tileCols), tilesAcross((e.extent(1) + tileCols - 1) / tileCols) {
+            if (!tileRows || !tileCols) throw std::invalid_argument("LayoutTiled: tile size must be non-zero");
+        }
+        const Ext& extents() const { return ext; }
+        std::size_t tileRows() const { return tr; }
+        std::size_t tileCols() const { return tc; }
+
+        std::size_t operator()(std::size_t i, std::size_t j) const {
+            return ((i / tr) * tilesAcross + j / tc) * tr * tc + (i % tr) * tc + j % tc;
+        }
+        std::size_t required_span_size() const {
+            return ((ext.extent(0) + tr - 1) / tr) * tilesAcross * tr * tc;
+        }
+    };
+};
+
+struct LayoutMorton {
+    // Spreads the low 32 bits of x to the even bit positions
+    static std::size_t spread(std::size_t x) {
+        unsigned long long v = x & 0xFFFFFFFFULL;
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+        v = (v | (v << 8))  & 0x00FF00FF00FF00FFULL;
+        v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+        v = (v | (v << 2))  & 0x3333333333333333ULL;
+        v = (v | (v << 1))  & 0x5555555555555555ULL;
+        return static_cast<std::size_t>(v);
+    }
+
+    template<typename Ext>
+    class mapping {
+        static_assert(Ext::RANK == 2, "LayoutMorton is two-dimensional");
+
+    private:
+        Ext ext;
+
+    public:
+        static const bool STRIDED = false;
+        static const bool ROW_MAJOR_CONTIGUOUS = false;
+
+        explicit mapping(const Ext& e) : ext(e) {}
+        const Ext& extents() const { return ext; }
+
+        std::size_t operator()(std::size_t i, std::size_t j) const { return (spread(i) << 1) | spread(j); }
+        // Z-order is monotonic in i and in j, so the last element sits highest
+        std::size_t required_span_size() const {
+            if (!ext.size()) return 0;
+            return (*this)(ext.extent(0) - 1, ext.extent(1) - 1) + 1;
+        }
+    };
+};
+
+//---------------------------------------------------
+// MdSpan<T, Layout, Ext> - non-owning multi-dimensional view
+// MdSpan<T> is the original dense row-major 2-D view. Any layout and rank
+// work for indexing; the matrix parts (rows/cols, expression templates,
+// print) need rank 2. operator() checks bounds; at_unchecked() does not,
+// so it is the one to use in hot loops.
+template<typename T, typename Layout = LayoutRight, typename Ext = Extents<dynamic_extent, dynamic_extent>>
+class MdSpan : public MatExpr<MdSpan<T, Layout, Ext>> {
+public:
+    typedef T value_type;
+    typedef Ext extents_type;
+    typedef typename Layout::template mapping<Ext> mapping_type;
+    static const bool IS_LEAF = true;
+
+private:
+    T* ptr;
+    mapping_type map;
+
+    template<typename... I>
+    bool inBounds(I... idx) const {
+        std::size_t is[] = {static_cast<std::size_t>(idx)...};
+        for (std::size_t r = 0; r < Ext::RANK; r++) {
+            if (is[r] >= map.extents().extent(r)) return false;
         }
+        return true;
     }
 
-    Matrix(const Matrix &orig) : m_(orig.m_), n_(orig.n_) {
-        data_ = new T[m_ * n_];
-        for (std::size_t i = 0; i < m_ * n_; i++) {
-            data_[i] = orig.data_[i];
+public:
+    // Dynamic extents only, e.g. MdSpan<double>(p, rows, cols)
+    template<typename... D>
+    explicit MdSpan(T* p, D... dynExts) : ptr(p), map(Ext(dynExts...)) {}
+
+    MdSpan(T* p, const mapping_type& m) : ptr(p), map(m) {}
+
+    // Copying a view makes another view of the same elements, but assigning
+    // one view to another copies the elements, as expression assignment does
+    MdSpan(const MdSpan&) = default;
+    MdSpan& operator=(const MdSpan& other) {
+        return *this = static_cast<const MatExpr<MdSpan>&>(other);
+    }
+
+    // Writes an element-wise expression into the viewed elements
+    template<typename E>
+    MdSpan& operator=(const MatExpr<E>& expr) {
+        const E& e = expr.self();
+        if (e.rows() != rows() || e.cols() != cols()) throw std::invalid_argument("MdSpan dimensions do not match");
+        if (mapping_type::ROW_MAJOR_CONTIGUOUS) {
+            for (std::size_t i = 0; i < rows() * cols(); i++) ptr[i] = e.flat(i);
+        } else {
+            for (std::size_t i = 0; i < rows(); i++) {
+                for (std::size_t j = 0; j < cols(); j++) ptr[map(i, j)] = e.flat(i * cols() + j);
+            }
         }
+        return *this;
     }
 
-    ~Matrix() {
-        delete[] data_;
-        data_ = nullptr;
+    std::size_t rows() const {
+        static_assert(Ext::RANK == 2, "rows() needs a 2-D MdSpan");
+        return map.extents().extent(0);
+    }
+    std::size_t cols() const {
+        static_assert(Ext::RANK == 2, "cols() needs a 2-D MdSpan");
+        return map.extents().extent(1);
+    }
+    // Element i in row-major order, whatever the layout
+    T flat(std::size_t i) const {
+        if (mapping_type::ROW_MAJOR_CONTIGUOUS) return ptr[i];
+        return ptr[map(i / cols(), i % cols())];
     }
 
-    T &operator()(std::size_t r, std::size_t c) {
-        if (r >= m_ || c >= n_) throw std::out_of_range("Matrix index out of range");
-        return data_[r * n_ + c];
+    static constexpr std::size_t rank() { return Ext::RANK; }
+    std::size_t extent(std::size_t r) const { return map.extents().extent(r); }
+    std::size_t size() const { return map.extents().size(); }
+    std::size_t stride(std::size_t r) const { return map.stride(r); }
+    const mapping_type& mapping() const { return map; }
+    T* data() const { return ptr; }
+
+    template<typename... I>
+    T& operator()(I... idx) const {
+        static_assert(sizeof...(I) == Ext::RANK, "MdSpan: one index per dimension");
+        if (!inBounds(idx...)) throw std::out_of_range("MdSpan index out of range");
+        return ptr[map(idx...)];
     }
 
-    Matrix &operator*=(const T& scalar) {
-        for (std::size_t i = 0; i < m_ * n_; i++) {
-            data_[i] *= scalar;
+    template<typename... I>
+    T& at_unchecked(I... idx) const { return ptr[map(idx...)]; }
+
+    // Zero-copy view of [first, second) in every dimension. The result
+    // addresses the same memory through strides, so any strided layout
+    // (right, left, stride) can be sliced; tiled and Morton cannot.
+    template<typename... Ranges>
+    MdSpan<T, LayoutStride, DynamicExtents<Ext::RANK>> submdspan(Ranges... ranges) const {
+        static_assert(sizeof...(Ranges) == Ext::RANK, "submdspan: one range per dimension");
+        static_assert(mapping_type::STRIDED, "submdspan needs a strided layout");
+        std::pair<std::size_t, std::size_t> rs[] = {std::pair<std::size_t, std::size_t>(ranges)...};
+        std::array<std::size_t, Ext::RANK> counts, strides;
+        std::size_t offset = 0;
+        bool empty = false;
+        for (std::size_t r = 0; r < Ext::RANK; r++) {
+            if (rs[r].first > rs[r].second || rs[r].second > extent(r)) throw std::out_of_range("submdspan range out of range");
+            counts[r] = rs[r].second - rs[r].first;
+            strides[r] = map.stride(r);
+            offset += rs[r].first * strides[r];
+            empty = empty || !counts[r];
         }
-        return *this;
+        typedef DynamicExtents<Ext::RANK> SubExt;
+        return MdSpan<T, LayoutStride, SubExt>(empty ? ptr : ptr + offset,
+                                               typename LayoutStride::template mapping<SubExt>(SubExt(counts), strides));
     }
 
     void print() {
-        std::cout << "Matrix " << m_ << "x" << n_ << ":\n";
-        for (std::size_t r = 0; r < m_; r++) {
-            for (std::size_t c = 0; c < n_; c++) {
-                std::cout << data_[r * n_ + c] << " ";
+        std::cout << "MdSpan " << rows() << "x" << cols() << ":\n";
+        for (std::size_t i = 0; i < rows(); i++) {
+            for (std::size_t j = 0; j < cols(); j++) {
+                std::cout << ptr[map(i, j)] << " ";
             }
             std::cout << std::endl;
         }
     }
-
-private:
-    std::size_t m_;
-    std::size_t n_;
-    T* data_;
 };
 
+#if BDS_HAVE_MMAP
 //===================================================
-// Templated Dynamic Array
+// MappedMatrix (file-backed, out-of-core storage)
 //===================================================
+// The matrix lives in a file that is mmap'd MAP_SHARED, so opening it
+// copies nothing and it can be larger than RAM. The page cache pages data
+// in and out. The file starts with a one-page header, then the elements
+// are stored as tileRows x tileCols tiles in row-major tile order, each tile
+// itself row-major. Edge tiles are padded to full size. A plain row-major
+// file is the special case of one-row-high, full-width tiles.
+// multiply() and transpose() stream the operands through small in-memory
+// blocks, so their working set stays a few blocks no matter the file size.
+enum class MapAdvice { Normal, Sequential, Random, WillNeed, DontNeed };
+
+struct MappedMatrixHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t elemSize;
+    std::uint64_t rows;
+    std::uint64_t cols;
+    std::uint64_t tileRows;
+    std::uint64_t tileCols;
+    std::uint64_t dataOffset;
+};
+
 template<typename T>
-class Array {
-public:
-    Array(std::size_t cap)
-    : cap_(cap) {
-        arr_ = new T[cap_];
-        for (std::size_t i = 0; i < cap_; i++) {
-            arr_[i] = T();
-        }
+class MappedMatrix {
+    static_assert(std::is_trivially_copyable<T>::value, "MappedMatrix stores raw element bytes");
+
+private:
+    static const std::uint32_t VERSION = 1;
+    static const std::size_t HEADER_BYTES = 4096;
+
+    int fd;
+    unsigned char* base;
+    std::size_t length;
+    bool writable;
+    std::size_t m_;
+    std::size_t n_;
+    std::size_t tr_;
+    std::size_t tc_;
+    std::size_t tilesAcross;
+
+    MappedMatrix() : fd(-1), base(nullptr), length(0), writable(false),
+                     m_(0), n_(0), tr_(1), tc_(1), tilesAcross(0) {}
+
+    static std::size_t checkedMul(std::size_t a, std::size_t b) {
+        if (b && a > std::numeric_limits<std::size_t>::max() / b) throw std::overflow_error("MappedMatrix size overflows");
+        return a * b;
     }
 
-    Array(const Array &orig) : cap_(orig.cap_) {
-        arr_ = new T[cap_];
-        for (std::size_t i = 0; i < cap_; i++) {
-            arr_[i] = orig.arr_[i];
-        }
+    // Header dimensions may come from an untrusted file, so every step is checked
+    static std::size_t fileBytes(std::size_t rows, std::size_t cols, std::size_t tr, std::size_t tc) {
+        std::size_t tiles = checkedMul(rows / tr + (rows % tr != 0), cols / tc + (cols % tc != 0));
+        std::size_t data = checkedMul(checkedMul(checkedMul(tiles, tr), tc), sizeof(T));
+        if (data > std::numeric_limits<std::size_t>::max() - HEADER_BYTES) throw std::overflow_error("MappedMatrix size overflows");
+        return HEADER_BYTES + data;
     }
 
-    ~Array() {
-        delete[] arr_;
-        arr_ = nullptr;
+    void mapFile(std::size_t bytes, bool rw) {
+        length = bytes;
+        writable = rw;
+        void* p = mmap(nullptr, length, rw ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) throw std::runtime_error("MappedMatrix mmap failed");
+        base = static_cast<unsigned char*>(p);
     }
 
-    void interpolate() {
-        std::size_t oldCap = cap_;
-        cap_ *= 2;
-        T *newArr = new T[cap_];
-        for (std::size_t i = 0; i < cap_; i++) {
-            newArr[i] = arr_[i / 2];
-        }
-        delete[] arr_;
-        arr_ = newArr;
+    void unmap() {
+        if (base) munmap(base, length);
+        if (fd >= 0) close(fd);
+        base = nullptr;
+        fd = -1;
     }
 
-    std::size_t capacity() const { return cap_; }
+    T* elems() const { return reinterpret_cast<T*>(base + HEADER_BYTES); }
 
-    void print() {
-        std::cout << "Array: ";
-        for (std::size_t i = 0; i < cap_; i++) {
-            std::cout << arr_[i];
-            if (i < cap_ - 1) std::cout << ", ";
-        }
-        std::cout << std::endl;
+    std::size_t offset(std::size_t i, std::size_t j) const {
+        return ((i / tr_) * tilesAcross + j / tc_) * tr_ * tc_ + (i % tr_) * tc_ + j % tc_;
     }
 
-private:
-    std::size_t cap_;
-    T* arr_;
-};
-
-//===================================================
-// Additional Minimal "Standard-Like" Containers
-//===================================================
+    void checkWritable() const {
+        if (!writable) throw std::logic_error("MappedMatrix is read-only");
+    }
 
-//---------------------------------------------------
-// Bitset<N>
-template<std::size_t N>
-class Bitset {
-private:
-    static const std::size_t BITS_PER_BLOCK = 8 * sizeof(unsigned long long);
-    unsigned long long block;
+    void checkBlock(std::size_t r0, std::size_t c0, std::size_t h, std::size_t w) const {
+        if (r0 + h > m_ || c0 + w > n_) throw std::out_of_range("MappedMatrix block out of range");
+    }
 
 public:
-    Bitset() : block(0ULL) {
-        static_assert(N <= BITS_PER_BLOCK, "Bitset dimension exceeds block size in this example.");
+    // Creates (or truncates) 'path'. A tile size of 0 means plain row-major.
+    static MappedMatrix create(const std::string& path, std::size_t rows, std::size_t cols,
+                               std::size_t tileRows = 0, std::size_t tileCols = 0) {
+        MappedMatrix res;
+        res.m_ = rows;
+        res.n_ = cols;
+        res.tr_ = tileRows ? tileRows : 1;
+        res.tc_ = tileCols ? tileCols : (cols ? cols : 1);
+        res.tilesAcross = (cols + res.tc_ - 1) / res.tc_;
+        res.fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (res.fd < 0) throw std::runtime_error("MappedMatrix cannot create " + path);
+        std::size_t bytes = fileBytes(rows, cols, res.tr_, res.tc_);
+        if (bytes > static_cast<std::size_t>(std::numeric_limits<off_t>::max())) {
+            throw std::overflow_error("MappedMatrix size overflows");
+        }
+        if (ftruncate(res.fd, static_cast<off_t>(bytes)) != 0) throw std::runtime_error("MappedMatrix cannot size " + path);
+        res.mapFile(bytes, true);
+        MappedMatrixHeader hdr = {};
+        std::memcpy(hdr.magic, "BDSMATRX", 8);
+        hdr.version = VERSION;
+        hdr.elemSize = sizeof(T);
+        hdr.rows = rows;
+        hdr.cols = cols;
+        hdr.tileRows = res.tr_;
+        hdr.tileCols = res.tc_;
+        hdr.dataOffset = HEADER_BYTES;
+        std::memcpy(res.base, &hdr, sizeof(hdr));
+        return res;
     }
-    void set(std::size_t pos) {
-        if (pos >= N) throw std::out_of_range("Bitset index out of range");
-        block |= (1ULL << pos);
+
+    // Maps an existing file without reading it; only the header is checked
+    static MappedMatrix open(const std::string& path, bool writable = false) {
+        MappedMatrix res;
+        res.fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (res.fd < 0) throw std::runtime_error("MappedMatrix cannot open " + path);
+        struct stat st;
+        if (fstat(res.fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < HEADER_BYTES) {
+            throw std::runtime_error("MappedMatrix file too small: " + path);
+        }
+        res.mapFile(static_cast<std::size_t>(st.st_size), writable);
+        MappedMatrixHeader hdr;
+        std::memcpy(&hdr, res.base, sizeof(hdr));
+        if (std::memcmp(hdr.magic, "BDSMATRX", 8) != 0 || hdr.version != VERSION) {
+            throw std::runtime_error("MappedMatrix bad header: " + path);
+        }
+        if (hdr.elemSize != sizeof(T) || hdr.dataOffset != HEADER_BYTES || !hdr.tileRows || !hdr.tileCols) {
+            throw std::runtime_error("MappedMatrix element type or layout mismatch: " + path);
+        }
+        res.m_ = hdr.rows;
+        res.n_ = hdr.cols;
+        res.tr_ = hdr.tileRows;
+        res.tc_ = hdr.tileCols;
+        res.tilesAcross = (res.n_ + res.tc_ - 1) / res.tc_;
+        if (res.length < fileBytes(res.m_, res.n_, res.tr_, res.tc_)) {
+            throw std::runtime_error("MappedMatrix file truncated: " + path);
+        }
+        return res;
     }
-    void reset(std::size_t pos) {
-        if (pos >= N) throw std::out_of_range("Bitset index out of range");
-        block &= ~(1ULL << pos);
+
+    static MappedMatrix save(const std::string& path, const Matrix<T>& src,
+                             std::size_t tileRows = 0, std::size_t tileCols = 0) {
+        MappedMatrix res = create(path, src.rows(), src.cols(), tileRows, tileCols);
+        res.writeBlock(0, 0, src.rows(), src.cols(), src.data(), src.cols());
+        return res;
     }
-    bool test(std::size_t pos) const {
-        if (pos >= N) throw std::out_of_range("Bitset index out of range");
-        return (block & (1ULL << pos)) != 0ULL;
+
+    MappedMatrix(const MappedMatrix&) = delete;
+    MappedMatrix& operator=(const MappedMatrix&) = delete;
+
+    MappedMatrix(MappedMatrix&& orig) noexcept
+    : fd(orig.fd), base(orig.base), length(orig.length), writable(orig.writable),
+      m_(orig.m_), n_(orig.n_), tr_(orig.tr_), tc_(orig.tc_), tilesAcross(orig.tilesAcross) {
+        orig.fd = -1;
+        orig.base = nullptr;
     }
-    void print() {
-        std::cout << "Bitset<" << N << ">: ";
-        for (std::size_t i = 0; i < N; i++) {
-            std::cout << (test(i) ? 1 : 0);
+
+    MappedMatrix& operator=(MappedMatrix&& orig) noexcept {
+        if (this != &orig) {
+            unmap();
+            fd = orig.fd;
+            base = orig.base;
+            length = orig.length;
+            writable = orig.writable;
+            m_ = orig.m_;
+            n_ = orig.n_;
+            tr_ = orig.tr_;
+            tc_ = orig.tc_;
+            tilesAcross = orig.tilesAcross;
+            orig.fd = -1;
+            orig.base = nullptr;
         }
-        std::cout << std::endl;
+        return *this;
     }
-};
 
-//---------------------------------------------------
-// Deque<T> - ring buffer
-template<typename T>
-class Deque {
-private:
-    T* data;
-    std::size_t capacity;
-    std::size_t frontIdx;
-    std::size_t backIdx;
-    std::size_t count;
+    ~MappedMatrix() { unmap(); }
 
-public:
-    Deque(std::size_t cap = 16)
-    : capacity(cap), frontIdx(0), backIdx(0), count(0) {
-        data = new T[capacity];
+    std::size_t rows() const { return m_; }
+    std::size_t cols() const { return n_; }
+    std::size_t tileRows() const { return tr_; }
+    std::size_t tileCols() const { return tc_; }
+    bool isRowMajor() const { return tc_ == n_; }
+
+    // A read-only mapping hands out references only through the const overload
+    T& operator()(std::size_t i, std::size_t j) {
+        checkWritable();
+        if (i >= m_ || j >= n_) throw std::out_of_range("MappedMatrix index out of range");
+        return elems()[offset(i, j)];
+    }
+    const T& operator()(std::size_t i, std::size_t j) const {
+        if (i >= m_ || j >= n_) throw std::out_of_range("MappedMatrix index out of range");
+        return elems()[offset(i, j)];
     }
-    ~Deque() { delete[] data; }
 
-    bool empty() const { return count == 0; }
-    std::size_t size() const { return count; }
+    // Zero-copy view of the whole matrix; only a row-major file is one
+    MdSpan<T> view() {
+        checkWritable();
+        if (!isRowMajor()) throw std::invalid_argument("MappedMatrix view needs a row-major layout");
+        return MdSpan<T>(elems(), m_, n_);
+    }
 
-    void push_back(const T& val) {
-        if (count == capacity) throw std::overflow_error("Deque is full");
-        data[backIdx] = val;
-        backIdx = (backIdx + 1) % capacity;
-        count++;
+    // Zero-copy view of the whole matrix in its tiled layout
+    MdSpan<T, LayoutTiled> tiledView() {
+        checkWritable();
+        typedef Extents<dynamic_extent, dynamic_extent> Ext2;
+        return MdSpan<T, LayoutTiled>(elems(), LayoutTiled::mapping<Ext2>(Ext2(m_, n_), tr_, tc_));
     }
 
-    void push_front(const T& val) {
-        if (count == capacity) throw std::overflow_error("Deque is full");
-        frontIdx = (frontIdx == 0) ? capacity - 1 : frontIdx - 1;
-        data[frontIdx] = val;
-        count++;
+    // Zero-copy view of one tile, padding included
+    MdSpan<T> tile(std::size_t ti, std::size_t tj) {
+        checkWritable();
+        if (ti * tr_ >= m_ || tj >= tilesAcross) throw std::out_of_range("MappedMatrix tile out of range");
+        return MdSpan<T>(elems() + (ti * tilesAcross + tj) * tr_ * tc_, tr_, tc_);
     }
 
-    T pop_back() {
-        if (empty()) throw std::underflow_error("Deque is empty");
-        backIdx = (backIdx == 0) ? capacity - 1 : backIdx - 1;
-        T val = data[backIdx];
-        count--;
-        return val;
+    // Kernel paging hint for the tile rows covering [rowBegin, rowEnd)
+    void advise(MapAdvice hint, std::size_t rowBegin = 0, std::size_t rowEnd = std::size_t(-1)) {
+        if (rowEnd > m_) rowEnd = m_;
+        if (rowBegin >= rowEnd) return;
+        std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        std::size_t tileRowBytes = tilesAcross * tr_ * tc_ * sizeof(T);
+        std::size_t from = HEADER_BYTES + (rowBegin / tr_) * tileRowBytes;
+        std::size_t to = HEADER_BYTES + ((rowEnd + tr_ - 1) / tr_) * tileRowBytes;
+        from = from / page * page;
+        if (to > length) to = length;
+        int advice = MADV_NORMAL;
+        switch (hint) {
+            case MapAdvice::Normal:     advice = MADV_NORMAL; break;
+            case MapAdvice::Sequential: advice = MADV_SEQUENTIAL; break;
+            case MapAdvice::Random:     advice = MADV_RANDOM; break;
+            case MapAdvice::WillNeed:   advice = MADV_WILLNEED; break;
+            case MapAdvice::DontNeed:   advice = MADV_DONTNEED; break;
+        }
+        madvise(base + from, to - from, advice);
     }
 
-    T pop_front() {
-        if (empty()) throw std::underflow_error("Deque is empty");
-        T val = data[frontIdx];
-        frontIdx = (frontIdx + 1) % capacity;
-        count--;
-        return val;
+    void flush() {
+        if (writable && msync(base, length, MS_SYNC) != 0) throw std::runtime_error("MappedMatrix msync failed");
     }
 
-    T& front() {
-        if (empty()) throw std::underflow_error("Deque is empty");
-        return data[frontIdx];
+    // Copies rows [r0, r0+h) x cols [c0, c0+w) into dst (leading dimension ld)
+    void readBlock(std::size_t r0, std::size_t c0, std::size_t h, std::size_t w, T* dst, std::size_t ld) const {
+        checkBlock(r0, c0, h, w);
+        for (std::size_t i = 0; i < h; i++) {
+            for (std::size_t j = 0; j < w; ) {
+                std::size_t run = tc_ - (c0 + j) % tc_;
+                if (run > w - j) run = w - j;
+                std::memcpy(dst + i * ld + j, elems() + offset(r0 + i, c0 + j), run * sizeof(T));
+                j += run;
+            }
+        }
     }
 
-    T& back() {
-        if (empty()) throw std::underflow_error("Deque is empty");
-        std::size_t idx = (backIdx == 0) ? capacity - 1 : backIdx - 1;
-        return data[idx];
+    void writeBlock(std::size_t r0, std::size_t c0, std::size_t h, std::size_t w, const T* src, std::size_t ld) {
+        checkWritable();
+        checkBlock(r0, c0, h, w);
+        for (std::size_t i = 0; i < h; i++) {
+            for (std::size_t j = 0; j < w; ) {
+                std::size_t run = tc_ - (c0 + j) % tc_;
+                if (run > w - j) run = w - j;
+                std::memcpy(elems() + offset(r0 + i, c0 + j), src + i * ld + j, run * sizeof(T));
+                j += run;
+            }
+        }
     }
 
-    void print() {
-        std::cout << "Deque: ";
-        for (std::size_t i = 0; i < count; i++) {
-            std::size_t idx = (frontIdx + i) % capacity;
-            std::cout << data[idx];
-            if (i < count - 1) std::cout << ", ";
+    Matrix<T> toMatrix() const {
+        Matrix<T> res(m_, n_);
+        readBlock(0, 0, m_, n_, res.data(), n_);
+        return res;
+    }
+
+    // C = A * B, one block x block tile of C at a time. A block row of A is
+    // reused across the whole row of C, so A is read once and B once per
+    // block row.
+    static void multiply(const MappedMatrix& A, const MappedMatrix& B, MappedMatrix& C,
+                         std::size_t block = 512, unsigned threads = hardwareThreads()) {
+        if (A.n_ != B.m_ || C.m_ != A.m_ || C.n_ != B.n_) {
+            throw std::invalid_argument("Matrix dimensions do not match for multiply");
+        }
+        if (!block) throw std::invalid_argument("MappedMatrix: block size must be non-zero");
+        std::vector<T> a(block * block), b(block * block), c(block * block);
+        for (std::size_t i0 = 0; i0 < A.m_; i0 += block) {
+            std::size_t h = (A.m_ - i0 < block) ? A.m_ - i0 : block;
+            for (std::size_t j0 = 0; j0 < B.n_; j0 += block) {
+                std::size_t w = (B.n_ - j0 < block) ? B.n_ - j0 : block;
+                std::fill(c.begin(), c.end(), T());
+                for (std::size_t k0 = 0; k0 < A.n_; k0 += block) {
+                    std::size_t d = (A.n_ - k0 < block) ? A.n_ - k0 : block;
+                    A.readBlock(i0, k0, h, d, a.data(), d);
+                    B.readBlock(k0, j0, d, w, b.data(), w);
+                    Gemm<T>::multiply(h, w, d, a.data(), d, b.data(), w, c.data(), w, threads);
+                }
+                C.writeBlock(i0, j0, h, w, c.data(), w);
+            }
+        }
+    }
+
+    // dst = src^T, block by block
+    static void transpose(const MappedMatrix& src, MappedMatrix& dst, std::size_t block = 512) {
+        if (dst.m_ != src.n_ || dst.n_ != src.m_) throw std::invalid_argument("Matrix dimensions do not match for transpose");
+        if (!block) throw std::invalid_argument("MappedMatrix: block size must be non-zero");
+        std::vector<T> in(block * block), out(block * block);
+        for (std::size_t i0 = 0; i0 < src.m_; i0 += block) {
+            std::size_t h = (src.m_ - i0 < block) ? src.m_ - i0 : block;
+            for (std::size_t j0 = 0; j0 < src.n_; j0 += block) {
+                std::size_t w = (src.n_ - j0 < block) ? src.n_ - j0 : block;
+                src.readBlock(i0, j0, h, w, in.data(), w);
+                for (std::size_t i = 0; i < h; i++) {
+                    for (std::size_t j = 0; j < w; j++) out[j * h + i] = in[i * w + j];
+                }
+                dst.writeBlock(j0, i0, w, h, out.data(), h);
+            }
+        }
+    }
+
+    void print() const {
+        std::cout << "MappedMatrix " << m_ << "x" << n_ << " (tile " << tr_ << "x" << tc_ << "):\n";
+        for (std::size_t i = 0; i < m_; i++) {
+            for (std::size_t j = 0; j < n_; j++) {
+                std::cout << (*this)(i, j) << " ";
+            }
+            std::cout << std::endl;
         }
-        std::cout << std::endl;
     }
 };
+#endif
 
 //---------------------------------------------------
-// ForwardList<T>
+// UnorderedSet<T>
 template<typename T>
-class ForwardList {
+class UnorderedSet {
 private:
     Node<T>* head;
 
 public:
-    ForwardList() : head(nullptr) {}
-    ~ForwardList() {
+    UnorderedSet() : head(nullptr) {}
+    ~UnorderedSet() {
         Node<T>* temp = head;
         while (temp) {
             Node<T>* toDel = temp;
@@ -880,342 +6681,854 @@ public:
         }
     }
 
-    void push_front(const T& val) {
+    bool contains(const T& val) {
+        Node<T>* temp = head;
+        while (temp) {
+            if (temp->getVal() == val) return true;
+            temp = temp->getNext();
+        }
+        return false;
+    }
+    void insert(const T& val) {
+        if (contains(val)) return;
         Node<T>* newNode = new Node<T>(val);
         newNode->setNext(head);
         head = newNode;
     }
-
-    T pop_front() {
-        if (!head) throw std::underflow_error("ForwardList is empty");
+    void remove(const T& val) {
         Node<T>* temp = head;
-        T retVal = temp->getVal();
-        head = head->getNext();
-        delete temp;
-        return retVal;
+        Node<T>* prev = nullptr;
+        while (temp) {
+            if (temp->getVal() == val) {
+                if (!prev) head = temp->getNext();
+                else prev->setNext(temp->getNext());
+                delete temp;
+                return;
+            }
+            prev = temp;
+            temp = temp->getNext();
+        }
     }
-
-    bool empty() const { return head == nullptr; }
-
     void print() {
-        std::cout << "ForwardList: ";
+        std::cout << "UnorderedSet: ";
         Node<T>* temp = head;
         while (temp) {
             std::cout << temp->getVal();
             temp = temp->getNext();
             if (temp) std::cout << ", ";
         }
-        std::cout << std::endl;
+        std::cout << std::endl;
+    }
+};
+
+//===================================================
+// Hazard Pointers (memory reclamation for lock-free containers)
+//===================================================
+// Before dereferencing a shared node, a thread publishes it in one of its
+// hazard slots. Unlinked nodes are retired instead of deleted, and a
+// retired node is only freed once no thread's hazard slot points at it.
+class HazardPointers {
+public:
+    static const std::size_t SLOTS = 3;
+
+private:
+    struct Retired {
+        void* ptr;
+        void (*deleter)(void*);
+    };
+
+    struct Record {
+        std::atomic<void*> hazard[SLOTS];
+        std::atomic<bool> active;
+        Record* next;
+        Vector<Retired> retired;   // only touched by the owning thread
+        Record() : active(true), next(nullptr) {
+            for (std::size_t i = 0; i < SLOTS; i++) hazard[i].store(nullptr);
+        }
+    };
+
+    std::atomic<Record*> records;   // push-only list, freed at exit
+    std::atomic<std::size_t> recordCount;
+
+    HazardPointers() : records(nullptr), recordCount(0) {}
+    ~HazardPointers() {
+        Record* r = records.load();
+        while (r) {
+            for (std::size_t i = 0; i < r->retired.size(); i++) {
+                r->retired[i].deleter(r->retired[i].ptr);
+            }
+            Record* next = r->next;
+            delete r;
+            r = next;
+        }
+    }
+
+    static HazardPointers& domain() {
+        static HazardPointers d;
+        return d;
+    }
+
+    Record* acquire() {
+        for (Record* r = records.load(); r; r = r->next) {
+            bool expected = false;
+            if (!r->active.load() && r->active.compare_exchange_strong(expected, true)) return r;
+        }
+        Record* r = new Record();
+        Record* head = records.load();
+        do {
+            r->next = head;
+        } while (!records.compare_exchange_weak(head, r));
+        recordCount++;
+        return r;
+    }
+
+    // Hands the record back when its thread exits; leftover retired
+    // nodes are inherited by the next thread that picks it up
+    struct Owner {
+        Record* rec;
+        Owner() : rec(domain().acquire()) {}
+        ~Owner() {
+            for (std::size_t i = 0; i < SLOTS; i++) rec->hazard[i].store(nullptr);
+            rec->active.store(false);
+        }
+    };
+
+    static Record* local() {
+        thread_local Owner owner;
+        return owner.rec;
+    }
+
+    void scan(Record* self) {
+        Vector<void*> guarded;
+        for (Record* r = records.load(); r; r = r->next) {
+            for (std::size_t i = 0; i < SLOTS; i++) {
+                void* p = r->hazard[i].load();
+                if (p) guarded.push_back(p);
+            }
+        }
+        std::size_t i = 0;
+        while (i < self->retired.size()) {
+            bool inUse = false;
+            for (std::size_t j = 0; j < guarded.size() && !inUse; j++) {
+                inUse = (guarded[j] == self->retired[i].ptr);
+            }
+            if (inUse) {
+                i++;
+                continue;
+            }
+            Retired dead = self->retired[i];
+            self->retired[i] = self->retired[self->retired.size() - 1];
+            self->retired.pop_back();
+            dead.deleter(dead.ptr);
+        }
+    }
+
+public:
+    static void protect(std::size_t slot, void* p) {
+        local()->hazard[slot].store(p);
+    }
+
+    static void clear() {
+        Record* r = local();
+        for (std::size_t i = 0; i < SLOTS; i++) r->hazard[i].store(nullptr);
+    }
+
+    static void retire(void* p, void (*deleter)(void*)) {
+        Record* r = local();
+        r->retired.push_back(Retired{p, deleter});
+        if (r->retired.size() >= 2 * SLOTS * domain().recordCount.load() + 16) {
+            domain().scan(r);
+        }
     }
 };
 
 //---------------------------------------------------
-// Vector<T> - dynamic array
-template<typename T>
-class Vector {
+// ConcurrentUnorderedSet<T> - lock-free split-ordered hash set
+// All elements live in one lock-free sorted linked list (Michael's list,
+// deletion marks the low bit of 'next'), ordered by the bit-reversed hash.
+// Buckets are shortcuts into that list: each one points to a dummy node,
+// so doubling the bucket count is a single CAS. New buckets are spliced in
+// lazily behind their parent bucket and readers never wait on a resize.
+template<typename T, typename Hash = std::hash<T>>
+class ConcurrentUnorderedSet {
 private:
-    T* data;
-    std::size_t capacity;
-    std::size_t length;
+    struct ListNode {
+        unsigned long long soKey;   // split-order key: odd for values, even for dummies
+        std::atomic<ListNode*> next;
+        explicit ListNode(unsigned long long k) : soKey(k), next(nullptr) {}
+    };
+
+    struct ValueNode : ListNode {
+        T val;
+        ValueNode(unsigned long long k, const T& v) : ListNode(k), val(v) {}
+    };
+
+    static const std::size_t SEGMENTS = 64;
+    static const std::size_t MAX_LOAD = 2;
+
+    // Segment s > 0 holds buckets [2^(s-1), 2^s); segment 0 holds bucket 0
+    std::atomic<std::atomic<ListNode*>*> segments[SEGMENTS];
+    std::atomic<std::size_t> bucketCount;
+    std::atomic<std::size_t> count;
+    Hash hasher;
+
+    static bool isMarked(ListNode* p) {
+        return (reinterpret_cast<std::uintptr_t>(p) & 1) != 0;
+    }
+    static ListNode* marked(ListNode* p) {
+        return reinterpret_cast<ListNode*>(reinterpret_cast<std::uintptr_t>(p) | 1);
+    }
+    static ListNode* unmarked(ListNode* p) {
+        return reinterpret_cast<ListNode*>(reinterpret_cast<std::uintptr_t>(p) & ~std::uintptr_t(1));
+    }
 
-    void reallocate() {
-        capacity *= 2;
-        T* newData = new T[capacity];
-        for (std::size_t i = 0; i < length; i++) {
-            newData[i] = data[i];
+    static void deleteValueNode(void* p) {
+        delete static_cast<ValueNode*>(static_cast<ListNode*>(p));
+    }
+
+    unsigned long long hashOf(const T& val) const {
+        return mixBits(hasher(val)) & ~(1ULL << 63);
+    }
+    static unsigned long long regularKey(unsigned long long h) { return reverseBits(h | (1ULL << 63)); }
+    static unsigned long long dummyKey(std::size_t b) { return reverseBits(b); }
+
+    std::atomic<ListNode*>& bucketSlot(std::size_t b) {
+        std::size_t s = bitLength(b);
+        std::size_t segSize = (s == 0) ? 1 : (std::size_t(1) << (s - 1));
+        std::size_t offset = (s == 0) ? 0 : b - segSize;
+        std::atomic<ListNode*>* seg = segments[s].load();
+        if (!seg) {
+            std::atomic<ListNode*>* fresh = new std::atomic<ListNode*>[segSize];
+            for (std::size_t i = 0; i < segSize; i++) fresh[i].store(nullptr);
+            if (segments[s].compare_exchange_strong(seg, fresh)) seg = fresh;
+            else delete[] fresh;
+        }
+        return seg[offset];
+    }
+
+    // Dummy node of bucket b, splicing it in behind its parent if needed
+    ListNode* bucketHead(std::size_t b) {
+        std::atomic<ListNode*>& slot = bucketSlot(b);
+        ListNode* dummy = slot.load();
+        if (dummy) return dummy;
+        std::size_t parent = b ^ (std::size_t(1) << (bitLength(b) - 1));
+        ListNode* start = bucketHead(parent);
+        dummy = new ListNode(dummyKey(b));
+        ListNode* inList = insertNode(start, dummy, nullptr);
+        if (inList != dummy) delete dummy;   // another thread won the race
+        slot.store(inList);
+        return inList;
+    }
+
+    // Searches from 'start' for (key, val). On return '*prev' held 'cur',
+    // and cur is either the match or the first node ordered after it.
+    // Hazard slot 0 guards cur, slot 1 guards the node owning 'prev'.
+    bool find(ListNode* start, unsigned long long key, const T* val,
+              std::atomic<ListNode*>*& prev, ListNode*& cur) {
+        while (true) {
+            prev = &start->next;
+            cur = prev->load();
+            bool restart = false;
+            while (!restart) {
+                if (!cur) return false;
+                HazardPointers::protect(0, cur);
+                if (prev->load() != cur) {
+                    restart = true;
+                    continue;
+                }
+                ListNode* next = cur->next.load();
+                if (isMarked(next)) {
+                    // cur is logically deleted: unlink it on the way past
+                    ListNode* expected = cur;
+                    if (!prev->compare_exchange_strong(expected, unmarked(next))) {
+                        restart = true;
+                        continue;
+                    }
+                    HazardPointers::retire(cur, &deleteValueNode);
+                    cur = unmarked(next);
+                    continue;
+                }
+                if (cur->soKey > key) return false;
+                if (cur->soKey == key && (!val || static_cast<ValueNode*>(cur)->val == *val)) return true;
+                prev = &cur->next;
+                HazardPointers::protect(1, cur);
+                cur = next;
+            }
+        }
+    }
+
+    // Links 'node' in unless an equal one exists; returns whichever is in the list
+    ListNode* insertNode(ListNode* start, ListNode* node, const T* val) {
+        std::atomic<ListNode*>* prev;
+        ListNode* cur;
+        while (true) {
+            if (find(start, node->soKey, val, prev, cur)) {
+                HazardPointers::clear();
+                return cur;
+            }
+            node->next.store(cur);
+            ListNode* expected = cur;
+            if (prev->compare_exchange_strong(expected, node)) {
+                HazardPointers::clear();
+                return node;
+            }
         }
-        delete[] data;
-        data = newData;
     }
 
 public:
-    Vector(std::size_t cap = 4)
-    : capacity(cap), length(0) {
-        data = new T[capacity];
+    ConcurrentUnorderedSet() : bucketCount(2), count(0) {
+        for (std::size_t i = 0; i < SEGMENTS; i++) segments[i].store(nullptr);
+        bucketSlot(0).store(new ListNode(dummyKey(0)));
     }
+    ConcurrentUnorderedSet(const ConcurrentUnorderedSet&) = delete;
+    ConcurrentUnorderedSet& operator=(const ConcurrentUnorderedSet&) = delete;
 
-    ~Vector() { delete[] data; }
+    // Not safe to run concurrently with other operations
+    ~ConcurrentUnorderedSet() {
+        ListNode* temp = bucketSlot(0).load();
+        while (temp) {
+            ListNode* toDel = temp;
+            temp = unmarked(temp->next.load());
+            if (toDel->soKey & 1) delete static_cast<ValueNode*>(toDel);
+            else delete toDel;
+        }
+        for (std::size_t i = 0; i < SEGMENTS; i++) delete[] segments[i].load();
+    }
 
-    void push_back(const T& val) {
-        if (length == capacity) {
-            reallocate();
+    bool insert(const T& val) {
+        unsigned long long h = hashOf(val);
+        ListNode* start = bucketHead(h & (bucketCount.load() - 1));
+        ValueNode* node = new ValueNode(regularKey(h), val);
+        if (insertNode(start, node, &node->val) != node) {
+            delete node;
+            return false;
         }
-        data[length++] = val;
+        std::size_t buckets = bucketCount.load();
+        if (++count > MAX_LOAD * buckets) bucketCount.compare_exchange_strong(buckets, buckets * 2);
+        return true;
     }
 
-    T pop_back() {
-        if (length == 0) throw std::underflow_error("Vector empty");
-        return data[--length];
+    bool contains(const T& val) {
+        unsigned long long h = hashOf(val);
+        ListNode* start = bucketHead(h & (bucketCount.load() - 1));
+        std::atomic<ListNode*>* prev;
+        ListNode* cur;
+        bool found = find(start, regularKey(h), &val, prev, cur);
+        HazardPointers::clear();
+        return found;
     }
 
-    T& operator[](std::size_t idx) {
-        if (idx >= length) throw std::out_of_range("Vector index out of range");
-        return data[idx];
+    bool remove(const T& val) {
+        unsigned long long h = hashOf(val);
+        unsigned long long key = regularKey(h);
+        ListNode* start = bucketHead(h & (bucketCount.load() - 1));
+        std::atomic<ListNode*>* prev;
+        ListNode* cur;
+        while (true) {
+            if (!find(start, key, &val, prev, cur)) {
+                HazardPointers::clear();
+                return false;
+            }
+            ListNode* next = cur->next.load();
+            if (isMarked(next)) continue;
+            // Logical delete first, then try to unlink
+            if (!cur->next.compare_exchange_strong(next, marked(next))) continue;
+            ListNode* expected = cur;
+            if (prev->compare_exchange_strong(expected, next)) {
+                HazardPointers::retire(cur, &deleteValueNode);
+            } else {
+                find(start, key, &val, prev, cur);   // unlinks the marked node
+            }
+            count--;
+            HazardPointers::clear();
+            return true;
+        }
     }
 
-    std::size_t size() const { return length; }
+    std::size_t size() const { return count.load(); }
+    bool empty() const { return count.load() == 0; }
 
+    // Snapshot only while no other thread is writing
     void print() {
-        std::cout << "Vector: ";
-        for (std::size_t i = 0; i < length; i++) {
-            std::cout << data[i];
-            if (i < length - 1) std::cout << ", ";
+        std::cout << "ConcurrentUnorderedSet: ";
+        bool first = true;
+        for (ListNode* temp = unmarked(bucketSlot(0).load()->next.load()); temp;
+             temp = unmarked(temp->next.load())) {
+            if (!(temp->soKey & 1) || isMarked(temp->next.load())) continue;
+            if (!first) std::cout << ", ";
+            std::cout << static_cast<ValueNode*>(temp)->val;
+            first = false;
         }
         std::cout << std::endl;
     }
 };
 
 //---------------------------------------------------
-// Span<T> - pointer + size
+// ConcurrentStack<T> - lock-free Treiber stack
+// push and pop are a single CAS on 'head' and are O(1). The top 16 bits of
+// 'head' hold a version tag that every successful CAS bumps, so a head
+// that was popped and pushed again in between (ABA) no longer compares
+// equal. Popped nodes are retired through HazardPointers, never deleted
+// directly: a node that another thread is still reading is never freed.
 template<typename T>
-class Span {
+class ConcurrentStack {
+    static_assert(sizeof(void*) == 8, "ConcurrentStack packs a tag into 64-bit pointers");
+
 private:
-    T* ptr;
-    std::size_t length;
+    struct StackNode {
+        T val;
+        StackNode* next;
+        explicit StackNode(const T& v) : val(v), next(nullptr) {}
+    };
+
+    // User-space addresses fit in the low 48 bits on x86-64 and AArch64
+    static const unsigned TAG_SHIFT = 48;
+    static const unsigned long long PTR_MASK = (1ULL << TAG_SHIFT) - 1;
+
+    std::atomic<unsigned long long> head;
+    std::atomic<std::size_t> count;
+
+    static StackNode* ptrOf(unsigned long long word) {
+        return reinterpret_cast<StackNode*>(static_cast<std::uintptr_t>(word & PTR_MASK));
+    }
+    static unsigned long long pack(StackNode* p, unsigned long long oldWord) {
+        unsigned long long tag = (oldWord >> TAG_SHIFT) + 1;
+        return (tag << TAG_SHIFT) | (reinterpret_cast<std::uintptr_t>(p) & PTR_MASK);
+    }
+    static void deleteNode(void* p) { delete static_cast<StackNode*>(p); }
 
 public:
-    Span(T* p, std::size_t len) : ptr(p), length(len) {}
-    T& operator[](std::size_t idx) {
-        if (idx >= length) throw std::out_of_range("Span index out of range");
-        return ptr[idx];
+    ConcurrentStack() : head(0), count(0) {}
+    ConcurrentStack(const ConcurrentStack&) = delete;
+    ConcurrentStack& operator=(const ConcurrentStack&) = delete;
+
+    // Not safe to run concurrently with other operations
+    ~ConcurrentStack() {
+        StackNode* temp = ptrOf(head.load());
+        while (temp) {
+            StackNode* toDel = temp;
+            temp = temp->next;
+            delete toDel;
+        }
     }
-    std::size_t size() const { return length; }
-    void print() {
-        std::cout << "Span: ";
-        for (std::size_t i = 0; i < length; i++) {
-            std::cout << ptr[i];
-            if (i < length - 1) std::cout << ", ";
+
+    void push(const T& val) {
+        StackNode* node = new StackNode(val);
+        unsigned long long old = head.load(std::memory_order_relaxed);
+        do {
+            node->next = ptrOf(old);
+        } while (!head.compare_exchange_weak(old, pack(node, old),
+                                             std::memory_order_release, std::memory_order_relaxed));
+        count++;
+    }
+
+    bool try_pop(T& out) {
+        while (true) {
+            unsigned long long old = head.load(std::memory_order_acquire);
+            StackNode* top = ptrOf(old);
+            if (!top) {
+                HazardPointers::clear();
+                return false;
+            }
+            HazardPointers::protect(0, top);
+            if (head.load(std::memory_order_acquire) != old) continue;
+            if (head.compare_exchange_strong(old, pack(top->next, old), std::memory_order_acquire)) {
+                out = std::move(top->val);
+                HazardPointers::clear();
+                HazardPointers::retire(top, &deleteNode);
+                count--;
+                return true;
+            }
         }
-        std::cout << std::endl;
     }
+
+    T pop() {
+        T out;
+        if (!try_pop(out)) throw std::underflow_error("ConcurrentStack is empty, cannot pop.");
+        return out;
+    }
+
+    // Approximate while other threads are running
+    std::size_t size() const { return count.load(); }
+    bool empty() const { return ptrOf(head.load()) == nullptr; }
 };
 
 //---------------------------------------------------
-// FlatSet<T> 
-template<typename T>
-class FlatSet {
+// MultiQueue<T> - relaxed concurrent priority queue
+// Several lock-protected PriorityQueues, QUEUES_PER_THREAD per thread.
+// push() goes to a random queue; pop() looks at two random queues and
+// takes the better top (power of two choices). Pops are not strictly in
+// priority order: the rank error grows with the number of queues, which
+// is the knob that trades ordering quality for less lock contention.
+template<typename T, typename Compare = std::less<T>, std::size_t D = 4>
+class MultiQueue {
 private:
-    Vector<T> vec;
+    static const std::size_t CACHE_LINE = 64;
+
+    struct alignas(CACHE_LINE) Lane {
+        std::atomic<bool> locked;
+        std::atomic<std::size_t> count;   // readable without the lock
+        PriorityQueue<T, Compare, D> heap;
+        Lane() : locked(false), count(0) {}
+        bool tryLock() { return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire); }
+        void unlock() { locked.store(false, std::memory_order_release); }
+    };
+
+    Lane* lanes;
+    std::size_t laneCount;
+    Compare comp;
+
+    static std::size_t randomLane(std::size_t n) {
+        // xorshift64*, one generator per thread
+        thread_local unsigned long long state =
+            mixBits(reinterpret_cast<std::uintptr_t>(&state)) | 1ULL;
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return static_cast<std::size_t>((state * 0x2545F4914F6CDD1DULL) >> 32) % n;
+    }
 
 public:
-    void insert(const T& val) {
-        // Insert in sorted order if not present
-        for (std::size_t i = 0; i < vec.size(); i++) {
-            if (vec[i] == val) return;   // already present
-            if (vec[i] > val) {
-                vec.push_back(val); // push at end
-                // bubble up
-                for (std::size_t j = vec.size() - 1; j > i; j--) {
-                    T tmp = vec[j];
-                    vec[j] = vec[j - 1];
-                    vec[j - 1] = tmp;
-                }
-                return;
-            }
+    MultiQueue(std::size_t threads, std::size_t queuesPerThread = 2, const Compare& c = Compare())
+    : laneCount(threads * queuesPerThread < 2 ? 2 : threads * queuesPerThread), comp(c) {
+        lanes = new Lane[laneCount];
+    }
+    MultiQueue(const MultiQueue&) = delete;
+    MultiQueue& operator=(const MultiQueue&) = delete;
+    ~MultiQueue() { delete[] lanes; }
+
+    void push(const T& val) {
+        while (true) {
+            Lane& lane = lanes[randomLane(laneCount)];
+            if (!lane.tryLock()) continue;
+            lane.heap.push(val);
+            lane.count.store(lane.heap.size(), std::memory_order_relaxed);
+            lane.unlock();
+            return;
         }
-        vec.push_back(val);  // insert at end
     }
 
-    bool contains(const T& val) {
-        // naive linear search
-        for (std::size_t i = 0; i < vec.size(); i++) {
-            if (vec[i] == val) return true;
-            if (vec[i] > val) return false;
+    // Pops a high-priority element into 'out'. Returns false only once every
+    // queue has been seen empty.
+    bool try_pop(T& out) {
+        for (std::size_t attempt = 0; attempt < 4 * laneCount; attempt++) {
+            Lane* a = &lanes[randomLane(laneCount)];
+            Lane* b = &lanes[randomLane(laneCount)];
+            if (a->count.load(std::memory_order_relaxed) == 0) std::swap(a, b);
+            if (a->count.load(std::memory_order_relaxed) == 0) continue;
+            if (!a->tryLock()) continue;
+            if (b != a && b->count.load(std::memory_order_relaxed) != 0 && b->tryLock()) {
+                // Keep whichever lane has the better top locked
+                if (a->heap.empty() || (!b->heap.empty() && comp(a->heap.top(), b->heap.top()))) {
+                    std::swap(a, b);
+                }
+                b->unlock();
+            }
+            if (a->heap.empty()) {
+                a->unlock();
+                continue;
+            }
+            out = a->heap.pop();
+            a->count.store(a->heap.size(), std::memory_order_relaxed);
+            a->unlock();
+            return true;
+        }
+        // Random probes kept missing: sweep every lane before giving up
+        for (std::size_t i = 0; i < laneCount; i++) {
+            Lane& lane = lanes[i];
+            if (lane.count.load(std::memory_order_relaxed) == 0) continue;
+            while (!lane.tryLock()) std::this_thread::yield();
+            bool got = !lane.heap.empty();
+            if (got) {
+                out = lane.heap.pop();
+                lane.count.store(lane.heap.size(), std::memory_order_relaxed);
+            }
+            lane.unlock();
+            if (got) return true;
         }
         return false;
     }
 
-    void print() {
-        std::cout << "FlatSet: ";
-        vec.print();
+    // Approximate while other threads are running
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < laneCount; i++) total += lanes[i].count.load(std::memory_order_relaxed);
+        return total;
     }
+    bool empty() const { return size() == 0; }
+    std::size_t queues() const { return laneCount; }
 };
 
 //---------------------------------------------------
-// FlatMap<K,V> 
-template<typename K, typename V>
-class FlatMap {
+// RingWaiter - blocking fallback for the ring-buffer queues
+// Spins briefly, then sleeps on a condition variable. notify() costs one
+// fence and one load unless somebody is actually asleep.
+class RingWaiter {
 private:
-    Vector<K> keys;
-    Vector<V> vals;
+    std::mutex m;
+    std::condition_variable cv;
+    std::atomic<int> sleepers;
 
 public:
-    void insert(const K& key, const V& val) {
-        // Keep keys sorted, maintain parallel 'vals'
-        for (std::size_t i = 0; i < keys.size(); i++) {
-            if (keys[i] == key) {
-                vals[i] = val; // update
-                return;
-            }
-            if (keys[i] > key) {
-                keys.push_back(key);
-                vals.push_back(val);
-                // bubble up
-                for (std::size_t j = keys.size() - 1; j > i; j--) {
-                    K tempK = keys[j];
-                    V tempV = vals[j];
-                    keys[j]   = keys[j - 1];
-                    vals[j]   = vals[j - 1];
-                    keys[j-1] = tempK;
-                    vals[j-1] = tempV;
-                }
-                return;
-            }
+    RingWaiter() : sleepers(0) {}
+
+    template<typename Pred>
+    void wait(Pred ready) {
+        for (int i = 0; i < 64; i++) {
+            if (ready()) return;
+            std::this_thread::yield();
         }
-        // append at end
-        keys.push_back(key);
-        vals.push_back(val);
+        std::unique_lock<std::mutex> lock(m);
+        sleepers++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait(lock, ready);
+        sleepers--;
     }
 
-    bool contains(const K& key) {
-        for (std::size_t i = 0; i < keys.size(); i++) {
-            if (keys[i] == key) return true;
-            if (keys[i] > key) return false;
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(m);
+            cv.notify_all();
         }
-        return false;
     }
+};
 
-    V get(const K& key) {
-        for (std::size_t i = 0; i < keys.size(); i++) {
-            if (keys[i] == key) return vals[i];
-            if (keys[i] > key) break;
+inline std::size_t roundUpPow2(std::size_t n) {
+    std::size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+//---------------------------------------------------
+// SpscRingQueue<T> - bounded lock-free single-producer/single-consumer queue
+// Classic ring buffer whose capacity is a power of two, so wrapping is a
+// mask, and head/tail are free-running counters, so full and empty need no
+// separate count. Each side keeps a cached copy of the other side's
+// counter and only re-reads the shared one when the cache says full/empty.
+template<typename T>
+class SpscRingQueue {
+private:
+    static const std::size_t CACHE_LINE = 64;
+
+    T* buf;
+    std::size_t mask;
+    alignas(CACHE_LINE) std::atomic<std::size_t> head;   // consumer side
+    std::size_t cachedTail;
+    alignas(CACHE_LINE) std::atomic<std::size_t> tail;   // producer side
+    std::size_t cachedHead;
+    alignas(CACHE_LINE) RingWaiter notEmpty;
+    RingWaiter notFull;
+
+    // Free slots the producer may fill, refreshing its view of head if needed
+    std::size_t freeSlots(std::size_t t, std::size_t want) {
+        std::size_t free = mask + 1 - (t - cachedHead);
+        if (free < want) {
+            cachedHead = head.load(std::memory_order_acquire);
+            free = mask + 1 - (t - cachedHead);
         }
-        throw std::out_of_range("Key not found in FlatMap");
+        return free;
     }
 
-    void print() {
-        std::cout << "FlatMap: ";
-        for (std::size_t i = 0; i < keys.size(); i++) {
-            std::cout << "(" << keys[i] << "->" << vals[i] << ")";
-            if (i < keys.size()-1) std::cout << ", ";
+    std::size_t readySlots(std::size_t h, std::size_t want) {
+        std::size_t ready = cachedTail - h;
+        if (ready < want) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            ready = cachedTail - h;
         }
-        std::cout << std::endl;
+        return ready;
     }
-};
-
-//---------------------------------------------------
-// InplaceVector<T, CAP>
-template<typename T, std::size_t CAP>
-class InplaceVector {
-private:
-    T arr[CAP];
-    std::size_t length;
 
 public:
-    InplaceVector() : length(0) {}
-    void push_back(const T& val) {
-        if (length >= CAP) throw std::overflow_error("InplaceVector full");
-        arr[length++] = val;
+    explicit SpscRingQueue(std::size_t cap = 1024)
+    : mask(roundUpPow2(cap < 2 ? 2 : cap) - 1), head(0), cachedTail(0), tail(0), cachedHead(0) {
+        buf = static_cast<T*>(::operator new(sizeof(T) * (mask + 1)));
     }
-    T pop_back() {
-        if (length == 0) throw std::underflow_error("InplaceVector empty");
-        return arr[--length];
+    SpscRingQueue(const SpscRingQueue&) = delete;
+    SpscRingQueue& operator=(const SpscRingQueue&) = delete;
+
+    ~SpscRingQueue() {
+        for (std::size_t i = head.load(); i != tail.load(); i++) buf[i & mask].~T();
+        ::operator delete(buf);
     }
-    T& operator[](std::size_t idx) {
-        if (idx >= length) throw std::out_of_range("InplaceVector index out of range");
-        return arr[idx];
+
+    std::size_t capacity() const { return mask + 1; }
+    std::size_t size() const { return tail.load() - head.load(); }
+    bool empty() const { return size() == 0; }
+
+    bool try_push(const T& val) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (freeSlots(t, 1) == 0) return false;
+        new (&buf[t & mask]) T(val);
+        tail.store(t + 1, std::memory_order_release);
+        notEmpty.notify();
+        return true;
     }
-    std::size_t size() const { return length; }
 
-    void print() {
-        std::cout << "InplaceVector: ";
-        for (std::size_t i = 0; i < length; i++) {
-            std::cout << arr[i];
-            if (i < length - 1) std::cout << ", ";
-        }
-        std::cout << std::endl;
+    bool try_pop(T& out) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (readySlots(h, 1) == 0) return false;
+        out = std::move(buf[h & mask]);
+        buf[h & mask].~T();
+        head.store(h + 1, std::memory_order_release);
+        notFull.notify();
+        return true;
     }
-};
 
-//---------------------------------------------------
-// MdSpan<T> 
-template<typename T>
-class MdSpan {
-private:
-    T* data;
-    std::size_t rows;
-    std::size_t cols;
+    // Pushes up to n items with one counter update; returns how many fit
+    std::size_t push_n(const T* items, std::size_t n) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        std::size_t k = freeSlots(t, n);
+        if (k > n) k = n;
+        if (k == 0) return 0;
+        for (std::size_t i = 0; i < k; i++) new (&buf[(t + i) & mask]) T(items[i]);
+        tail.store(t + k, std::memory_order_release);
+        notEmpty.notify();
+        return k;
+    }
 
-public:
-    MdSpan(T* ptr, std::size_t r, std::size_t c)
-    : data(ptr), rows(r), cols(c) {}
+    std::size_t pop_n(T* out, std::size_t n) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        std::size_t k = readySlots(h, n);
+        if (k > n) k = n;
+        if (k == 0) return 0;
+        for (std::size_t i = 0; i < k; i++) {
+            out[i] = std::move(buf[(h + i) & mask]);
+            buf[(h + i) & mask].~T();
+        }
+        head.store(h + k, std::memory_order_release);
+        notFull.notify();
+        return k;
+    }
 
-    T& operator()(std::size_t i, std::size_t j) {
-        if (i >= rows || j >= cols) throw std::out_of_range("MdSpan index out of range");
-        return data[i*cols + j];
+    // Blocking variants: spin, then sleep until there is room / data
+    void push(const T& val) {
+        while (!try_push(val)) {
+            notFull.wait([this]() { return tail.load() - head.load() <= mask; });
+        }
     }
-    void print() {
-        std::cout << "MdSpan " << rows << "x" << cols << ":\n";
-        for (std::size_t i = 0; i < rows; i++) {
-            for (std::size_t j = 0; j < cols; j++) {
-                std::cout << data[i*cols + j] << " ";
-            }
-            std::cout << std::endl;
+
+    T pop() {
+        T out;
+        while (!try_pop(out)) {
+            notEmpty.wait([this]() { return tail.load() != head.load(); });
         }
+        return out;
     }
 };
 
 //---------------------------------------------------
-// UnorderedSet<T>
+// MpmcRingQueue<T> - bounded lock-free multi-producer/multi-consumer queue
+// Each cell carries a sequence number saying whose turn it is: a producer
+// may fill position p once seq == p, a consumer may drain it once
+// seq == p + 1. Producers and consumers claim positions by CAS on their
+// own padded counter, so the two sides never touch the same cache line.
 template<typename T>
-class UnorderedSet {
+class MpmcRingQueue {
 private:
-    Node<T>* head;
+    static const std::size_t CACHE_LINE = 64;
+
+    struct Cell {
+        std::atomic<std::size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+        T* item() { return reinterpret_cast<T*>(storage); }
+    };
+
+    Cell* cells;
+    std::size_t mask;
+    alignas(CACHE_LINE) std::atomic<std::size_t> enqueuePos;
+    alignas(CACHE_LINE) std::atomic<std::size_t> dequeuePos;
+    alignas(CACHE_LINE) RingWaiter notEmpty;
+    RingWaiter notFull;
+
+    // Claims up to n consecutive positions whose cells have sequence
+    // pos + j + 'lag' (0 for producers, 1 for consumers)
+    std::size_t claim(std::atomic<std::size_t>& counter, std::size_t lag, std::size_t n, std::size_t& pos) {
+        pos = counter.load(std::memory_order_relaxed);
+        while (true) {
+            std::size_t k = 0;
+            while (k < n && k <= mask &&
+                   cells[(pos + k) & mask].seq.load(std::memory_order_acquire) == pos + k + lag) {
+                k++;
+            }
+            if (k == 0) {
+                std::size_t seq = cells[pos & mask].seq.load(std::memory_order_acquire);
+                if (static_cast<std::ptrdiff_t>(seq - (pos + lag)) < 0) return 0;   // full / empty
+                pos = counter.load(std::memory_order_relaxed);                     // lost a race
+                continue;
+            }
+            if (counter.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed)) return k;
+        }
+    }
 
 public:
-    UnorderedSet() : head(nullptr) {}
-    ~UnorderedSet() {
-        Node<T>* temp = head;
-        while (temp) {
-            Node<T>* toDel = temp;
-            temp = temp->getNext();
-            delete toDel;
-        }
+    explicit MpmcRingQueue(std::size_t cap = 1024)
+    : mask(roundUpPow2(cap < 2 ? 2 : cap) - 1), enqueuePos(0), dequeuePos(0) {
+        cells = new Cell[mask + 1];
+        for (std::size_t i = 0; i <= mask; i++) cells[i].seq.store(i, std::memory_order_relaxed);
     }
+    MpmcRingQueue(const MpmcRingQueue&) = delete;
+    MpmcRingQueue& operator=(const MpmcRingQueue&) = delete;
 
-    bool contains(const T& val) {
-        Node<T>* temp = head;
-        while (temp) {
-            if (temp->getVal() == val) return true;
-            temp = temp->getNext();
+    ~MpmcRingQueue() {
+        for (std::size_t i = dequeuePos.load(); i != enqueuePos.load(); i++) cells[i & mask].item()->~T();
+        delete[] cells;
+    }
+
+    std::size_t capacity() const { return mask + 1; }
+    // Approximate while other threads are running
+    std::size_t size() const { return enqueuePos.load() - dequeuePos.load(); }
+    bool empty() const { return size() == 0; }
+
+    std::size_t push_n(const T* items, std::size_t n) {
+        std::size_t pos;
+        std::size_t k = claim(enqueuePos, 0, n, pos);
+        for (std::size_t i = 0; i < k; i++) {
+            Cell& c = cells[(pos + i) & mask];
+            new (c.storage) T(items[i]);
+            c.seq.store(pos + i + 1, std::memory_order_release);
         }
-        return false;
+        if (k) notEmpty.notify();
+        return k;
     }
-    void insert(const T& val) {
-        if (contains(val)) return;
-        Node<T>* newNode = new Node<T>(val);
-        newNode->setNext(head);
-        head = newNode;
+
+    std::size_t pop_n(T* out, std::size_t n) {
+        std::size_t pos;
+        std::size_t k = claim(dequeuePos, 1, n, pos);
+        for (std::size_t i = 0; i < k; i++) {
+            Cell& c = cells[(pos + i) & mask];
+            out[i] = std::move(*c.item());
+            c.item()->~T();
+            c.seq.store(pos + i + mask + 1, std::memory_order_release);
+        }
+        if (k) notFull.notify();
+        return k;
     }
-    void remove(const T& val) {
-        Node<T>* temp = head;
-        Node<T>* prev = nullptr;
-        while (temp) {
-            if (temp->getVal() == val) {
-                if (!prev) head = temp->getNext();
-                else prev->setNext(temp->getNext());
-                delete temp;
-                return;
-            }
-            prev = temp;
-            temp = temp->getNext();
+
+    bool try_push(const T& val) { return push_n(&val, 1) == 1; }
+    bool try_pop(T& out)        { return pop_n(&out, 1) == 1; }
+
+    void push(const T& val) {
+        while (!try_push(val)) {
+            notFull.wait([this]() { return enqueuePos.load() - dequeuePos.load() <= mask; });
         }
     }
-    void print() {
-        std::cout << "UnorderedSet: ";
-        Node<T>* temp = head;
-        while (temp) {
-            std::cout << temp->getVal();
-            temp = temp->getNext();
-            if (temp) std::cout << ", ";
+
+    T pop() {
+        T out;
+        while (!try_pop(out)) {
+            notEmpty.wait([this]() { return enqueuePos.load() != dequeuePos.load(); });
         }
-        std::cout << std::endl;
+        return out;
     }
 };
 
 //===================================================
 // main() - Test everything
 //===================================================
+// Define BDS_NO_MAIN to include this file from another program
+// (benchmarks.cpp does).
+#ifndef BDS_NO_MAIN
 int main() {
     // 1) LinkedList<int>
     LinkedList<int> list{1, 2, 3, 5, 4};
@@ -1223,6 +7536,13 @@ int main() {
     list.sort();
     list.print();       // 1, 2, 3, 4, 5
 
+    LinkedList<int> bigList;
+    for (int i = 0; i < 100000; i++) bigList.push((i * 7919) % 100000);
+    bigList.parallelSort(4);
+    std::cout << "parallelSort: front = " << bigList.front()
+              << ", back = " << bigList.back()
+              << ", valAtIndex(500) = " << bigList.valAtIndex(500) << std::endl;
+
     // 2) CircularLinkedList<double>
     CircularLinkedList<double> clist;
     clist.push(10.5);
@@ -1232,11 +7552,58 @@ int main() {
     clist.pop();
     clist.print();
 
+    // 2b) UnrolledLinkedList<int>
+    UnrolledLinkedList<int> ulist;
+    for (int i = 40; i > 0; i--) ulist.push(i);
+    ulist.popAtIndex(3);
+    ulist.insertAtIndex(5, 100);
+    ulist.pop_front();
+    ulist.sort();
+    ulist.print();
+    std::cout << "UnrolledLinkedList size: " << ulist.size()
+              << ", find(100) = " << ulist.find(100) << std::endl;
+
     // 3) Matrix<int>
     Matrix<int> mat(2,3);
     mat(0,0) = 1; mat(0,1) = 2; mat(0,2) = 3;
     mat(1,0) = 4; mat(1,1) = 5; mat(1,2) = 6;
     mat.print();
+    Matrix<int> gram = mat * mat.transpose();
+    gram.print();
+    Matrix<int> ones(2,3);
+    ones = ones + 1;
+    Matrix<int> fused = mat * 2 + ones - mat;   // one loop, no temporaries
+    fused.print();
+    std::cout << "sum(mat) = " << sum(mat) << ", dot(mat, ones) = " << dot(mat, ones) << std::endl;
+
+    Matrix<double> ga(150, 70), gb(70, 130);
+    for (std::size_t r = 0; r < 150; r++)
+        for (std::size_t c = 0; c < 70; c++) ga(r, c) = double((r * 3 + c) % 7) - 3.0;
+    for (std::size_t r = 0; r < 70; r++)
+        for (std::size_t c = 0; c < 130; c++) gb(r, c) = double((r + c * 5) % 11) - 5.0;
+    Matrix<double> gc = ga.multiply(gb, 4);
+    double maxErr = 0.0;
+    for (std::size_t r = 0; r < 150; r++) {
+        for (std::size_t c = 0; c < 130; c++) {
+            double naive = 0.0;
+            for (std::size_t p = 0; p < 70; p++) naive += ga(r, p) * gb(p, c);
+            double err = naive > gc(r, c) ? naive - gc(r, c) : gc(r, c) - naive;
+            if (err > maxErr) maxErr = err;
+        }
+    }
+    std::cout << "Gemm 150x70 * 70x130 max error vs naive loop: " << maxErr << std::endl;
+
+    // 3b) SparseMatrix<double> from COO triplets
+    std::vector<SparseEntry<double>> coo = {{0, 0, 4.0}, {2, 1, 1.5}, {1, 2, -2.0}, {2, 1, 0.5}, {0, 2, 1.0}};
+    SparseMatrix<double> sm(3, 3, coo);
+    sm.print();
+    SparseMatrix<double> smc = sm.convert(SparseFormat::CSC);
+    smc.print();
+    std::vector<double> sx = {1.0, 2.0, 3.0};
+    std::vector<double> sy = smc.multiply(sx);
+    std::cout << "SpMV: " << sy[0] << " " << sy[1] << " " << sy[2] << std::endl;
+    Matrix<double> sd = sm.multiply(sm.toDense());
+    sd.print();
 
     // 4) Array<char>
     Array<char> arr(5);
@@ -1244,6 +7611,28 @@ int main() {
     arr.interpolate();
     arr.print();
 
+    Array<float> ramp(8);
+    for (std::size_t i = 0; i < ramp.capacity(); i++) ramp[i] = static_cast<float>(i);
+    float ramp3of2[12];
+    std::size_t rampLen = ramp.resample(3, 2, ResampleKernel::Linear, ramp3of2, 12);
+    std::cout << "Linear 3/2 resample:";
+    for (std::size_t i = 0; i < rampLen; i++) std::cout << " " << ramp3of2[i];
+    std::cout << std::endl;
+    ramp.resampleInPlace(1, 2, ResampleKernel::Cubic);
+    ramp.print();
+
+    // 44.1 kHz -> 48 kHz in blocks of 441 samples, state carried between blocks
+    Resampler<double> toDat(48000, 44100, ResampleKernel::Sinc);
+    std::vector<double> tone(441), block(toDat.maxOutput(441));
+    std::size_t streamed = 0;
+    for (int b = 0; b < 10; b++) {
+        for (std::size_t i = 0; i < tone.size(); i++) tone[i] = ((b * 441 + i) / 50) % 2 ? 1.0 : -1.0;
+        streamed += toDat.push(tone.data(), tone.size(), block.data(), block.size());
+    }
+    streamed += toDat.flush(block.data(), block.size());
+    std::cout << "Resampler " << toDat.up() << "/" << toDat.down() << " (" << toDat.taps() << " taps): 4410 -> "
+              << streamed << " samples" << std::endl;
+
     // 5) Stack<std::string>
     Stack<std::string> st;
     st.push("Hello");
@@ -1270,6 +7659,14 @@ int main() {
     pq.pop();
     pq.print();
 
+    int timers[6] = {40, 10, 60, 30, 50, 20};
+    PriorityQueue<int, std::greater<int>> minPq(timers, timers + 6);
+    minPq.decrease_key(2, 5);   // handle 2 is the 60
+    minPq.erase(0);             // handle 0 is the 40
+    std::cout << "Min-heap pops: ";
+    while (!minPq.empty()) std::cout << minPq.pop() << " ";
+    std::cout << std::endl;
+
     // 8) Map<int,int>
     Map<int,int> mp;
     mp.insert(1, 100);
@@ -1277,6 +7674,74 @@ int main() {
     mp.print();
     mp.remove(1);
     mp.print();
+    Map<int,int> index;
+    std::vector<std::pair<int,int>> sortedRows;
+    for (int i = 0; i < 1000; i++) sortedRows.push_back(std::make_pair(i * 2, i));
+    index.bulk_load(sortedRows.begin(), sortedRows.end());
+    for (int i = 0; i < 1000; i += 3) index.remove(i * 2);
+    index.insert(7, -7);
+    std::cout << "Map range [0, 12): ";
+    index.range(0, 12, [](const int& k, const int& v) { std::cout << k << "->" << v << " "; });
+    std::cout << "| lower_bound(1001) = " << index.lower_bound(1001).key()
+              << ", size " << index.size() << std::endl;
+
+    // 8b) Set<int>: posting-list style intersection, sorted vs hashed
+    std::vector<int> twoIds, threeIds;
+    for (int i = 0; i < 100000; i += 2) twoIds.push_back(i);
+    for (int i = 0; i < 100000; i += 3) threeIds.push_back(i);
+    Set<int> byTwo(twoIds.begin(), twoIds.end()), byThree(threeIds.begin(), threeIds.end());
+    Set<int> bySix = byTwo.intersect(byThree);
+    Set<int> rare{6, 7, 600, 99999};
+    std::cout << "Set sizes: |2n & 3n| = " << bySix.size()
+              << ", |2n | 3n| = " << byTwo.unite(byThree).size()
+              << ", |2n - 3n| = " << byTwo.difference(byThree).size()
+              << ", |2n ^ 3n| = " << byTwo.symmetric_difference(byThree).size() << std::endl;
+    bySix.intersect(rare).print();
+    Set<int, SetPolicy::Hashed> hs{1, 2, 3, 4};
+    Set<int, SetPolicy::Hashed> ht{3, 4, 5};
+    std::cout << "Hashed |a & b| = " << hs.intersect(ht).size()
+              << ", |a ^ b| = " << hs.symmetric_difference(ht).size() << std::endl;
+    // The SIMD block path must agree with a plain merge, including blocks
+    // whose maxima are equal (both sides advance) and ragged tails
+    auto blockIntersectAgrees = [](auto tag) {
+        typedef decltype(tag) T;
+        std::vector<std::vector<T>> as, bs;
+        std::vector<T> a, b;
+        unsigned seed = 12345;
+        for (T v = 0; v < 3000; v++) {   // dense overlap: many shared block maxima
+            seed = seed * 1103515245u + 12345u;
+            if (seed & 0x10000) a.push_back(v);
+            if (seed & 0x20000) b.push_back(v);
+        }
+        as.push_back(a);
+        bs.push_back(b);
+        as.push_back(a);   // identical inputs: every block maximum is equal
+        bs.push_back(a);
+        a.clear();
+        b.clear();
+        for (T blk = 0; blk < 40; blk++) {   // equal maxima, different interiors
+            for (T k = 0; k < 7; k++) a.push_back(blk * 100 + k);
+            for (T k = 3; k < 10; k++) b.push_back(blk * 100 + k);
+            a.push_back(blk * 100 + 99);
+            b.push_back(blk * 100 + 99);
+        }
+        a.push_back(5000);
+        b.push_back(5000);
+        as.push_back(a);
+        bs.push_back(b);
+        bool same = true;
+        for (std::size_t c = 0; c < as.size(); c++) {
+            std::vector<T> simd, scalar;
+            SortedSetOps::intersect(as[c].data(), as[c].size(), bs[c].data(), bs[c].size(), simd);
+            std::set_intersection(as[c].begin(), as[c].end(), bs[c].begin(), bs[c].end(), std::back_inserter(scalar));
+            same = same && simd == scalar;
+        }
+        return same;
+    };
+    bool blocksAgree = blockIntersectAgrees(std::int32_t()) && blockIntersectAgrees(std::uint32_t()) &&
+                       blockIntersectAgrees(std::int64_t());
+    if (!blocksAgree) throw std::logic_error("SortedSetOps::intersect: SIMD blocks disagree with the merge");
+    std::cout << "SIMD block intersect matches std::set_intersection: " << blocksAgree << std::endl;
 
     // 9) UnorderedMap<std::string,int>
     UnorderedMap<std::string,int> um;
@@ -1286,6 +7751,73 @@ int main() {
     um.remove("ten");
     um.print();
 
+    UnorderedMap<int,int> bigUm;
+    bigUm.reserve(1000);
+    for (int i = 0; i < 1000; i++) bigUm.insert(i, i * i);
+    for (int i = 0; i < 1000; i += 2) bigUm.remove(i);
+    std::cout << "UnorderedMap size: " << bigUm.size()
+              << ", get(999) = " << bigUm.get(999)
+              << ", contains(500) = " << bigUm.contains(500) << std::endl;
+
+    // 9b) LRUCache / ClockCache / ShardedCache
+    LRUCache<int, std::string> lru(3);
+    int evicted = -1;
+    lru.onEvict([&evicted](const int& k, const std::string&) { evicted = k; });
+    lru.put(1, "one");
+    lru.put(2, "two");
+    lru.put(3, "three");
+    lru.get(1);
+    lru.put(4, "four");   // 2 is now the least recently used
+    lru.print();
+    std::cout << "LRUCache evicted " << evicted << std::endl;
+    ClockCache<std::string, std::string> byBytes(16, [](const std::string& k, const std::string& v) {
+        return k.size() + v.size();
+    });
+    byBytes.put("a", "aaaaaaa");
+    byBytes.put("b", "bbbbbbb");
+    std::string cached;
+    byBytes.try_get("a", cached);
+    byBytes.put("c", "ccc");   // "a" was referenced, so "b" goes
+    byBytes.print();
+    std::cout << "ClockCache cost " << byBytes.cost() << "/" << byBytes.capacity() << std::endl;
+    // Growing an entry evicts others, never the entry itself
+    ClockCache<int, int> byValue(10, [](const int&, const int& v) { return static_cast<std::size_t>(v); });
+    byValue.put(1, 3);
+    byValue.put(2, 3);
+    byValue.put(3, 3);
+    byValue.get(1);
+    byValue.get(2);
+    byValue.get(3);
+    byValue.put(2, 8);
+    std::cout << "ClockCache after growing key 2: contains(2) = " << byValue.contains(2)
+              << ", size " << byValue.size() << ", cost " << byValue.cost() << std::endl;
+
+    // Zipf(1) trace over 10000 keys, cache holds 1000 entries
+    std::vector<double> zipfCdf(10000);
+    double zipfSum = 0;
+    for (std::size_t i = 0; i < zipfCdf.size(); i++) zipfCdf[i] = (zipfSum += 1.0 / (i + 1));
+    LRUCache<int, int> lruZ(1000);
+    ClockCache<int, int> clockZ(1000);
+    ShardedCache<int, int> shardedZ(1000, 8);
+    unsigned long long zipfState = 88172645463325252ULL;
+    for (int i = 0; i < 200000; i++) {
+        zipfState ^= zipfState << 13;
+        zipfState ^= zipfState >> 7;
+        zipfState ^= zipfState << 17;
+        double u = (zipfState >> 11) * (1.0 / 9007199254740992.0) * zipfSum;
+        int key = static_cast<int>(std::upper_bound(zipfCdf.begin(), zipfCdf.end(), u) - zipfCdf.begin());
+        int v;
+        if (!lruZ.try_get(key, v)) lruZ.put(key, key);
+        if (!clockZ.try_get(key, v)) clockZ.put(key, key);
+        if (!shardedZ.try_get(key, v)) shardedZ.put(key, key);
+    }
+    std::cout << "Zipf hit ratio: LRU " << lruZ.hitRatio() << ", CLOCK " << clockZ.hitRatio()
+              << ", sharded LRU (" << shardedZ.shardsUsed() << " shards) " << shardedZ.hitRatio() << std::endl;
+    ShardedCache<int, int> tinySharded(10, 16);   // runs with 8 shards so none is empty
+    for (int i = 0; i < 100; i++) tinySharded.put(i, i);
+    std::cout << "ShardedCache(10, 16): " << tinySharded.shardsUsed() << " shards, size "
+              << tinySharded.size() << std::endl;
+
     // 10) ForwardList<double>
     ForwardList<double> fl;
     fl.push_front(3.14);
@@ -1299,22 +7831,64 @@ int main() {
     vec.push_back(11);
     vec.push_back(22);
     vec.push_back(33);
+    vec.insert(1, 15);
+    vec.erase(0);
     vec.print();
+    Vector<std::string> words;
+    words.setGrowthFactor(1.5);
+    words.emplace_back(3, 'a');
+    words.push_back("middle");
+    words.push_back(words[0]);   // aliases an element across the growth
+    words.emplace(0, "first");
+    words.shrink_to_fit();
+    words.print();
+    std::cout << "words capacity after shrink_to_fit: " << words.capacity() << std::endl;
 
     // 12) Bitset<10>
     Bitset<10> bs;
     bs.set(0);
     bs.set(3);
     bs.print();
+    Bitset<200> wide;
+    wide.set(70, 130);
+    wide.reset(100);
+    std::cout << "Bitset<200> count " << wide.count() << ", first " << wide.find_first()
+              << ", next after 99 " << wide.find_next(99) << ", ~count " << (~wide).count() << std::endl;
+    DynamicBitset visited(1000000);
+    for (std::size_t i = 0; i < 1000000; i += 3) visited.set_unchecked(i);
+    DynamicBitset evens(1000000);
+    evens.set(0, 1000000);
+    for (std::size_t i = 1; i < 1000000; i += 2) evens.reset_unchecked(i);
+    std::cout << "DynamicBitset multiples of 6: " << (visited & evens).count() << std::endl;
+    RoaringBitmap ids;
+    for (std::uint32_t v = 0; v < 10; v++) ids.add(v * 3);
+    RoaringBitmap dense;
+    for (std::uint32_t v = 65536; v < 65536 + 20000; v++) dense.add(v);
+    dense.add(12);
+    dense.runOptimize();
+    RoaringBitmap both = ids | dense;
+    std::vector<unsigned char> bytes = both.serialize();
+    RoaringBitmap back = RoaringBitmap::deserialize(bytes.data(), bytes.size());
+    (ids & dense).print();
+    (ids - dense).print();
+    std::cout << "RoaringBitmap union " << back.cardinality() << " values in " << bytes.size()
+              << " bytes, contains(70000) = " << back.contains(70000) << std::endl;
 
     // 13) Deque<int>
-    Deque<int> d(5);
+    Deque<int> d;
     d.push_front(1);
     d.push_back(2);
     d.push_back(3);
     d.print();
     d.pop_front();
     d.print();
+    int* firstAddr = &d.front();
+    for (int i = 0; i < 1000; i++) {
+        d.push_back(i);
+        d.push_front(-i);
+    }
+    std::cout << "Deque size: " << d.size() << ", d[1000] = " << d[1000]
+              << ", front reference stable: " << (firstAddr == &d[1000]) << std::endl;
 
     // 14) Span<int>
     int raw[5] = {10, 20, 30, 40, 50};
@@ -1336,6 +7910,14 @@ int main() {
     fm.insert(3, 150);
     fm.insert(2, 75); // update
     fm.print();
+    fs.freeze();
+    fm.freeze();
+    std::cout << "frozen FlatSet contains(7) = " << fs.contains(7) << ", FlatMap get(3) = " << fm.get(3) << std::endl;
+    std::vector<std::pair<int,int>> batch = {{5, 500}, {2, 200}, {4, 400}, {5, 555}};
+    fm.insert_bulk(batch.begin(), batch.end(), DuplicatePolicy::KeepFirst);
+    fm.print();
+    std::vector<int> wanted = fm.get_many(std::vector<int>{5, 1, 4});
+    std::cout << "FlatMap get_many(5, 1, 4): " << wanted[0] << " " << wanted[1] << " " << wanted[2] << std::endl;
 
     // 17) InplaceVector<double,5>
     InplaceVector<double,5> inv;
@@ -1344,10 +7926,68 @@ int main() {
     inv.push_back(3.3);
     inv.print();
 
+    // 17b) SmallVector<std::string, 4>: inline until the fifth element
+    SmallVector<std::string, 4> sv = {"a", "b", "c"};
+    sv.print();
+    sv.emplace_back("d");
+    sv.emplace_back("e");
+    sv.print();
+    sv.erase(1, 4);
+    sv.shrink_to_fit();
+    sv.print();
+
     // 18) MdSpan<double>
     double raw2D[6] = {10, 20, 30, 40, 50, 60};
     MdSpan<double> md(raw2D, 2, 3);
     md.print();
+    md = md * 0.5 + md;
+    md.print();
+    // Column block as a strided view, and the same 4x4 grid column-major,
+    // Morton-ordered and with compile-time extents
+    MdSpan<double, LayoutStride> mdCols = md.submdspan(std::make_pair(0, 2), std::make_pair(1, 3));
+    mdCols = mdCols * 10.0;
+    md.print();
+    double grid[16];
+    for (int i = 0; i < 16; i++) grid[i] = i;
+    MdSpan<double, LayoutLeft> colMajor(grid, 4, 4);
+    MdSpan<double, LayoutMorton> zOrder(grid, 4, 4);
+    MdSpan<double, LayoutRight, Extents<4, 4>> fixed(grid);
+    std::cout << "grid(1,2): column-major " << colMajor(1, 2) << ", Morton " << zOrder(1, 2)
+              << ", static extents " << fixed.at_unchecked(1, 2) << std::endl;
+    Span<double> whole(grid, 16);
+    whole.subspan(4, 3).print();
+
+#if BDS_HAVE_MMAP
+    // 18b) MappedMatrix: tiled file, streamed multiply and transpose
+    {
+        Matrix<double> src(5, 7);
+        for (std::size_t i = 0; i < 5; i++) {
+            for (std::size_t j = 0; j < 7; j++) src(i, j) = double(i * 7 + j);
+        }
+        MappedMatrix<double> fa = MappedMatrix<double>::save("bds_a.mat", src, 2, 3);
+        MappedMatrix<double> ft = MappedMatrix<double>::create("bds_t.mat", 7, 5, 4, 4);
+        MappedMatrix<double>::transpose(fa, ft, 3);
+        MappedMatrix<double> fc = MappedMatrix<double>::create("bds_c.mat", 5, 5);
+        MappedMatrix<double>::multiply(fa, ft, fc, 3, 1);
+        fc.flush();
+        MappedMatrix<double> reopened = MappedMatrix<double>::open("bds_c.mat");
+        reopened.advise(MapAdvice::Sequential);
+        const MappedMatrix<double>& readOnly = reopened;
+        Matrix<double> expect = src * src.transpose();
+        double fileErr = 0.0;
+        for (std::size_t i = 0; i < 5; i++) {
+            for (std::size_t j = 0; j < 5; j++) {
+                double err = readOnly(i, j) - expect(i, j);
+                if (err < 0) err = -err;
+                if (err > fileErr) fileErr = err;
+            }
+        }
+        std::cout << "MappedMatrix A*A^T max error: " << fileErr << ", C(4,4) = " << readOnly(4, 4) << std::endl;
+        unlink("bds_a.mat");
+        unlink("bds_t.mat");
+        unlink("bds_c.mat");
+    }
+#endif
 
     // 19) UnorderedSet<int>
     UnorderedSet<int> us;
@@ -1358,5 +7998,111 @@ int main() {
     us.remove(100);
     us.print();
 
+    // 20) ConcurrentUnorderedSet<int> shared by four threads
+    ConcurrentUnorderedSet<int> cus;
+    std::thread workers[4];
+    for (int t = 0; t < 4; t++) {
+        // overlapping ranges, so half the inserts are duplicates
+        workers[t] = std::thread([&cus, t]() {
+            for (int i = t * 500; i < t * 500 + 1000; i++) cus.insert(i);
+        });
+    }
+    for (int t = 0; t < 4; t++) workers[t].join();
+    for (int t = 0; t < 4; t++) {
+        workers[t] = std::thread([&cus, t]() {
+            for (int i = t; i < 2500; i += 40) cus.remove(i);
+        });
+    }
+    for (int t = 0; t < 4; t++) workers[t].join();
+    std::cout << "ConcurrentUnorderedSet size: " << cus.size()
+              << ", contains(2499) = " << cus.contains(2499) << std::endl;
+
+    // 21) MultiQueue: parallel Dijkstra on a 40x40 grid, four threads.
+    // Stale or out-of-order pops are simply re-relaxed, so the result is exact.
+    const int GRID = 40;
+    std::atomic<int> gridDist[GRID * GRID];
+    for (int i = 0; i < GRID * GRID; i++) gridDist[i].store(1 << 30);
+    MultiQueue<std::pair<int,int>, std::greater<std::pair<int,int>>> mq(4);
+    std::atomic<int> pending(1);   // pushed but not yet fully processed
+    gridDist[0].store(0);
+    mq.push(std::make_pair(0, 0));
+    for (int t = 0; t < 4; t++) {
+        workers[t] = std::thread([&]() {
+            std::pair<int,int> item;
+            while (pending.load() > 0) {
+                if (!mq.try_pop(item)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                int u = item.second;
+                if (item.first == gridDist[u].load()) {
+                    int r = u / GRID, c = u % GRID;
+                    int nbrs[4] = {r > 0 ? u - GRID : -1, r < GRID - 1 ? u + GRID : -1,
+                                   c > 0 ? u - 1 : -1, c < GRID - 1 ? u + 1 : -1};
+                    for (int v : nbrs) {
+                        if (v < 0) continue;
+                        int nd = item.first + (r * 7 + c * 3) % 9 + 1;
+                        int old = gridDist[v].load();
+                        while (nd < old && !gridDist[v].compare_exchange_weak(old, nd)) {}
+                        if (nd < old) {
+                            pending++;
+                            mq.push(std::make_pair(nd, v));
+                        }
+                    }
+                }
+                pending--;
+            }
+        });
+    }
+    for (int t = 0; t < 4; t++) workers[t].join();
+    std::cout << "MultiQueue Dijkstra: dist to far corner = "
+              << gridDist[GRID * GRID - 1].load() << std::endl;
+
+    // 22) ConcurrentStack<int> used as a shared free list
+    ConcurrentStack<int> freeSlots;
+    for (int i = 0; i < 64; i++) freeSlots.push(i);
+    for (int t = 0; t < 4; t++) {
+        workers[t] = std::thread([&freeSlots]() {
+            for (int i = 0; i < 10000; i++) {
+                int slot;
+                if (freeSlots.try_pop(slot)) freeSlots.push(slot);
+            }
+        });
+    }
+    for (int t = 0; t < 4; t++) workers[t].join();
+    long slotSum = 0;
+    while (!freeSlots.empty()) slotSum += freeSlots.pop();
+    std::cout << "ConcurrentStack slot sum: " << slotSum << std::endl;
+
+    // 23) SpscRingQueue / MpmcRingQueue between threads
+    SpscRingQueue<int> spsc(64);
+    std::thread producer([&spsc]() {
+        int batch[10];
+        for (int i = 1; i <= 1000; i += 10) {
+            for (int j = 0; j < 10; j++) batch[j] = i + j;
+            std::size_t sent = 0;
+            while (sent < 10) sent += spsc.push_n(batch + sent, 10 - sent);
+        }
+    });
+    long spscSum = 0;
+    for (int i = 0; i < 1000; i++) spscSum += spsc.pop();
+    producer.join();
+    std::cout << "SpscRingQueue sum: " << spscSum << std::endl;
+
+    MpmcRingQueue<int> mpmc(128);
+    std::atomic<long> mpmcSum(0);
+    for (int t = 0; t < 4; t++) {
+        workers[t] = std::thread([&mpmc, &mpmcSum, t]() {
+            if (t < 2) {
+                for (int i = 1; i <= 1000; i++) mpmc.push(i);
+            } else {
+                for (int i = 0; i < 1000; i++) mpmcSum += mpmc.pop();
+            }
+        });
+    }
+    for (int t = 0; t < 4; t++) workers[t].join();
+    std::cout << "MpmcRingQueue sum: " << mpmcSum.load() << std::endl;
+
     return 0;
-}
\ No newline at end of file
+}
+#endif
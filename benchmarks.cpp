@@ -0,0 +1,1127 @@
+//===================================================
+// benchmarks.cpp - timings for the containers in basic_data_structures.cpp
+//===================================================
+// Build it like the demo program, with optimisation on:
+//
+//   clang++ -std=c++17 -O2 -pthread benchmarks.cpp -o benchmarks
+//
+// ./benchmarks runs every benchmark. ./benchmarks map gemm runs just
+// those two, ./benchmarks --list prints the names, and --scale=0.1 shrinks
+// every problem size (handy for a quick smoke run). Each figure is the
+// best of a few runs. Thread sweeps go up to max(hardware threads, 4), so
+// on a small machine the upper end shows oversubscription, not scaling.
+
+#define BDS_NO_MAIN
+#include "basic_data_structures.cpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+//===================================================
+// Harness
+//===================================================
+typedef std::chrono::steady_clock BenchClock;
+
+static double benchScale = 1.0;
+static volatile std::size_t benchSink;   // keeps results alive past the optimiser
+
+// Problem size n times --scale, never below 'floor'
+static std::size_t scaled(std::size_t n, std::size_t floor = 16) {
+    std::size_t s = static_cast<std::size_t>(n * benchScale);
+    return s < floor ? floor : s;
+}
+
+struct Stopwatch {
+    BenchClock::time_point start;
+    Stopwatch() : start(BenchClock::now()) {}
+    double seconds() const { return std::chrono::duration<double>(BenchClock::now() - start).count(); }
+};
+
+// Best of 'reps' runs of fn(), in seconds; the best run is the one least
+// disturbed by the rest of the machine
+template<typename Fn>
+double bestOf(int reps, Fn fn) {
+    double best = 1e300;
+    for (int r = 0; r < reps; r++) {
+        Stopwatch sw;
+        fn();
+        double t = sw.seconds();
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+// Runs fn(t) on 'threads' threads released together; returns the wall time
+template<typename Fn>
+double runThreads(unsigned threads, Fn fn) {
+    std::atomic<unsigned> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&, t]() {
+            ready++;
+            while (!go.load()) std::this_thread::yield();
+            fn(t);
+        });
+    }
+    while (ready.load() < threads) std::this_thread::yield();
+    Stopwatch sw;
+    go.store(true);
+    for (std::thread& th : pool) th.join();
+    return sw.seconds();
+}
+
+static std::vector<unsigned> threadCounts() {
+    unsigned top = hardwareThreads() > 4 ? hardwareThreads() : 4;
+    std::vector<unsigned> counts;
+    for (unsigned t = 1; t < top; t *= 2) counts.push_back(t);
+    counts.push_back(top);
+    return counts;
+}
+
+// xorshift64; cheap enough not to show up in the timings
+struct BenchRng {
+    unsigned long long state;
+    explicit BenchRng(unsigned long long seed) : state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+    unsigned long long next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+    std::size_t below(std::size_t n) { return static_cast<std::size_t>(next() % n); }
+    double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+// Zipf(s) sampler over [0, n) by inverse CDF
+class ZipfSampler {
+private:
+    std::vector<double> cdf;
+
+public:
+    ZipfSampler(std::size_t n, double s) : cdf(n) {
+        double sum = 0;
+        for (std::size_t i = 0; i < n; i++) cdf[i] = (sum += 1.0 / std::pow(double(i + 1), s));
+        for (double& c : cdf) c /= sum;
+    }
+    std::size_t operator()(BenchRng& rng) const {
+        std::size_t k = std::upper_bound(cdf.begin(), cdf.end(), rng.unit()) - cdf.begin();
+        return k < cdf.size() ? k : cdf.size() - 1;
+    }
+};
+
+static void heading(const char* title) {
+    std::cout << "\n== " << title << " ==" << std::endl;
+}
+
+// One result line: what was timed, time per item, items per second
+static void report(const std::string& what, double seconds, double items, const char* unit = "op") {
+    char line[160];
+    std::snprintf(line, sizeof(line), "  %-46s %11.1f ns/%s %10.2f M%s/s", what.c_str(),
+                  seconds / items * 1e9, unit, items / seconds / 1e6, unit);
+    std::cout << line << std::endl;
+}
+
+static void note(const std::string& what, const std::string& value) {
+    char line[160];
+    std::snprintf(line, sizeof(line), "  %-46s %s", what.c_str(), value.c_str());
+    std::cout << line << std::endl;
+}
+
+static std::string fmt(const char* format, double v) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), format, v);
+    return buf;
+}
+
+// Heap allocation counter for the SmallVector workload. Kept out of line so
+// GCC does not pair an inlined new with free() and warn about it.
+static std::atomic<std::size_t> allocCount(0);
+
+__attribute__((noinline)) void* operator new(std::size_t n) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+//===================================================
+// UnorderedMap vs std::unordered_map and the old single chain (user-001)
+//===================================================
+// The list-backed map UnorderedMap replaced: one chain, O(n) per call
+template<typename K, typename V>
+class ChainMap {
+private:
+    struct Entry {
+        K key;
+        V value;
+        Entry* next;
+    };
+    Entry* head;
+
+public:
+    ChainMap() : head(nullptr) {}
+    ~ChainMap() {
+        while (head) {
+            Entry* next = head->next;
+            delete head;
+            head = next;
+        }
+    }
+    void insert(const K& key, const V& val) {
+        for (Entry* e = head; e; e = e->next) {
+            if (e->key == key) {
+                e->value = val;
+                return;
+            }
+        }
+        head = new Entry{key, val, head};
+    }
+    bool contains(const K& key) const {
+        for (Entry* e = head; e; e = e->next) {
+            if (e->key == key) return true;
+        }
+        return false;
+    }
+    void remove(const K& key) {
+        for (Entry** link = &head; *link; link = &(*link)->next) {
+            if ((*link)->key == key) {
+                Entry* dead = *link;
+                *link = dead->next;
+                delete dead;
+                return;
+            }
+        }
+    }
+};
+
+struct SwissAdapter {
+    UnorderedMap<std::uint64_t, std::uint64_t> m;
+    void reserve(std::size_t n) { m.reserve(n); }
+    void insert(std::uint64_t k, std::uint64_t v) { m.insert(k, v); }
+    bool contains(std::uint64_t k) const { return m.contains(k); }
+    void remove(std::uint64_t k) { m.remove(k); }
+};
+
+struct StdMapAdapter {
+    std::unordered_map<std::uint64_t, std::uint64_t> m;
+    void reserve(std::size_t n) { m.reserve(n); }
+    void insert(std::uint64_t k, std::uint64_t v) { m[k] = v; }
+    bool contains(std::uint64_t k) const { return m.count(k) != 0; }
+    void remove(std::uint64_t k) { m.erase(k); }
+};
+
+struct ChainAdapter {
+    ChainMap<std::uint64_t, std::uint64_t> m;
+    void reserve(std::size_t) {}
+    void insert(std::uint64_t k, std::uint64_t v) { m.insert(k, v); }
+    bool contains(std::uint64_t k) const { return m.contains(k); }
+    void remove(std::uint64_t k) { m.remove(k); }
+};
+
+template<typename Map>
+void mapSuite(const std::string& name, const std::vector<std::uint64_t>& keys,
+              const std::vector<std::uint64_t>& misses, bool withReserve) {
+    double ins = 1e300, insReserved = 1e300, hit = 1e300, miss = 1e300, era = 1e300;
+    std::size_t found = 0;
+    for (int rep = 0; rep < 3; rep++) {
+        std::unique_ptr<Map> m(new Map);
+        Stopwatch a;
+        for (std::size_t i = 0; i < keys.size(); i++) m->insert(keys[i], i);
+        ins = std::min(ins, a.seconds());
+        Stopwatch b;
+        for (std::uint64_t k : keys) found += m->contains(k);
+        hit = std::min(hit, b.seconds());
+        Stopwatch c;
+        for (std::uint64_t k : misses) found += m->contains(k);
+        miss = std::min(miss, c.seconds());
+        Stopwatch d;
+        for (std::size_t i = 0; i < keys.size(); i += 2) m->remove(keys[i]);
+        era = std::min(era, d.seconds());
+        if (withReserve) {
+            std::unique_ptr<Map> r(new Map);
+            Stopwatch e;
+            r->reserve(keys.size());
+            for (std::size_t i = 0; i < keys.size(); i++) r->insert(keys[i], i);
+            insReserved = std::min(insReserved, e.seconds());
+        }
+    }
+    benchSink = found;
+    double n = static_cast<double>(keys.size());
+    report(name + " insert", ins, n);
+    if (withReserve) report(name + " insert after reserve", insReserved, n);
+    report(name + " lookup hit", hit, n);
+    report(name + " lookup miss", miss, static_cast<double>(misses.size()));
+    report(name + " erase half", era, n / 2);
+}
+
+static void benchUnorderedMap() {
+    heading("UnorderedMap: Swiss table vs std::unordered_map vs single chain");
+    BenchRng rng(1);
+    std::vector<std::uint64_t> keys(scaled(1 << 20)), misses(keys.size());
+    for (std::uint64_t& k : keys) k = rng.next() | 1;
+    for (std::uint64_t& k : misses) k = rng.next() & ~1ULL;
+    std::cout << "  " << keys.size() << " random 64-bit keys" << std::endl;
+    mapSuite<SwissAdapter>("UnorderedMap", keys, misses, true);
+    mapSuite<StdMapAdapter>("std::unordered_map", keys, misses, true);
+
+    // The chain is quadratic to fill, so it gets a small table of its own
+    std::vector<std::uint64_t> few(keys.begin(), keys.begin() + scaled(4000)), fewMisses(misses.begin(), misses.begin() + few.size());
+    std::cout << "  " << few.size() << " keys" << std::endl;
+    mapSuite<SwissAdapter>("UnorderedMap", few, fewMisses, false);
+    mapSuite<ChainAdapter>("single chain (old UnorderedMap)", few, fewMisses, false);
+}
+
+//===================================================
+// ConcurrentUnorderedSet thread scaling (user-002)
+//===================================================
+struct LockedSet {
+    std::mutex lock;
+    std::unordered_set<int> set;
+    bool insert(int v) { std::lock_guard<std::mutex> g(lock); return set.insert(v).second; }
+    bool contains(int v) { std::lock_guard<std::mutex> g(lock); return set.count(v) != 0; }
+    bool remove(int v) { std::lock_guard<std::mutex> g(lock); return set.erase(v) != 0; }
+};
+
+// 'readPercent' of the operations are contains(); the rest alternate insert and remove
+template<typename Set>
+double mixedSetRun(Set& set, unsigned threads, std::size_t opsTotal, int keyRange, unsigned readPercent) {
+    std::size_t perThread = opsTotal / threads;
+    return runThreads(threads, [&](unsigned t) {
+        BenchRng rng(t + 7);
+        std::size_t hits = 0;
+        for (std::size_t i = 0; i < perThread; i++) {
+            int key = static_cast<int>(rng.below(keyRange));
+            unsigned roll = static_cast<unsigned>(rng.below(100));
+            if (roll < readPercent) hits += set.contains(key);
+            else if (roll & 1) hits += set.insert(key);
+            else hits += set.remove(key);
+        }
+        benchSink = hits;
+    });
+}
+
+static void benchConcurrentSet() {
+    heading("ConcurrentUnorderedSet vs mutex + std::unordered_set, 1..N threads");
+    int keyRange = static_cast<int>(scaled(1 << 16));
+    std::size_t ops = scaled(1 << 20);
+    unsigned ratios[] = {90, 50};
+    for (unsigned readPercent : ratios) {
+        for (unsigned t : threadCounts()) {
+            ConcurrentUnorderedSet<int> lockFree;
+            LockedSet locked;
+            for (int k = 0; k < keyRange; k += 2) {
+                lockFree.insert(k);
+                locked.insert(k);
+            }
+            double a = mixedSetRun(lockFree, t, ops, keyRange, readPercent);
+            double b = mixedSetRun(locked, t, ops, keyRange, readPercent);
+            std::string tag = std::to_string(readPercent) + "% reads, " + std::to_string(t) + " thr";
+            report("lock-free  " + tag, a, static_cast<double>(ops / t * t));
+            report("mutex      " + tag, b, static_cast<double>(ops / t * t));
+        }
+    }
+}
+
+//===================================================
+// UnrolledLinkedList vs LinkedList traversal (user-004)
+//===================================================
+static void benchUnrolledList() {
+    heading("UnrolledLinkedList vs LinkedList: traversal and indexed access");
+    std::size_t n = scaled(1 << 17);
+    LinkedList<int> plain;
+    UnrolledLinkedList<int> unrolled;
+    for (std::size_t i = 0; i < n; i++) {
+        plain.push(static_cast<int>(i));
+        unrolled.push(static_cast<int>(i));
+    }
+    // find() of an absent value walks the whole list
+    double a = bestOf(5, [&]() { benchSink = plain.find(-1); });
+    double b = bestOf(5, [&]() { benchSink = unrolled.find(-1); });
+    report("LinkedList full scan", a, static_cast<double>(n), "elem");
+    report("UnrolledLinkedList full scan", b, static_cast<double>(n), "elem");
+
+    std::size_t queries = 200;
+    std::vector<std::size_t> at(queries);
+    BenchRng rng(4);
+    for (std::size_t& i : at) i = rng.below(n);
+    double c = bestOf(3, [&]() { for (std::size_t i : at) benchSink = plain.valAtIndex(i); });
+    double d = bestOf(3, [&]() { for (std::size_t i : at) benchSink = unrolled.valAtIndex(i); });
+    report("LinkedList valAtIndex (random)", c, static_cast<double>(queries));
+    report("UnrolledLinkedList valAtIndex (random)", d, static_cast<double>(queries));
+}
+
+//===================================================
+// LinkedList sort vs parallelSort vs std::sort through a vector (user-005)
+//===================================================
+static void benchListSort() {
+    heading("LinkedList::sort / parallelSort vs copy to std::vector + std::sort");
+    std::size_t n = scaled(1 << 20);
+    std::vector<int> values(n);
+    BenchRng rng(5);
+    for (int& v : values) v = static_cast<int>(rng.next() >> 33);
+    auto fill = [&](LinkedList<int>& list) {
+        for (int v : values) list.push(v);
+    };
+    double best[3] = {1e300, 1e300, 1e300};
+    for (int rep = 0; rep < 3; rep++) {
+        LinkedList<int> a, b, c;
+        fill(a);
+        fill(b);
+        fill(c);
+        Stopwatch s1;
+        a.sort();
+        best[0] = std::min(best[0], s1.seconds());
+        Stopwatch s2;
+        b.parallelSort(hardwareThreads() > 1 ? hardwareThreads() : 2);
+        best[1] = std::min(best[1], s2.seconds());
+        Stopwatch s3;
+        std::vector<int> tmp;
+        tmp.reserve(n);
+        while (!c.empty()) tmp.push_back(c.pop_front());
+        std::sort(tmp.begin(), tmp.end());
+        for (int v : tmp) c.push(v);
+        best[2] = std::min(best[2], s3.seconds());
+        benchSink = a.front() + b.front() + c.front();
+    }
+    report("LinkedList::sort", best[0], static_cast<double>(n), "elem");
+    report("LinkedList::parallelSort", best[1], static_cast<double>(n), "elem");
+    report("to std::vector, std::sort, back", best[2], static_cast<double>(n), "elem");
+}
+
+//===================================================
+// MultiQueue: parallel Dijkstra vs a sequential PriorityQueue (user-007)
+//===================================================
+static int gridWeight(int u, int grid) { return (u / grid * 7 + u % grid * 3) % 9 + 1; }
+
+static void benchMultiQueue() {
+    heading("MultiQueue parallel Dijkstra vs sequential PriorityQueue");
+    const int grid = static_cast<int>(scaled(400, 8));
+    const int nodes = grid * grid;
+    std::cout << "  " << grid << "x" << grid << " grid" << std::endl;
+
+    std::vector<int> ref(nodes);
+    double seq = bestOf(3, [&]() {
+        std::fill(ref.begin(), ref.end(), 1 << 30);
+        PriorityQueue<std::pair<int,int>, std::greater<std::pair<int,int>>> pq;
+        ref[0] = 0;
+        pq.push(std::make_pair(0, 0));
+        while (!pq.empty()) {
+            std::pair<int,int> item = pq.pop();
+            int u = item.second;
+            if (item.first != ref[u]) continue;
+            int r = u / grid, c = u % grid;
+            int nbrs[4] = {r > 0 ? u - grid : -1, r < grid - 1 ? u + grid : -1, c > 0 ? u - 1 : -1, c < grid - 1 ? u + 1 : -1};
+            for (int v : nbrs) {
+                if (v < 0) continue;
+                int nd = item.first + gridWeight(u, grid);
+                if (nd < ref[v]) {
+                    ref[v] = nd;
+                    pq.push(std::make_pair(nd, v));
+                }
+            }
+        }
+    });
+    report("PriorityQueue, 1 thread", seq, static_cast<double>(nodes), "node");
+
+    std::unique_ptr<std::atomic<int>[]> dist(new std::atomic<int>[nodes]);
+    for (unsigned t : threadCounts()) {
+        std::atomic<std::size_t> pops(0);
+        double par = 1e300;
+        bool exact = true;
+        for (int rep = 0; rep < 3; rep++) {
+            for (int i = 0; i < nodes; i++) dist[i].store(1 << 30);
+            MultiQueue<std::pair<int,int>, std::greater<std::pair<int,int>>> mq(t);
+            std::atomic<long> pending(1);
+            dist[0].store(0);
+            mq.push(std::make_pair(0, 0));
+            pops.store(0);
+            par = std::min(par, runThreads(t, [&](unsigned) {
+                std::pair<int,int> item;
+                std::size_t mine = 0;
+                while (pending.load() > 0) {
+                    if (!mq.try_pop(item)) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    mine++;
+                    int u = item.second;
+                    if (item.first == dist[u].load()) {
+                        int r = u / grid, c = u % grid;
+                        int nbrs[4] = {r > 0 ? u - grid : -1, r < grid - 1 ? u + grid : -1, c > 0 ? u - 1 : -1, c < grid - 1 ? u + 1 : -1};
+                        for (int v : nbrs) {
+                            if (v < 0) continue;
+                            int nd = item.first + gridWeight(u, grid);
+                            int old = dist[v].load();
+                            while (nd < old && !dist[v].compare_exchange_weak(old, nd)) {}
+                            if (nd < old) {
+                                pending++;
+                                mq.push(std::make_pair(nd, v));
+                            }
+                        }
+                    }
+                    pending--;
+                }
+                pops += mine;
+            }));
+            for (int i = 0; i < nodes; i++) exact = exact && dist[i].load() == ref[i];
+        }
+        report("MultiQueue, " + std::to_string(t) + " thr" + (exact ? "" : " (WRONG)"), par, static_cast<double>(nodes), "node");
+        note("  pops per node (relaxation overhead)", fmt("%.3f", double(pops.load()) / nodes));
+    }
+}
+
+//===================================================
+// Ring-buffer queues vs a mutex-wrapped Queue (user-008)
+//===================================================
+struct LockedQueue {
+    std::mutex lock;
+    std::condition_variable nonEmpty;
+    Queue<int> q;
+    void push(int v) {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            q.push(v);
+        }
+        nonEmpty.notify_one();
+    }
+    int pop() {
+        std::unique_lock<std::mutex> g(lock);
+        nonEmpty.wait(g, [this]() { return !q.empty(); });
+        return q.pop();
+    }
+};
+
+template<typename Q>
+double passItems(Q& q, std::size_t items, unsigned producers, unsigned consumers) {
+    std::size_t perProducer = items / producers, perConsumer = items / consumers;
+    return runThreads(producers + consumers, [&](unsigned t) {
+        if (t < producers) {
+            for (std::size_t i = 0; i < perProducer; i++) q.push(static_cast<int>(i));
+        } else {
+            long sum = 0;
+            for (std::size_t i = 0; i < perConsumer; i++) sum += q.pop();
+            benchSink = sum;
+        }
+    });
+}
+
+// Round trips through a pair of queues, one each way
+template<typename Q>
+double pingPong(Q& there, Q& back, std::size_t trips) {
+    return runThreads(2, [&](unsigned t) {
+        for (std::size_t i = 0; i < trips; i++) {
+            if (t == 0) {
+                there.push(static_cast<int>(i));
+                benchSink = back.pop();
+            } else {
+                back.push(there.pop());
+            }
+        }
+    });
+}
+
+static void benchRingQueues() {
+    heading("SpscRingQueue / MpmcRingQueue vs mutex-wrapped Queue");
+    std::size_t items = scaled(1 << 20);
+    {
+        SpscRingQueue<int> spsc(1024);
+        MpmcRingQueue<int> mpmc(1024);
+        LockedQueue locked;
+        report("SpscRingQueue 1p/1c", bestOf(3, [&]() { passItems(spsc, items, 1, 1); }), double(items), "item");
+        report("MpmcRingQueue 1p/1c", bestOf(3, [&]() { passItems(mpmc, items, 1, 1); }), double(items), "item");
+        report("mutex Queue 1p/1c", bestOf(3, [&]() { passItems(locked, items, 1, 1); }), double(items), "item");
+        report("MpmcRingQueue 2p/2c", bestOf(3, [&]() { passItems(mpmc, items, 2, 2); }), double(items), "item");
+        report("mutex Queue 2p/2c", bestOf(3, [&]() { passItems(locked, items, 2, 2); }), double(items), "item");
+    }
+    {
+        // Batched transfer, 64 items per call
+        SpscRingQueue<int> spsc(1024);
+        std::size_t n = items / 64 * 64;
+        double t = bestOf(3, [&]() {
+            runThreads(2, [&](unsigned th) {
+                int buf[64];
+                for (std::size_t done = 0; done < n; ) {
+                    if (th == 0) {
+                        for (int j = 0; j < 64; j++) buf[j] = static_cast<int>(done + j);
+                        std::size_t sent = 0;
+                        while (sent < 64) {
+                            std::size_t pushed = spsc.push_n(buf + sent, 64 - sent);
+                            if (!pushed) std::this_thread::yield();
+                            sent += pushed;
+                        }
+                        done += 64;
+                    } else {
+                        std::size_t got = spsc.pop_n(buf, 64);
+                        if (!got) std::this_thread::yield();
+                        done += got;
+                    }
+                }
+            });
+        });
+        report("SpscRingQueue push_n/pop_n x64", t, double(n), "item");
+    }
+    std::size_t trips = scaled(20000);
+    {
+        SpscRingQueue<int> there(64), back(64);
+        report("SpscRingQueue round trip", bestOf(3, [&]() { pingPong(there, back, trips); }), double(trips), "trip");
+    }
+    {
+        MpmcRingQueue<int> there(64), back(64);
+        report("MpmcRingQueue round trip", bestOf(3, [&]() { pingPong(there, back, trips); }), double(trips), "trip");
+    }
+    {
+        LockedQueue there, back;
+        report("mutex Queue round trip", bestOf(3, [&]() { pingPong(there, back, trips); }), double(trips), "trip");
+    }
+}
+
+//===================================================
+// Deque vs std::deque (user-009)
+//===================================================
+template<typename D>
+void dequeSuite(const std::string& name, std::size_t n) {
+    double back = 1e300, front = 1e300, index = 1e300, drain = 1e300, small = 1e300;
+    std::vector<std::size_t> at(n);
+    BenchRng rng(9);
+    for (std::size_t& i : at) i = rng.below(2 * n);
+    for (int rep = 0; rep < 3; rep++) {
+        std::unique_ptr<D> d(new D);
+        Stopwatch a;
+        for (std::size_t i = 0; i < n; i++) d->push_back(static_cast<int>(i));
+        back = std::min(back, a.seconds());
+        Stopwatch b;
+        for (std::size_t i = 0; i < n; i++) d->push_front(static_cast<int>(i));
+        front = std::min(front, b.seconds());
+        Stopwatch c;
+        long sum = 0;
+        for (std::size_t i : at) sum += (*d)[i];
+        index = std::min(index, c.seconds());
+        Stopwatch e;
+        for (std::size_t i = 0; i < 2 * n; i++) {
+            sum += d->front();
+            d->pop_front();
+        }
+        drain = std::min(drain, e.seconds());
+        Stopwatch f;
+        for (std::size_t i = 0; i < n / 8; i++) {
+            D tiny;
+            for (int j = 0; j < 8; j++) tiny.push_back(j);
+            sum += tiny.back();
+        }
+        small = std::min(small, f.seconds());
+        benchSink = sum;
+    }
+    report(name + " push_back", back, double(n));
+    report(name + " push_front", front, double(n));
+    report(name + " operator[] (random)", index, double(n));
+    report(name + " pop_front", drain, double(2 * n));
+    report(name + " build+destroy 8 elements", small, double(n / 8), "deque");
+}
+
+static void benchDeque() {
+    heading("Deque vs std::deque");
+    std::size_t n = scaled(1 << 20);
+    dequeSuite<Deque<int>>("Deque", n);
+    dequeSuite<std::deque<int>>("std::deque", n);
+}
+
+//===================================================
+// ConcurrentStack contention (user-010)
+//===================================================
+struct LockedStack {
+    std::mutex lock;
+    Stack<int> s;
+    void push(int v) { std::lock_guard<std::mutex> g(lock); s.push(v); }
+    bool try_pop(int& out) {
+        std::lock_guard<std::mutex> g(lock);
+        if (s.empty()) return false;
+        out = s.pop();
+        return true;
+    }
+};
+
+static void benchConcurrentStack() {
+    heading("ConcurrentStack vs mutex + Stack: push/pop pairs, 1..N threads");
+    std::size_t pairs = scaled(1 << 19);
+    for (unsigned t : threadCounts()) {
+        ConcurrentStack<int> lockFree;
+        LockedStack locked;
+        for (int i = 0; i < 64; i++) {
+            lockFree.push(i);
+            locked.push(i);
+        }
+        std::size_t per = pairs / t;
+        auto work = [per](auto& s) {
+            return [&s, per](unsigned) {
+                int v = 0;
+                long sum = 0;
+                for (std::size_t i = 0; i < per; i++) {
+                    if (s.try_pop(v)) sum += v;
+                    s.push(v);
+                }
+                benchSink = sum;
+            };
+        };
+        double a = runThreads(t, work(lockFree));
+        double b = runThreads(t, work(locked));
+        report("ConcurrentStack, " + std::to_string(t) + " thr", a, double(per * t), "pair");
+        report("mutex Stack, " + std::to_string(t) + " thr", b, double(per * t), "pair");
+    }
+}
+
+//===================================================
+// GEMM GFLOP/s vs the naive triple loop (user-011)
+//===================================================
+template<typename T>
+void gemmSuite(const char* type) {
+    std::size_t sizes[] = {4, 64, 256, 512, 1024};
+    std::size_t last = 0;
+    for (std::size_t n0 : sizes) {
+        std::size_t n = n0 <= 64 ? n0 : scaled(n0, 64);
+        if (n == last) continue;   // small --scale collapses the big sizes
+        last = n;
+        Matrix<T> A(n, n), B(n, n);
+        for (std::size_t i = 0; i < n; i++) {
+            for (std::size_t j = 0; j < n; j++) {
+                A(i, j) = T((i * 3 + j) % 7) - T(3);
+                B(i, j) = T((i + j * 5) % 11) - T(5);
+            }
+        }
+        double flops = 2.0 * n * n * n;
+        int reps = n <= 64 ? 200 : 3;
+        std::string tag = std::string(type) + " " + std::to_string(n) + "^3";
+        if (n <= 512) {
+            double naive = bestOf(reps, [&]() {
+                Matrix<T> C(n, n);
+                for (std::size_t i = 0; i < n; i++) {
+                    for (std::size_t j = 0; j < n; j++) {
+                        T acc = T();
+                        for (std::size_t p = 0; p < n; p++) acc += A(i, p) * B(p, j);
+                        C(i, j) = acc;
+                    }
+                }
+                benchSink = static_cast<std::size_t>(C(0, 0));
+            });
+            note(tag + " naive loop", fmt("%8.2f GFLOP/s", flops / naive / 1e9));
+        }
+        double one = bestOf(reps, [&]() { benchSink = static_cast<std::size_t>(A.multiply(B, 1)(0, 0)); });
+        note(tag + " Gemm, 1 thread", fmt("%8.2f GFLOP/s", flops / one / 1e9));
+        if (hardwareThreads() > 1) {
+            double all = bestOf(reps, [&]() { benchSink = static_cast<std::size_t>(A.multiply(B)(0, 0)); });
+            note(tag + " Gemm, " + std::to_string(hardwareThreads()) + " threads", fmt("%8.2f GFLOP/s", flops / all / 1e9));
+        }
+    }
+}
+
+static void benchGemm() {
+    heading("Matrix::multiply (blocked GEMM) vs naive triple loop");
+#if defined(__AVX512F__)
+    std::cout << "  kernels: AVX-512" << std::endl;
+#elif defined(__AVX2__) && defined(__FMA__)
+    std::cout << "  kernels: AVX2+FMA" << std::endl;
+#else
+    std::cout << "  kernels: portable (build with -mavx2 -mfma or -march=native)" << std::endl;
+#endif
+    gemmSuite<double>("double");
+    gemmSuite<float>("float");
+}
+
+//===================================================
+// SparseMatrix SpMV / SpMM on a power-law matrix (user-013)
+//===================================================
+static void benchSparse() {
+    heading("SparseMatrix on a synthetic power-law matrix");
+    std::size_t n = scaled(1 << 18, 1024);
+    BenchRng rng(13);
+    ZipfSampler colDist(n, 1.1);
+    std::vector<SparseEntry<double>> coo;
+    for (std::size_t r = 0; r < n; r++) {
+        // Row lengths follow a Pareto tail: most rows are short, a few are huge
+        std::size_t len = static_cast<std::size_t>(4.0 / std::pow(1.0 - rng.unit(), 1.0 / 1.5));
+        if (len > n / 4) len = n / 4;
+        for (std::size_t k = 0; k < len; k++) coo.push_back(SparseEntry<double>{r, colDist(rng), 1.0 + (k & 3)});
+    }
+    SparseMatrix<double> csr(n, n, coo);
+    SparseMatrix<double> csc = csr.convert(SparseFormat::CSC);
+    std::cout << "  " << n << "x" << n << ", nnz " << csr.nnz() << std::endl;
+    std::vector<double> x(n, 1.0), y(n);
+    for (unsigned t : threadCounts()) {
+        double a = bestOf(5, [&]() { csr.multiply(x.data(), y.data(), t); });
+        double b = bestOf(5, [&]() { csc.multiply(x.data(), y.data(), t); });
+        report("CSR SpMV, " + std::to_string(t) + " thr", a, double(csr.nnz()), "nnz");
+        report("CSC SpMV, " + std::to_string(t) + " thr", b, double(csr.nnz()), "nnz");
+    }
+    Matrix<double> dense(n, 8);
+    for (std::size_t i = 0; i < n; i++) {
+        for (std::size_t j = 0; j < 8; j++) dense(i, j) = double((i + j) % 5);
+    }
+    for (unsigned t : threadCounts()) {
+        double c = bestOf(3, [&]() { benchSink = static_cast<std::size_t>(csr.multiply(dense, t)(0, 0)); });
+        report("CSR x dense(8 cols), " + std::to_string(t) + " thr", c, double(csr.nnz()) * 8, "madd");
+    }
+}
+
+//===================================================
+// Vector vs std::vector growth (user-015)
+//===================================================
+template<typename V, typename T, typename Make>
+double growRun(std::size_t n, Make make, bool reserveFirst) {
+    return bestOf(3, [&]() {
+        V v;
+        if (reserveFirst) v.reserve(n);
+        for (std::size_t i = 0; i < n; i++) v.push_back(make(i));
+        benchSink = v.size();
+    });
+}
+
+static void benchVector() {
+    heading("Vector vs std::vector: push_back growth");
+    std::size_t n = scaled(1 << 21);
+    auto makeInt = [](std::size_t i) { return static_cast<int>(i); };
+    report("Vector<int> push_back", growRun<Vector<int>, int>(n, makeInt, false), double(n));
+    report("std::vector<int> push_back", growRun<std::vector<int>, int>(n, makeInt, false), double(n));
+    report("Vector<int> push_back after reserve", growRun<Vector<int>, int>(n, makeInt, true), double(n));
+    report("std::vector<int> push_back after reserve", growRun<std::vector<int>, int>(n, makeInt, true), double(n));
+
+    // 40 characters, past every small-string buffer, so moves matter
+    std::size_t ns = scaled(1 << 19);
+    std::string proto(40, 'x');
+    auto makeStr = [&proto](std::size_t) { return proto; };
+    report("Vector<std::string> push_back", growRun<Vector<std::string>, std::string>(ns, makeStr, false), double(ns));
+    report("std::vector<std::string> push_back", growRun<std::vector<std::string>, std::string>(ns, makeStr, false), double(ns));
+    Vector<std::string> src;
+    for (std::size_t i = 0; i < ns; i++) src.push_back(proto);
+    double copy = bestOf(3, [&]() { Vector<std::string> dup(src); benchSink = dup.size(); });
+    report("Vector<std::string> copy", copy, double(ns), "elem");
+}
+
+//===================================================
+// SmallVector allocations on a mixed-size workload (user-016)
+//===================================================
+// Mostly 1..8 items, sometimes dozens, rarely thousands
+static std::vector<std::size_t> requestSizes(std::size_t count) {
+    BenchRng rng(16);
+    std::vector<std::size_t> sizes(count);
+    for (std::size_t& s : sizes) {
+        std::size_t roll = rng.below(100);
+        s = roll < 90 ? 1 + rng.below(8) : roll < 99 ? 9 + rng.below(56) : 1000 + rng.below(3000);
+    }
+    return sizes;
+}
+
+template<typename V>
+void smallVectorRun(const std::string& name, const std::vector<std::size_t>& sizes) {
+    std::size_t allocs = 0;
+    double t = bestOf(3, [&]() {
+        std::size_t before = allocCount.load();
+        long sum = 0;
+        for (std::size_t s : sizes) {
+            V v;
+            for (std::size_t i = 0; i < s; i++) v.push_back(static_cast<int>(i));
+            sum += v[s - 1];
+        }
+        allocs = allocCount.load() - before;
+        benchSink = sum;
+    });
+    report(name, t, double(sizes.size()), "req");
+    note("  heap allocations per request", fmt("%.3f", double(allocs) / sizes.size()));
+}
+
+static void benchSmallVector() {
+    heading("SmallVector<int, 8> vs Vector<int> vs std::vector<int>: mixed request sizes");
+    std::vector<std::size_t> sizes = requestSizes(scaled(200000));
+    smallVectorRun<SmallVector<int, 8>>("SmallVector<int, 8>", sizes);
+    smallVectorRun<Vector<int>>("Vector<int>", sizes);
+    smallVectorRun<std::vector<int>>("std::vector<int>", sizes);
+}
+
+//===================================================
+// FlatSet / FlatMap search vs std::set, std::map and std::lower_bound (user-019)
+//===================================================
+static void benchFlatSearch() {
+    heading("FlatSet / FlatMap lookups, L1-sized to DRAM-sized");
+    std::size_t sizes[] = {1 << 10, 1 << 14, 1 << 17, 1 << 21};
+    std::size_t q = scaled(1 << 20);
+    for (std::size_t n0 : sizes) {
+        std::size_t n = scaled(n0, 64);
+        std::vector<int> keys(n);
+        for (std::size_t i = 0; i < n; i++) keys[i] = static_cast<int>(2 * i);
+        std::vector<int> queries(q);
+        BenchRng rng(19);
+        for (int& v : queries) v = static_cast<int>(rng.below(2 * n));   // half hit
+
+        FlatSet<int> flat, frozen;
+        flat.insert_bulk(keys.begin(), keys.end());
+        frozen.insert_bulk(keys.begin(), keys.end());
+        frozen.freeze();
+        std::set<int> tree(keys.begin(), keys.end());
+        std::vector<std::pair<int,int>> rows;
+        for (int k : keys) rows.push_back(std::make_pair(k, k));
+        FlatMap<int,int> fmap;
+        fmap.insert_bulk(rows.begin(), rows.end());
+        fmap.freeze();
+        std::map<int,int> smap(rows.begin(), rows.end());
+
+        std::string tag = " n=" + std::to_string(n);
+        report("std::set::count" + tag, bestOf(3, [&]() {
+            std::size_t hits = 0;
+            for (int v : queries) hits += tree.count(v);
+            benchSink = hits;
+        }), double(q));
+        report("std::lower_bound" + tag, bestOf(3, [&]() {
+            std::size_t hits = 0;
+            for (int v : queries) {
+                std::vector<int>::const_iterator it = std::lower_bound(keys.begin(), keys.end(), v);
+                hits += (it != keys.end() && *it == v);
+            }
+            benchSink = hits;
+        }), double(q));
+        report("FlatSet::contains (sorted)" + tag, bestOf(3, [&]() {
+            std::size_t hits = 0;
+            for (int v : queries) hits += flat.contains(v);
+            benchSink = hits;
+        }), double(q));
+        report("FlatSet::contains (frozen)" + tag, bestOf(3, [&]() {
+            std::size_t hits = 0;
+            for (int v : queries) hits += frozen.contains(v);
+            benchSink = hits;
+        }), double(q));
+        std::unique_ptr<bool[]> out(new bool[q]);
+        report("FlatSet::contains_many (frozen)" + tag, bestOf(3, [&]() {
+            frozen.contains_many(queries.data(), q, out.get());
+            benchSink = out[q - 1];
+        }), double(q));
+        report("std::map::find" + tag, bestOf(3, [&]() {
+            long sum = 0;
+            for (int v : queries) {
+                std::map<int,int>::const_iterator it = smap.find(v);
+                if (it != smap.end()) sum += it->second;
+            }
+            benchSink = sum;
+        }), double(q));
+        report("FlatMap::contains+get (frozen)" + tag, bestOf(3, [&]() {
+            long sum = 0;
+            for (int v : queries) {
+                if (fmap.contains(v)) sum += fmap.get(v);
+            }
+            benchSink = sum;
+        }), double(q));
+    }
+}
+
+//===================================================
+// Map (B+tree) vs std::map: point and range workloads (user-022)
+//===================================================
+static void benchMap() {
+    heading("Map (B+tree) vs std::map");
+    std::size_t n = scaled(1 << 20);
+    BenchRng rng(22);
+    std::vector<int> keys(n);
+    for (std::size_t i = 0; i < n; i++) keys[i] = static_cast<int>(i * 2);
+    for (std::size_t i = n; i > 1; i--) std::swap(keys[i - 1], keys[rng.below(i)]);
+    std::vector<int> probes(n);
+    for (int& p : probes) p = static_cast<int>(rng.below(2 * n));
+
+    double ins[2] = {1e300, 1e300}, get[2] = {1e300, 1e300}, scan[2] = {1e300, 1e300}, era[2] = {1e300, 1e300};
+    std::size_t scans = scaled(20000), scanLen = 100;
+    for (int rep = 0; rep < 3; rep++) {
+        std::unique_ptr<Map<int,int>> bt(new Map<int,int>);
+        std::unique_ptr<std::map<int,int>> rb(new std::map<int,int>);
+        Stopwatch a;
+        for (int k : keys) bt->insert(k, k);
+        ins[0] = std::min(ins[0], a.seconds());
+        Stopwatch b;
+        for (int k : keys) (*rb)[k] = k;
+        ins[1] = std::min(ins[1], b.seconds());
+
+        long sum = 0;
+        Stopwatch c;
+        for (int p : probes) {
+            if (bt->contains(p)) sum += bt->get(p);
+        }
+        get[0] = std::min(get[0], c.seconds());
+        Stopwatch d;
+        for (int p : probes) {
+            std::map<int,int>::const_iterator it = rb->find(p);
+            if (it != rb->end()) sum += it->second;
+        }
+        get[1] = std::min(get[1], d.seconds());
+
+        Stopwatch e;
+        for (std::size_t s = 0; s < scans; s++) {
+            int lo = probes[s];
+            bt->range(lo, lo + 2 * static_cast<int>(scanLen), [&sum](const int&, const int& v) { sum += v; });
+        }
+        scan[0] = std::min(scan[0], e.seconds());
+        Stopwatch f;
+        for (std::size_t s = 0; s < scans; s++) {
+            int lo = probes[s];
+            std::map<int,int>::const_iterator it = rb->lower_bound(lo), end = rb->lower_bound(lo + 2 * static_cast<int>(scanLen));
+            for (; it != end; ++it) sum += it->second;
+        }
+        scan[1] = std::min(scan[1], f.seconds());
+
+        Stopwatch g;
+        for (std::size_t i = 0; i < n; i += 2) bt->remove(keys[i]);
+        era[0] = std::min(era[0], g.seconds());
+        Stopwatch h;
+        for (std::size_t i = 0; i < n; i += 2) rb->erase(keys[i]);
+        era[1] = std::min(era[1], h.seconds());
+        benchSink = sum;
+    }
+    const char* names[2] = {"Map", "std::map"};
+    for (int i = 0; i < 2; i++) {
+        std::string nm = names[i];
+        report(nm + " insert (random order)", ins[i], double(n));
+        report(nm + " point lookup (half hit)", get[i], double(n));
+        report(nm + " range scan, 100 keys", scan[i], double(scans * scanLen), "key");
+        report(nm + " remove half", era[i], double(n / 2));
+    }
+
+    std::vector<std::pair<int,int>> sorted;
+    for (std::size_t i = 0; i < n; i++) sorted.push_back(std::make_pair(static_cast<int>(2 * i), 0));
+    report("Map::bulk_load (sorted)", bestOf(3, [&]() {
+        Map<int,int> m;
+        m.bulk_load(sorted.begin(), sorted.end());
+        benchSink = m.size();
+    }), double(n));
+    report("std::map from sorted range", bestOf(3, [&]() {
+        std::map<int,int> m(sorted.begin(), sorted.end());
+        benchSink = m.size();
+    }), double(n));
+}
+
+//===================================================
+// Caches on a Zipfian trace: hit ratio and throughput (user-024)
+//===================================================
+struct LockedLru {
+    std::mutex lock;
+    LRUCache<int,int> cache;
+    explicit LockedLru(std::size_t cap) : cache(cap) {}
+    bool try_get(const int& k, int& v) { std::lock_guard<std::mutex> g(lock); return cache.try_get(k, v); }
+    void put(const int& k, const int& v) { std::lock_guard<std::mutex> g(lock); cache.put(k, v); }
+};
+
+// Get, and put on a miss, for every key in the trace
+template<typename C>
+std::size_t replay(C& cache, const int* trace, std::size_t n) {
+    std::size_t hits = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        int v;
+        if (cache.try_get(trace[i], v)) hits++;
+        else cache.put(trace[i], trace[i]);
+    }
+    return hits;
+}
+
+static void benchCache() {
+    heading("LRUCache / ClockCache / ShardedCache on a Zipf(0.99) trace");
+    std::size_t keys = scaled(1 << 20, 1024), cap = keys / 16, len = scaled(1 << 22);
+    ZipfSampler zipf(keys, 0.99);
+    BenchRng rng(24);
+    std::vector<int> trace(len);
+    for (int& k : trace) k = static_cast<int>(zipf(rng));
+    std::cout << "  " << keys << " keys, capacity " << cap << ", trace of " << len << std::endl;
+
+    std::size_t hits = 0;
+    double t;
+    {
+        LRUCache<int,int> lru(cap);
+        t = bestOf(1, [&]() { hits = replay(lru, trace.data(), len); });
+        report("LRUCache", t, double(len));
+        note("  hit ratio", fmt("%.4f", double(hits) / len));
+    }
+    {
+        ClockCache<int,int> clock(cap);
+        t = bestOf(1, [&]() { hits = replay(clock, trace.data(), len); });
+        report("ClockCache", t, double(len));
+        note("  hit ratio", fmt("%.4f", double(hits) / len));
+    }
+    for (unsigned th : threadCounts()) {
+        std::atomic<std::size_t> total(0);
+        std::size_t per = len / th;
+        ShardedCache<int,int> sharded(cap, 64);
+        ShardedCache<int,int,ClockCache<int,int>> shardedClock(cap, 64);
+        LockedLru locked(cap);
+        auto run = [&](auto& cache) {
+            total.store(0);
+            double secs = runThreads(th, [&](unsigned i) { total += replay(cache, trace.data() + i * per, per); });
+            return secs;
+        };
+        std::string tag = ", " + std::to_string(th) + " thr";
+        t = run(sharded);
+        report("ShardedCache<LRU> (64 shards)" + tag, t, double(per * th));
+        note("  hit ratio", fmt("%.4f", double(total.load()) / (per * th)));
+        t = run(shardedClock);
+        report("ShardedCache<Clock> (64 shards)" + tag, t, double(per * th));
+        note("  hit ratio", fmt("%.4f", double(total.load()) / (per * th)));
+        t = run(locked);
+        report("one mutex around LRUCache" + tag, t, double(per * th));
+        note("  hit ratio", fmt("%.4f", double(total.load()) / (per * th)));
+    }
+}
+
+//===================================================
+// main() - pick and run benchmarks
+//===================================================
+struct Benchmark {
+    const char* name;
+    void (*run)();
+};
+
+static const Benchmark BENCHMARKS[] = {
+    {"unordered_map", benchUnorderedMap},
+    {"concurrent_set", benchConcurrentSet},
+    {"unrolled_list", benchUnrolledList},
+    {"list_sort", benchListSort},
+    {"multiqueue", benchMultiQueue},
+    {"ring_queues", benchRingQueues},
+    {"deque", benchDeque},
+    {"concurrent_stack", benchConcurrentStack},
+    {"gemm", benchGemm},
+    {"sparse", benchSparse},
+    {"vector", benchVector},
+    {"small_vector", benchSmallVector},
+    {"flat_search", benchFlatSearch},
+    {"map", benchMap},
+    {"cache", benchCache},
+};
+
+int main(int argc, char** argv) {
+    std::vector<std::string> wanted;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--list") {
+            for (const Benchmark& b : BENCHMARKS) std::cout << b.name << std::endl;
+            return 0;
+        }
+        if (arg.compare(0, 8, "--scale=") == 0) {
+            benchScale = std::atof(arg.c_str() + 8);
+            if (!(benchScale > 0)) {
+                std::cerr << "--scale needs a positive number" << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        bool known = false;
+        for (const Benchmark& b : BENCHMARKS) known = known || arg == b.name;
+        if (!known) {
+            std::cerr << "unknown benchmark '" << arg << "' (try --list)" << std::endl;
+            return 1;
+        }
+        wanted.push_back(arg);
+    }
+    std::cout << "hardware threads: " << hardwareThreads() << ", scale " << benchScale << std::endl;
+    for (const Benchmark& b : BENCHMARKS) {
+        if (wanted.empty() || std::find(wanted.begin(), wanted.end(), b.name) != wanted.end()) b.run();
+    }
+    return 0;
+}